@@ -0,0 +1,109 @@
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <cstdlib>
+#include <algorithm>
+
+using namespace std;
+
+#include "../constants/constants.hpp"
+
+#include "../gameboy/gameboy.hpp"
+
+/*
+
+    Audio benchmark, cost of the APU over a baseline with it disabled (the sound registers are only stored)
+    Without an output rate the channels run without making samples, with one the samples go to the ring
+    A consumer thread pops a buffer from the ring at the pace of the audio callback, the emulation never waits for it
+    and runs faster than real time, so most samples are dropped
+
+    Usage: dist/audio [frames] [rom]
+
+*/
+
+#define AUDIO_DEFAULT_FRAMES 3600
+#define AUDIO_RUNS 5
+
+static double runFrames(Gameboy* gameboy, const uint64_t &frames) {
+    const auto start = chrono::steady_clock::now();
+    gameboy->runFrames(frames);
+
+    const chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    return frames / elapsed.count();
+}
+
+static Gameboy* createGameboy(const string &romPath) {
+    Gameboy* gameboy = new Gameboy();
+    gameboy->setBootRom(BOOT_ROM_PATH);
+    gameboy->setGameRom(romPath);
+
+    return gameboy;
+}
+
+// Returns the frames per second, the APU disabled or only without an output rate
+static double runSilent(const string &romPath, const uint64_t &frames, const bool &enabled) {
+    Gameboy* gameboy = createGameboy(romPath);
+    gameboy->apu->setEnabled(enabled);
+
+    const double fps = runFrames(gameboy, frames);
+
+    delete gameboy;
+    return fps;
+}
+
+// Samples to the ring, popped by another thread, returns the frames per second
+static double runOutput(const string &romPath, const uint64_t &frames, uint64_t &received, uint64_t &made) {
+    Gameboy* gameboy = createGameboy(romPath);
+    gameboy->apu->setSampleRate(AUDIO_SAMPLE_RATE);
+
+    AudioRing* ring = gameboy->apu->getRing();
+    atomic<bool> done(false);
+    received = 0;
+
+    thread consumer([&] {
+        AudioFrame samples[AUDIO_BUFFER_FRAMES];
+
+        while(!done.load(memory_order_acquire)) {
+            received += ring->pop(samples, AUDIO_BUFFER_FRAMES);
+            this_thread::sleep_for(chrono::microseconds(1000000ull * AUDIO_BUFFER_FRAMES / AUDIO_SAMPLE_RATE));
+        }
+    });
+
+    const double fps = runFrames(gameboy, frames);
+
+    done.store(true, memory_order_release);
+    consumer.join();
+
+    if(!gameboy->isRunning()) cerr << "Stopped before " << frames << " frames, PC " << hex << gameboy->cpu->getPC() << dec << endl;
+
+    // Samples the whole run makes, the ring drops the ones the consumer did not keep up with
+    made = gameboy->getTcycles() * AUDIO_SAMPLE_RATE / CLOCK_RATE;
+
+    delete gameboy;
+    return fps;
+}
+
+int main(int argc, char** argv) {
+    const uint64_t frames = argc > 1 ? strtoull(argv[1], nullptr, 10) : AUDIO_DEFAULT_FRAMES;
+    const string romPath = argc > 2 ? argv[2] : ROM_PATH;
+
+    // Best of a few runs each, the runs alternate
+    double baselineFps = 0, silentFps = 0, outputFps = 0;
+    uint64_t received = 0, made = 0;
+
+    for(int i = 0; i < AUDIO_RUNS; i++) {
+        baselineFps = max(baselineFps, runSilent(romPath, frames, false));
+        silentFps = max(silentFps, runSilent(romPath, frames, true));
+        outputFps = max(outputFps, runOutput(romPath, frames, received, made));
+    }
+
+    cout << "ROM: " << romPath << ", " << frames << " frames" << endl;
+    cout << "APU disabled:   " << baselineFps << " frames / s" << endl;
+    cout << "Without output: " << silentFps << " frames / s (" << (baselineFps / silentFps - 1) * 100 << "% slower)" << endl;
+    cout << "With output:    " << outputFps << " frames / s (" << (baselineFps / outputFps - 1) * 100 << "% slower)" << endl;
+    cout << "Samples: " << received << " received of " << made << " made at " << AUDIO_SAMPLE_RATE << " Hz" << endl;
+
+    return 0;
+}
@@ -0,0 +1,90 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+
+using namespace std;
+
+#include "../constants/constants.hpp"
+
+#include "../gameboy/gameboy.hpp"
+
+/*
+
+    Scanline compositor benchmark, scalar against the SSE2 and AVX2 paths
+    Each game runs a number of frames, then the 144 lines of the machine state reached are rendered again with each instruction set
+
+    Usage: dist/compositor [frames] [repeats] [rom...]
+
+*/
+
+static const char* GAMES[] = {
+    "roms/games/Tetris (World) (Rev A).gb",
+    "roms/games/Super Mario Land (World).gb",
+    "roms/games/Legend of Zelda, The - Link's Awakening (France).gb",
+    "roms/games/Mega Man - Dr. Wily's Revenge (Europe).gb"
+};
+
+// Render every line of the frame repeats times, returns the time per line in ns
+static double renderFrame(PPU* ppu, const long repeats) {
+    const auto start = chrono::steady_clock::now();
+
+    for(long i = 0; i < repeats; i++) {
+        for(int line = 0; line < SCREEN_HEIGHT; line++) ppu->renderLine(line);
+    }
+
+    const chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+    return elapsed.count() * 1e9 / (repeats * SCREEN_HEIGHT);
+}
+
+int main(int argc, char** argv) {
+    const uint64_t frames = argc > 1 ? strtoull(argv[1], nullptr, 10) : 900;
+    const long repeats = argc > 2 ? atol(argv[2]) : 2000;
+
+    vector<string> roms;
+    for(int i = 3; i < argc; i++) roms.push_back(argv[i]);
+    if(roms.empty()) roms.assign(begin(GAMES), end(GAMES));
+
+    const SimdLevel supported = Compositor::getSupportedLevel();
+    cout << "Supported: " << Compositor::getLevelName(supported) << ", " << frames << " frames, " << repeats << " repeats" << endl;
+
+    int status = 0;
+
+    for(const string &romPath : roms) {
+        Gameboy* gameboy = new Gameboy();
+        gameboy->setBootRom(BOOT_ROM_PATH);
+        gameboy->setGameRom(romPath);
+
+        // Reach a real frame
+        gameboy->runFrames(frames);
+
+        PPU* ppu = gameboy->ppu;
+        cout << romPath << endl;
+
+        // Scalar reference
+        ppu->getCompositor().setLevel(SimdLevel::Scalar);
+        const double scalar = renderFrame(ppu, repeats);
+        const FrameBuffer reference = ppu->getFramebuffer();
+
+        cout << "    Scalar: " << scalar << " ns / line" << endl;
+
+        for(SimdLevel level : {SimdLevel::SSE2, SimdLevel::AVX2}) {
+            if(!ppu->getCompositor().setLevel(level)) continue;
+
+            const double vectorized = renderFrame(ppu, repeats);
+            cout << "    " << Compositor::getLevelName(level) << ": " << vectorized << " ns / line (x" << scalar / vectorized << ")" << endl;
+
+            // Every path must draw the same frame
+            if(ppu->getFramebuffer() != reference) {
+                cerr << "    " << Compositor::getLevelName(level) << " frame differs from the scalar frame" << endl;
+                status = 1;
+            }
+        }
+
+        delete gameboy;
+    }
+
+    return status;
+}
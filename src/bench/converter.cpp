@@ -0,0 +1,110 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+using namespace std;
+
+#include "../constants/constants.hpp"
+
+#include "../gameboy/gameboy.hpp"
+#include "../gameboy/sink/converter.hpp"
+
+/*
+
+    Frame converter benchmark, color indexes to the 32-bit texture pixels with each instruction set
+    Each game runs a number of frames, its last frame is converted whole, then again unchanged (only the row comparison runs)
+
+    Usage: dist/converter [frames] [repeats] [rom...]
+
+*/
+
+static const char* GAMES[] = {
+    "roms/games/Tetris (World) (Rev A).gb",
+    "roms/games/Super Mario Land (World).gb",
+    "roms/games/Legend of Zelda, The - Link's Awakening (France).gb",
+    "roms/games/Mega Man - Dr. Wily's Revenge (Europe).gb"
+};
+
+// Shades of the SDL frontend
+static const uint32_t COLORS[4] = { 0xC8E6AA, 0xA0C864, 0x306230, 0x0A280A };
+
+// Texture rows are padded like a streaming texture can be
+#define TEXTURE_PITCH (SCREEN_WIDTH * 4 + 64)
+
+// Convert the frame repeats times, whole or only the rows that changed, returns the time per frame in us
+static double convertFrame(FrameConverter &converter, const FrameBuffer &frame, uint8_t* pixels, const long repeats, const bool &whole) {
+    const auto start = chrono::steady_clock::now();
+
+    for(long i = 0; i < repeats; i++) {
+        if(whole) converter.setPalette(COLORS);
+
+        int first, last;
+        if(converter.findChangedRows(frame, first, last)) converter.convert(frame, first, last, pixels + first * TEXTURE_PITCH, TEXTURE_PITCH);
+    }
+
+    const chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+    return elapsed.count() * 1e6 / repeats;
+}
+
+int main(int argc, char** argv) {
+    const uint64_t frames = argc > 1 ? strtoull(argv[1], nullptr, 10) : 900;
+    const long repeats = argc > 2 ? atol(argv[2]) : 20000;
+
+    vector<string> roms;
+    for(int i = 3; i < argc; i++) roms.push_back(argv[i]);
+    if(roms.empty()) roms.assign(begin(GAMES), end(GAMES));
+
+    cout << "Supported: " << Compositor::getLevelName(Compositor::getSupportedLevel()) << ", " << frames << " frames, " << repeats << " repeats" << endl;
+
+    vector<uint8_t> reference(SCREEN_HEIGHT * TEXTURE_PITCH), pixels(SCREEN_HEIGHT * TEXTURE_PITCH);
+    int status = 0;
+
+    for(const string &romPath : roms) {
+        CaptureSink sink;
+
+        Gameboy* gameboy = new Gameboy();
+        gameboy->setSink(&sink);
+        gameboy->setBootRom(BOOT_ROM_PATH);
+        gameboy->setGameRom(romPath);
+
+        // Reach a real frame
+        gameboy->runFrames(frames);
+        const FrameBuffer frame = sink.getFrame();
+
+        cout << romPath << endl;
+
+        FrameConverter converter;
+
+        // Scalar reference
+        converter.setLevel(SimdLevel::Scalar);
+        const double scalar = convertFrame(converter, frame, reference.data(), repeats, true);
+        const double still = convertFrame(converter, frame, reference.data(), repeats, false);
+
+        cout << "    Scalar: " << scalar << " us / frame, unchanged " << still << " us" << endl;
+
+        for(SimdLevel level : {SimdLevel::SSE2, SimdLevel::AVX2}) {
+            if(!converter.setLevel(level)) continue;
+
+            memset(pixels.data(), 0, pixels.size());
+            const double vectorized = convertFrame(converter, frame, pixels.data(), repeats, true);
+            cout << "    " << Compositor::getLevelName(level) << ": " << vectorized << " us / frame (x" << scalar / vectorized << ")" << endl;
+
+            // Every path must write the same pixels
+            for(int y = 0; y < SCREEN_HEIGHT; y++) {
+                if(memcmp(pixels.data() + y * TEXTURE_PITCH, reference.data() + y * TEXTURE_PITCH, SCREEN_WIDTH * 4) == 0) continue;
+
+                cerr << "    " << Compositor::getLevelName(level) << " pixels differ from the scalar pixels" << endl;
+                status = 1;
+                break;
+            }
+        }
+
+        delete gameboy;
+    }
+
+    return status;
+}
@@ -0,0 +1,104 @@
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <cstdlib>
+
+using namespace std;
+
+#include "../constants/constants.hpp"
+
+#include "../gameboy/gameboy.hpp"
+
+/*
+
+    Dispatch microbenchmark, switch over the handlers and pre-decoded instruction cache against the handler table
+    Each decoder runs the same ROM from power on in its own machine, so all of them see the same instructions
+    blargg cpu_instrs.gb runs its tests from WRAM, the cache also pays for the invalidation of the copied code
+    The loop ends early if the machine stops, the times are divided by the instructions actually run
+
+    Usage: dist/dispatch [instructions] [rom]
+
+*/
+
+#define DEFAULT_ROM_PATH "./roms/tests/downloaded/blargg/cpu_instrs.gb"
+#define DISPATCH_RUNS 5
+
+enum class Decoder {
+    Switch,
+    Table,
+    Decoded
+};
+
+struct BenchResult {
+    double seconds;
+    long instructions;
+    uint16_t pc;
+};
+
+static BenchResult runDecoder(const Decoder decoder, const long instructions, const string &romPath) {
+    Gameboy* gameboy = new Gameboy();
+    gameboy->setBootRom(BOOT_ROM_PATH);
+    gameboy->setGameRom(romPath);
+
+    Scheduler* scheduler = gameboy->scheduler;
+
+    // Same loop as Gameboy::runMcycle, only the CPU call changes
+    const auto start = chrono::steady_clock::now();
+
+    long executed = 0;
+    for(; executed < instructions && gameboy->isRunning(); executed++) {
+        if(decoder == Decoder::Decoded) scheduler->addCycles(gameboy->cpu->cycleDecoded());
+        else if(decoder == Decoder::Table) scheduler->addCycles(gameboy->cpu->cycleTable());
+        else scheduler->addCycles(gameboy->cpu->cycle());
+
+        if(scheduler->getCycles() >= scheduler->getNextTimestamp()) scheduler->runEvents();
+    }
+
+    const chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+    const BenchResult result = { elapsed.count(), executed, gameboy->cpu->getPC() };
+    delete gameboy;
+
+    return result;
+}
+
+int main(int argc, char** argv) {
+    const long instructions = argc > 1 ? atol(argv[1]) : 10000000;
+    const string romPath = argc > 2 ? argv[2] : DEFAULT_ROM_PATH;
+
+    // Best of a few runs each, the runs alternate
+    BenchResult switchResult = runDecoder(Decoder::Switch, instructions, romPath);
+    BenchResult tableResult = runDecoder(Decoder::Table, instructions, romPath);
+    BenchResult decodedResult = runDecoder(Decoder::Decoded, instructions, romPath);
+
+    for(int i = 1; i < DISPATCH_RUNS; i++) {
+        const BenchResult switched = runDecoder(Decoder::Switch, instructions, romPath);
+        const BenchResult table = runDecoder(Decoder::Table, instructions, romPath);
+        const BenchResult decoded = runDecoder(Decoder::Decoded, instructions, romPath);
+
+        if(switched.seconds < switchResult.seconds) switchResult = switched;
+        if(table.seconds < tableResult.seconds) tableResult = table;
+        if(decoded.seconds < decodedResult.seconds) decodedResult = decoded;
+    }
+
+    const double switchNs = switchResult.seconds * 1e9 / switchResult.instructions;
+    const double tableNs = tableResult.seconds * 1e9 / tableResult.instructions;
+    const double decodedNs = decodedResult.seconds * 1e9 / decodedResult.instructions;
+
+    cout << "ROM: " << romPath << ", " << tableResult.instructions << " instructions";
+    if(tableResult.instructions < instructions) cout << " (the machine stopped)";
+    cout << endl;
+    cout << "Table decoder:  " << tableNs << " ns / instruction" << endl;
+    cout << "Switch decoder: " << switchNs << " ns / instruction" << endl;
+    cout << "Pre-decoded:    " << decodedNs << " ns / instruction" << endl;
+    cout << "Switch saving: " << tableNs - switchNs << " ns / instruction (x" << tableNs / switchNs << ")" << endl;
+    cout << "Pre-decode saving: " << tableNs - decodedNs << " ns / instruction (x" << tableNs / decodedNs << ")" << endl;
+
+    // All decoders must end on the same instruction
+    if(switchResult.pc != tableResult.pc || switchResult.pc != decodedResult.pc || switchResult.instructions != tableResult.instructions || switchResult.instructions != decodedResult.instructions) {
+        cerr << "Decoders diverged, PC " << hex << switchResult.pc << ", " << tableResult.pc << " and " << decodedResult.pc << endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,82 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <algorithm>
+
+using namespace std;
+
+#include "../constants/constants.hpp"
+
+#include "../gameboy/gameboy.hpp"
+
+/*
+
+    Interpreter throughput, instructions per second on each test ROM with the table decoder
+    Every ROM runs from power on for the same number of instructions, the flags work is most of the ALU and branch cost
+    A ROM that stops the machine ends early, its rate counts the instructions actually run, each ROM keeps the best of a few runs
+
+    Usage: dist/instructions [instructions] [directory]
+
+*/
+
+#define DEFAULT_ROM_DIRECTORY "./roms/tests/downloaded/blargg"
+#define INSTRUCTIONS_RUNS 5
+
+static double runRom(const string &romPath, const long instructions) {
+    Gameboy* gameboy = new Gameboy();
+    gameboy->setBootRom(BOOT_ROM_PATH);
+    gameboy->setGameRom(romPath);
+
+    Scheduler* scheduler = gameboy->scheduler;
+
+    const auto start = chrono::steady_clock::now();
+
+    long executed = 0;
+    for(; executed < instructions && gameboy->isRunning(); executed++) {
+        scheduler->addCycles(gameboy->cpu->cycle());
+
+        if(scheduler->getCycles() >= scheduler->getNextTimestamp()) scheduler->runEvents();
+    }
+
+    const chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    delete gameboy;
+
+    return executed / elapsed.count();
+}
+
+int main(int argc, char** argv) {
+    const long instructions = argc > 1 ? atol(argv[1]) : 10000000;
+    const string directory = argc > 2 ? argv[2] : DEFAULT_ROM_DIRECTORY;
+
+    vector<string> roms;
+    for(const auto &entry : filesystem::directory_iterator(directory)) {
+        if(entry.path().extension() == ".gb") roms.push_back(entry.path().string());
+    }
+
+    sort(roms.begin(), roms.end());
+
+    if(roms.empty()) {
+        cerr << "No ROM in " << directory << endl;
+        return 1;
+    }
+
+    double total = 0;
+
+    cout << instructions << " instructions per ROM" << endl;
+    for(const string &rom : roms) {
+        double rate = 0;
+        for(int i = 0; i < INSTRUCTIONS_RUNS; i++) rate = max(rate, runRom(rom, instructions));
+
+        total += rate;
+
+        cout << setw(8) << fixed << setprecision(2) << rate / 1e6 << " MIPS  " << filesystem::path(rom).filename().string() << endl;
+    }
+
+    cout << setw(8) << fixed << setprecision(2) << total / roms.size() / 1e6 << " MIPS  mean" << endl;
+
+    return 0;
+}
@@ -0,0 +1,62 @@
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <cstdlib>
+
+using namespace std;
+
+#include "../constants/constants.hpp"
+
+#include "../gameboy/gameboy.hpp"
+
+/*
+
+    Logging microbenchmark, cost of a hot path log call with the current ENABLE_LOGGING
+    Compares a loop without log, the lazy log call and the old eagerly concatenated message
+
+    Usage: dist/logging [iterations]
+
+*/
+
+template<typename Body>
+static double measure(const long iterations, Body body) {
+    uint8_t value = 0;
+
+    const auto start = chrono::steady_clock::now();
+    for(long i = 0; i < iterations; i++) {
+        value = value * 31 + (uint8_t) i;
+        body(value);
+    }
+
+    const chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+    // Keep the loop result alive
+    volatile uint8_t sink = value;
+    (void) sink;
+
+    return elapsed.count() * 1e9 / iterations;
+}
+
+int main(int argc, char** argv) {
+    const long iterations = argc > 1 ? atol(argv[1]) : 100000000;
+
+    // Same configuration as the emulator, CPU logs filtered out
+    Logger* masterLogger = new Logger();
+    masterLogger->setConfig({LOG_LOG, LOG_ERROR, LOG_WARNING}, {"Memory"}, {});
+
+    Log* logger = masterLogger->getLogger("CPU");
+
+    const double empty = measure(iterations, [](const uint8_t &) {});
+    const double lazy = measure(iterations, [&](const uint8_t &value) { logger->log("LD r, r with r: ", toHex(value)); });
+    const double eager = measure(iterations, [&](const uint8_t &value) { logger->log("LD r, r with r: " + intToHex(value)); });
+
+    cout << "ENABLE_LOGGING: " << (ENABLE_LOGGING ? "true" : "false") << ", " << iterations << " iterations" << endl;
+    cout << "No log:        " << empty << " ns / call" << endl;
+    cout << "Lazy log:      " << lazy << " ns / call (+" << lazy - empty << ")" << endl;
+    cout << "Eager message: " << eager << " ns / call (+" << eager - empty << ")" << endl;
+
+    delete logger;
+    delete masterLogger;
+
+    return 0;
+}
@@ -0,0 +1,91 @@
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+
+using namespace std;
+
+#include "../constants/constants.hpp"
+
+#include "../gameboy/gameboy.hpp"
+#include "../gameboy/savestate/savestate.hpp"
+
+/*
+
+    Rewind benchmark, recording cost, memory of the history and time to step back
+    Each step back is checked against a state saved when the frame was reached
+
+    Usage: dist/rewind [frames] [rom]
+
+*/
+
+static double runFrames(Gameboy* gameboy, const uint64_t &frames) {
+    const auto start = chrono::steady_clock::now();
+    gameboy->runFrames(frames);
+
+    const chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    return frames / elapsed.count();
+}
+
+int main(int argc, char** argv) {
+    const uint64_t frames = argc > 1 ? strtoull(argv[1], nullptr, 10) : REWIND_DEFAULT_FRAMES;
+    const string romPath = argc > 2 ? argv[2] : ROM_PATH;
+
+    // Reference speed without recording
+    Gameboy* reference = new Gameboy();
+    reference->setBootRom(BOOT_ROM_PATH);
+    reference->setGameRom(romPath);
+
+    const double plainFps = runFrames(reference, frames);
+    delete reference;
+
+    Gameboy* gameboy = new Gameboy();
+    gameboy->setBootRom(BOOT_ROM_PATH);
+    gameboy->setGameRom(romPath);
+    gameboy->rewind->enable();
+
+    const double recordingFps = runFrames(gameboy, frames);
+
+    // Stepping back needs frames that actually ran
+    if(!gameboy->isRunning()) {
+        cerr << "Stopped before " << frames << " frames, PC " << hex << gameboy->cpu->getPC() << endl;
+
+        delete gameboy;
+        return 1;
+    }
+
+    cout << "ROM: " << romPath << ", " << frames << " frames" << endl;
+    cout << "Without rewind: " << plainFps << " frames / s" << endl;
+    cout << "Recording:      " << recordingFps << " frames / s" << endl;
+    cout << "History: " << gameboy->rewind->getFrameCount() << " frames, " << gameboy->rewind->getMemoryUsage() / 1024 << " KB (" << gameboy->rewind->getMemoryUsage() / max(gameboy->rewind->getFrameCount(), 1) << " bytes / frame)" << endl;
+
+    int status = 0;
+    SaveState* expected = new SaveState();
+    SaveState* actual = new SaveState();
+
+    for(int steps : {1, 10, 60, 600}) {
+        // The frame to come back to, captured by the rewind event at its frame boundary
+        gameboy->runFrames(1);
+        gameboy->rewind->stepBack(0);
+        gameboy->saveState(*expected);
+
+        gameboy->runFrames(steps);
+
+        const auto start = chrono::steady_clock::now();
+        const int rewound = gameboy->rewind->stepBack(steps);
+        const chrono::duration<double, micro> elapsed = chrono::steady_clock::now() - start;
+
+        gameboy->saveState(*actual);
+        const bool same = memcmp(expected, actual, sizeof(SaveState)) == 0;
+        if(!same || rewound != steps) status = 1;
+
+        cout << "Step back " << rewound << " frames: " << elapsed.count() << " us" << (same ? "" : ", state differs") << endl;
+    }
+
+    delete expected;
+    delete actual;
+    delete gameboy;
+
+    return status;
+}
@@ -71,10 +71,28 @@
 
 #define SCREEN_SCALE 5
 
+// Presentation thread, presents in step with the display refresh
+#define ENABLE_VSYNC true
+
+/*
+
+    Audio
+
+*/
+
+#define ENABLE_AUDIO true
+
+// Output rate asked to the audio device, and its buffer in stereo frames (about 21 ms)
+#define AUDIO_SAMPLE_RATE 48000
+#define AUDIO_BUFFER_FRAMES 1024
+
 /*
 
     Logging
 
 */
 
-#define ENABLE_LOGGING false
\ No newline at end of file
+// Disabled logs compile to nothing, can also be set from the build with -DENABLE_LOGGING=true
+#ifndef ENABLE_LOGGING
+#define ENABLE_LOGGING false
+#endif
\ No newline at end of file
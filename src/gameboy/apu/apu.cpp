@@ -0,0 +1,589 @@
+#include <iostream>
+#include <stdint.h>
+#include <string>
+#include <cstring>
+#include <algorithm>
+
+using namespace std;
+
+#include "../utils/utils.hpp"
+#include "../logging/logger/logger.hpp"
+
+#include "apu.hpp"
+#include "../../gameboy/gameboy.hpp"
+#include "../savestate/savestate.hpp"
+
+// forward declaration
+class Gameboy;
+
+// Square duty cycles, one bit per duty step: 12.5%, 25%, 50%, 75%
+static const uint8_t dutyWaves[4] = { 0x01, 0x81, 0x87, 0x7E };
+
+// Duty steps from each position to the next change of the square output, the first step that flips the duty bit
+static const uint8_t dutyEdges[4][8] = {
+    { 1, 7, 6, 5, 4, 3, 2, 1 },
+    { 1, 6, 5, 4, 3, 2, 1, 2 },
+    { 3, 2, 1, 4, 3, 2, 1, 4 },
+    { 1, 6, 5, 4, 3, 2, 1, 2 }
+};
+
+// Wave output level (NR32), right shift of the 4-bit samples: mute, 100%, 50%, 25%
+static const uint8_t waveShifts[4] = { 4, 0, 1, 2 };
+
+// Bits that read as 1, from NR10 to the last unused register before the wave RAM
+static const uint8_t readMasks[WAVE_RAM_OFFSET - SOUND_OFFSET] = {
+    0x80, 0x3F, 0x00, 0xFF, 0xBF, // NR10 - NR14
+    0xFF, 0x3F, 0x00, 0xFF, 0xBF, // NR20 - NR24
+    0x7F, 0xFF, 0x9F, 0xFF, 0xBF, // NR30 - NR34
+    0xFF, 0xFF, 0x00, 0x00, 0xBF, // NR40 - NR44
+    0x00, 0x00, 0x70, // NR50 - NR52
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF
+};
+
+/*
+
+    Constructors and Destructors
+
+*/
+
+APU::APU(Gameboy* gameboy) : gameboy(gameboy), registers(), channels(), lastSync(0), frameStep(0), sweepShadow(0), sweepTimer(0), sweepEnabled(false), lfsr(0), enabled(true), sampleRate(0), rateRatio(1), leftGain(), rightGain(), leftLevel(0), rightLevel(0), frameStart(0), frames() {
+    logger = gameboy->getMasterLogger()->getLogger("APU");
+    logger->log("APU Constructor");
+
+    // The divider starts at 0 with the master clock, the first falling edge of bit 12
+    this->gameboy->scheduler->schedule(Event::APUFrame, FRAME_SEQUENCER_PERIOD);
+}
+
+APU::~APU() {
+    logger->log("APU Destructor");
+
+    delete logger;
+}
+
+/*
+
+    Events
+
+*/
+
+void APU::onFrameEvent(const uint64_t &timestamp) {
+    const bool send = timestamp - this->frameStart >= AUDIO_SEND_PERIOD;
+    const bool audible = this->isPowered() && this->isFrameStepAudible();
+
+    // Most steps only count the length and sweep timers down, the channels run on until a step changes them
+    if(send || audible) this->sync(timestamp);
+
+    if(this->isPowered()) this->clockFrameSequencer();
+    if(audible) this->mix(timestamp);
+
+    if(send) this->endFrame(timestamp);
+
+    this->gameboy->scheduler->schedule(Event::APUFrame, timestamp + FRAME_SEQUENCER_PERIOD);
+}
+
+void APU::onDividerReset(const uint16_t &divider) {
+    if(!this->enabled) return;
+
+    const uint64_t now = this->gameboy->scheduler->getCycles();
+    this->sync(now);
+
+    if((divider & FRAME_SEQUENCER_BIT) && this->isPowered()) {
+        this->clockFrameSequencer();
+        this->mix(now);
+    }
+
+    // Edges again from the cleared divider, the samples are sent on the next tick
+    this->gameboy->scheduler->schedule(Event::APUFrame, now + FRAME_SEQUENCER_PERIOD);
+}
+
+/*
+
+    Registers
+
+*/
+
+uint8_t APU::read(const uint16_t &address) const {
+    if(address >= WAVE_RAM_OFFSET) return this->reg(address);
+
+    // Power and the status of each channel
+    if(address == NR52) {
+        uint8_t status = (this->reg(NR52) & 0x80) | readMasks[NR52 - SOUND_OFFSET];
+        for(int i = 0; i < SOUND_CHANNELS; i++) if(this->channels[i].enabled) status |= 1 << i;
+
+        return status;
+    }
+
+    return this->reg(address) | readMasks[address - SOUND_OFFSET];
+}
+
+void APU::write(const uint16_t &address, const uint8_t &value) {
+    if(!this->enabled) {
+        this->reg(address) = value;
+        return;
+    }
+
+    // The channels run up to the write with the previous values
+    const uint64_t now = this->gameboy->scheduler->getCycles();
+    this->sync(now);
+
+    if(address >= WAVE_RAM_OFFSET) this->reg(address) = value;
+
+    // Power off clears the registers, they are read only until power on, the wave RAM is kept
+    else if(address == NR52) {
+        if(!(value & 0x80) && this->isPowered()) {
+            logger->log("Sound off");
+
+            memset(this->registers, 0, NR52 - SOUND_OFFSET + 1);
+            for(Channel &channel : this->channels) channel.enabled = false;
+        } else if((value & 0x80) && !this->isPowered()) {
+            logger->log("Sound on");
+
+            this->reg(NR52) = 0x80;
+            this->frameStep = 0;
+        }
+    }
+
+    else if(this->isPowered()) {
+        this->reg(address) = value;
+
+        const int index = address - SOUND_OFFSET;
+        if(index < 5 * SOUND_CHANNELS) {
+            const int channel = index / 5;
+            Channel &state = this->channels[channel];
+
+            switch(index % 5) {
+                // NR30, the DAC of the wave channel
+                case 0: if(channel == 2 && !this->isDacEnabled(channel)) state.enabled = false; break;
+
+                // Length, counts up to 64 (256 for the wave channel)
+                case 1: state.length = channel == 2 ? 256 - value : 64 - (value & 0x3F); break;
+
+                // Envelope, the DAC is off without volume nor increase
+                case 2: if(channel != 2 && !this->isDacEnabled(channel)) state.enabled = false; break;
+
+                // Frequency, NR43 for the noise channel, the next waveform step is already scheduled
+                case 3: state.period = this->getPeriod(channel); break;
+
+                // Frequency high bits, length enable and trigger
+                case 4: {
+                    state.period = this->getPeriod(channel);
+                    if(value & 0x80) this->trigger(channel);
+                } break;
+            }
+        }
+    }
+
+    // Panning, master volume, trigger or an output change
+    this->mix(now);
+}
+
+void APU::setEnabled(const bool &enabled) {
+    if(enabled == this->enabled) return;
+    logger->log(enabled ? "Sound enabled" : "Sound disabled");
+
+    const uint64_t now = this->gameboy->scheduler->getCycles();
+
+    if(enabled) {
+        // The channels go on from their waveform position, the frame sequencer and the samples from now
+        for(int i = 0; i < SOUND_CHANNELS; i++) if(this->channels[i].enabled) this->skip(i, now);
+
+        this->lastSync = this->frameStart = now;
+        this->gameboy->scheduler->schedule(Event::APUFrame, now + FRAME_SEQUENCER_PERIOD);
+    } else {
+        this->sync(now);
+        this->endFrame(now);
+        this->gameboy->scheduler->cancel(Event::APUFrame);
+    }
+
+    this->enabled = enabled;
+}
+
+void APU::setSampleRate(const int &sampleRate) {
+    logger->log("Sample rate ", sampleRate);
+
+    this->sampleRate = sampleRate;
+    this->buffer.setRates(CLOCK_RATE, sampleRate * this->rateRatio);
+}
+
+void APU::setRateRatio(const double &ratio) {
+    this->rateRatio = ratio;
+    this->buffer.setRates(CLOCK_RATE, this->sampleRate * ratio);
+}
+
+/*
+
+    Internal methods
+
+*/
+
+bool APU::isDacEnabled(const int &channel) const {
+    if(channel == 2) return this->reg(NR30) & 0x80;
+    return this->channelReg(channel, 2) & 0xF8;
+}
+
+uint16_t APU::getFrequency(const int &channel) const {
+    return this->channelReg(channel, 3) | ((this->channelReg(channel, 4) & 0x07) << 8);
+}
+
+uint32_t APU::getPeriod(const int &channel) const {
+    if(channel == 3) {
+        const uint8_t divisor = this->reg(NR43) & 0x07;
+        return (divisor ? divisor * 16 : 8) << (this->reg(NR43) >> 4);
+    }
+
+    return (2048 - this->getFrequency(channel)) * (channel == 2 ? 2 : 4);
+}
+
+void APU::sync(const uint64_t &cycles) {
+    for(int i = 0; i < SOUND_CHANNELS; i++) {
+        Channel &state = this->channels[i];
+        if(!state.enabled || state.next >= cycles) continue;
+
+        // Without output or while silent, the waveform position moves by whole steps at once
+        const bool audible = i == 2 ? this->reg(NR32) & 0x60 : state.volume;
+        if(!this->sampleRate || !audible || !(this->leftGain[i] | this->rightGain[i])) {
+            this->skip(i, cycles);
+            continue;
+        }
+
+        // The channels add up, each one is stepped on its own and only a change of its output is a step of the buffers
+        if(i < 2) this->syncSquare(i, cycles);
+        else if(i == 3 && !(this->reg(NR43) & 0x08)) this->syncNoise(cycles);
+        else this->syncSteps(i, cycles);
+    }
+
+    this->lastSync = max(this->lastSync, cycles);
+}
+
+void APU::syncSquare(const int &channel, const uint64_t &cycles) {
+    Channel &state = this->channels[channel];
+    const uint8_t duty = this->channelReg(channel, 1) >> 6;
+
+    // The output only changes on the duty edges, the steps in between are whole steps at once
+    while(true) {
+        const uint8_t steps = dutyEdges[duty][state.position];
+        const uint64_t edge = state.next + (uint64_t) (steps - 1) * state.period;
+        if(edge >= cycles) break;
+
+        state.position = (state.position + steps) & 0x07;
+        state.next = edge + state.period;
+
+        this->updateOutput(channel, edge);
+    }
+
+    // Fewer steps than to the edge are left
+    for(; state.next < cycles; state.next += state.period) state.position = (state.position + 1) & 0x07;
+}
+
+void APU::syncNoise(const uint64_t &cycles) {
+    Channel &state = this->channels[3];
+
+    // The output is bit 0 and the next 14 are already in the register, the output changes where two neighbours differ
+    // Up to 14 shifts at once, the bits shifted in at bit 14 are the XOR of the pairs shifted out
+    while(true) {
+        const uint16_t changes = (this->lfsr ^ (this->lfsr >> 1)) & 0x3FFF;
+        const int steps = changes ? __builtin_ctz(changes) + 1 : 14;
+
+        const uint64_t edge = state.next + (uint64_t) (steps - 1) * state.period;
+        if(edge >= cycles) break;
+
+        this->lfsr = (this->lfsr >> steps) | ((changes & ((1 << steps) - 1)) << (15 - steps));
+        state.next = edge + state.period;
+
+        this->updateOutput(3, edge);
+    }
+
+    // Before the next change, the output stays
+    for(; state.next < cycles; state.next += state.period) this->step(3);
+}
+
+void APU::syncSteps(const int &channel, const uint64_t &cycles) {
+    Channel &state = this->channels[channel];
+
+    for(; state.next < cycles; state.next += state.period) {
+        this->step(channel);
+        this->updateOutput(channel, state.next);
+    }
+}
+
+void APU::updateOutput(const int &channel, const uint64_t &time) {
+    Channel &state = this->channels[channel];
+
+    const uint8_t output = this->sample(channel);
+    if(output == state.output) return;
+
+    const int32_t delta = output - state.output;
+    state.output = output;
+
+    const int32_t left = delta * this->leftGain[channel];
+    const int32_t right = delta * this->rightGain[channel];
+    if(!left && !right) return;
+
+    // The noise is broadband, the aliasing of a shorter impulse is noise as well
+    if(channel == 3) this->buffer.addShortDelta(time - this->frameStart, left, right);
+    else this->buffer.addDelta(time - this->frameStart, left, right);
+
+    this->leftLevel += left;
+    this->rightLevel += right;
+}
+
+void APU::skip(const int &channel, const uint64_t &cycles) {
+    Channel &state = this->channels[channel];
+    if(state.next >= cycles) return;
+
+    const uint64_t steps = (cycles - state.next + state.period - 1) / state.period;
+    state.next += steps * state.period;
+    state.position = (state.position + steps) & (channel == 2 ? 0x1F : 0x07);
+}
+
+void APU::step(const int &channel) {
+    Channel &state = this->channels[channel];
+
+    if(channel < 2) state.position = (state.position + 1) & 0x07;
+    else if(channel == 2) state.position = (state.position + 1) & 0x1F;
+    else {
+        // Bit 0 XOR bit 1 shifted in at bit 14, and at bit 6 in 7-bit mode
+        const uint16_t bit = (this->lfsr ^ (this->lfsr >> 1)) & 1;
+        this->lfsr = (this->lfsr >> 1) | (bit << 14);
+
+        if(this->reg(NR43) & 0x08) this->lfsr = (this->lfsr & ~0x40) | (bit << 6);
+    }
+}
+
+uint8_t APU::sample(const int &channel) const {
+    const Channel &state = this->channels[channel];
+
+    if(channel < 2) return (dutyWaves[this->channelReg(channel, 1) >> 6] >> state.position) & 1 ? state.volume : 0;
+
+    if(channel == 2) {
+        const uint8_t byte = this->reg(WAVE_RAM_OFFSET + (state.position >> 1));
+        const uint8_t nibble = state.position & 1 ? byte & 0x0F : byte >> 4;
+
+        return nibble >> waveShifts[(this->reg(NR32) >> 5) & 0x03];
+    }
+
+    return this->lfsr & 1 ? 0 : state.volume;
+}
+
+void APU::mix(const uint64_t &time) {
+    // Gain of each channel on each side, the panning and the master volume (1 to 8)
+    const uint8_t panning = this->reg(NR51);
+    const int32_t leftVolume = (((this->reg(NR50) >> 4) & 0x07) + 1) * AUDIO_GAIN;
+    const int32_t rightVolume = ((this->reg(NR50) & 0x07) + 1) * AUDIO_GAIN;
+
+    int32_t left = 0, right = 0;
+
+    for(int i = 0; i < SOUND_CHANNELS; i++) {
+        Channel &state = this->channels[i];
+        state.output = state.enabled ? this->sample(i) : 0;
+
+        this->leftGain[i] = panning & (0x10 << i) ? leftVolume : 0;
+        this->rightGain[i] = panning & (0x01 << i) ? rightVolume : 0;
+
+        left += state.output * this->leftGain[i];
+        right += state.output * this->rightGain[i];
+    }
+
+    if(!this->sampleRate) return;
+
+    this->addDelta(time, left - this->leftLevel, right - this->rightLevel);
+}
+
+void APU::addDelta(const uint64_t &time, const int32_t &left, const int32_t &right) {
+    if(!left && !right) return;
+
+    this->buffer.addDelta(time - this->frameStart, left, right);
+    this->leftLevel += left;
+    this->rightLevel += right;
+}
+
+void APU::trigger(const int &channel) {
+    Channel &state = this->channels[channel];
+
+    state.enabled = this->isDacEnabled(channel);
+    if(state.length == 0) state.length = channel == 2 ? 256 : 64;
+
+    // The first waveform step is one period later
+    state.period = this->getPeriod(channel);
+    state.next = this->gameboy->scheduler->getCycles() + state.period;
+
+    state.volume = this->channelReg(channel, 2) >> 4;
+    state.envelopeTimer = this->channelReg(channel, 2) & 0x07;
+
+    if(channel == 2) state.position = 0;
+    if(channel == 3) this->lfsr = 0x7FFF;
+
+    // Sweep, the frequency is checked at once when there is a shift
+    if(channel == 0) {
+        const uint8_t period = (this->reg(NR10) >> 4) & 0x07;
+        const uint8_t shift = this->reg(NR10) & 0x07;
+
+        this->sweepShadow = this->getFrequency(0);
+        this->sweepTimer = period ? period : 8;
+        this->sweepEnabled = period || shift;
+
+        if(shift) this->computeSweep();
+    }
+}
+
+bool APU::isFrameStepAudible() const {
+    const uint8_t step = this->frameStep;
+
+    // Envelope, and the sweep when its timer runs out
+    if(step == 7) return true;
+    if((step == 2 || step == 6) && this->sweepTimer <= 1) return true;
+
+    // Length, a channel stops at 0
+    if(step & 1) return false;
+
+    for(int i = 0; i < SOUND_CHANNELS; i++) {
+        const Channel &state = this->channels[i];
+        if(state.enabled && state.length == 1 && (this->channelReg(i, 4) & 0x40)) return true;
+    }
+
+    return false;
+}
+
+void APU::clockFrameSequencer() {
+    const uint8_t step = this->frameStep;
+    this->frameStep = (step + 1) & 0x07;
+
+    // Length at 256 Hz, sweep at 128 Hz, envelope at 64 Hz
+    if(!(step & 1)) this->clockLength();
+    if(step == 2 || step == 6) this->clockSweep();
+    if(step == 7) this->clockEnvelope();
+}
+
+void APU::clockLength() {
+    for(int i = 0; i < SOUND_CHANNELS; i++) {
+        Channel &state = this->channels[i];
+        if(!(this->channelReg(i, 4) & 0x40) || !state.length) continue;
+
+        if(--state.length == 0) state.enabled = false;
+    }
+}
+
+void APU::clockSweep() {
+    if(this->sweepTimer && --this->sweepTimer) return;
+
+    const uint8_t period = (this->reg(NR10) >> 4) & 0x07;
+    this->sweepTimer = period ? period : 8;
+
+    if(!this->sweepEnabled || !period) return;
+
+    // The new frequency is written back, then checked again for the overflow
+    const uint16_t frequency = this->computeSweep();
+    if(frequency > 2047 || !(this->reg(NR10) & 0x07)) return;
+
+    this->sweepShadow = frequency;
+    this->channelReg(0, 3) = frequency & 0xFF;
+    this->channelReg(0, 4) = (this->channelReg(0, 4) & ~0x07) | (frequency >> 8);
+    this->channels[0].period = this->getPeriod(0);
+
+    this->computeSweep();
+}
+
+void APU::clockEnvelope() {
+    for(int i = 0; i < SOUND_CHANNELS; i++) {
+        if(i == 2) continue;
+
+        Channel &state = this->channels[i];
+        const uint8_t envelope = this->channelReg(i, 2);
+
+        const uint8_t period = envelope & 0x07;
+        if(!period) continue;
+
+        if(state.envelopeTimer) state.envelopeTimer --;
+        if(state.envelopeTimer) continue;
+
+        state.envelopeTimer = period;
+
+        if((envelope & 0x08) && state.volume < 15) state.volume ++;
+        else if(!(envelope & 0x08) && state.volume > 0) state.volume --;
+    }
+}
+
+uint16_t APU::computeSweep() {
+    const uint16_t delta = this->sweepShadow >> (this->reg(NR10) & 0x07);
+    const uint16_t frequency = this->reg(NR10) & 0x08 ? this->sweepShadow - delta : this->sweepShadow + delta;
+
+    if(frequency > 2047) this->channels[0].enabled = false;
+    return frequency;
+}
+
+void APU::endFrame(const uint64_t &timestamp) {
+    const uint64_t duration = timestamp - this->frameStart;
+    this->frameStart = timestamp;
+
+    if(!this->sampleRate) return;
+
+    this->buffer.endFrame(duration);
+
+    const int count = this->buffer.getAvailable();
+    this->buffer.readSamples(&this->frames[0].left, count);
+
+    // Never waits for the audio output, the samples that do not fit are dropped
+    this->ring.push(this->frames, count);
+}
+
+/*
+
+    Save states
+
+*/
+
+void APU::saveState(APUState &state) const {
+    for(int i = 0; i < SOUND_CHANNELS; i++) {
+        const Channel &channel = this->channels[i];
+        APUChannelState &saved = state.channels[i];
+
+        saved.next = channel.next;
+        saved.period = channel.period;
+        saved.length = channel.length;
+        saved.enabled = channel.enabled;
+        saved.position = channel.position;
+        saved.volume = channel.volume;
+        saved.envelopeTimer = channel.envelopeTimer;
+        saved.output = channel.output;
+    }
+
+    state.lastSync = this->lastSync;
+    memcpy(state.registers, this->registers, SOUND_REGISTERS);
+
+    state.sweepShadow = this->sweepShadow;
+    state.lfsr = this->lfsr;
+    state.frameStep = this->frameStep;
+    state.sweepTimer = this->sweepTimer;
+    state.sweepEnabled = this->sweepEnabled;
+}
+
+void APU::loadState(const APUState &state) {
+    // The samples of the current timeline are sent, the output goes on from the restored channels
+    this->endFrame(this->lastSync);
+
+    for(int i = 0; i < SOUND_CHANNELS; i++) {
+        Channel &channel = this->channels[i];
+        const APUChannelState &saved = state.channels[i];
+
+        channel.next = saved.next;
+        channel.period = saved.period;
+        channel.length = saved.length;
+        channel.enabled = saved.enabled;
+        channel.position = saved.position;
+        channel.volume = saved.volume;
+        channel.envelopeTimer = saved.envelopeTimer;
+        channel.output = saved.output;
+    }
+
+    this->lastSync = state.lastSync;
+    memcpy(this->registers, state.registers, SOUND_REGISTERS);
+
+    this->sweepShadow = state.sweepShadow;
+    this->lfsr = state.lfsr;
+    this->frameStep = state.frameStep;
+    this->sweepTimer = state.sweepTimer;
+    this->sweepEnabled = state.sweepEnabled;
+
+    this->frameStart = this->lastSync;
+    this->mix(this->lastSync);
+}
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "../logging/log/log.hpp"
+
+#include "../gameboy.hpp"
+
+#include "blip.hpp"
+#include "ring.hpp"
+
+// Forward declaration
+class Gameboy;
+struct APUState;
+
+// Sound registers, channel n has its 5 registers from 0xFF10 + 5 * n
+#define SOUND_OFFSET 0xFF10
+#define SOUND_REGISTERS 0x30 // Up to the end of the wave RAM
+
+#define NR10 0xFF10
+#define NR30 0xFF1A
+#define NR32 0xFF1C
+#define NR43 0xFF22
+#define NR50 0xFF24
+#define NR51 0xFF25
+#define NR52 0xFF26
+
+#define WAVE_RAM_OFFSET 0xFF30
+
+#define SOUND_CHANNELS 4
+
+// Frame sequencer, clocked by the falling edge of bit 12 of the divider (512 Hz)
+#define FRAME_SEQUENCER_PERIOD 8192
+#define FRAME_SEQUENCER_BIT 0x1000
+
+// Master clock between two sends of the samples to the ring, 4 frame sequencer ticks (128 Hz)
+#define AUDIO_SEND_PERIOD (4 * FRAME_SEQUENCER_PERIOD)
+
+// Master clock rate, T-cycles per second
+#define CLOCK_RATE 4194304
+
+// Stereo frames between the emulation and the audio output, about 170 ms at 48 kHz
+#define AUDIO_RING_FRAMES 8192
+
+// Output level per step of a channel, 4 channels at 15 with the master volume at 8 stay in 16 bits
+#define AUDIO_GAIN 64
+
+// One stereo sample, the layout of signed 16-bit interleaved audio
+struct AudioFrame {
+    int16_t left;
+    int16_t right;
+};
+
+typedef RingBuffer<AudioFrame, AUDIO_RING_FRAMES> AudioRing;
+
+/*
+
+    APU, the four channels (2 square, wave, noise) are not stepped every cycle
+    They are brought to the master clock on register writes and the frame sequencer steps that change them, each change of a channel output
+    is a step of the band-limited buffers and the samples go to a lock-free ring read by the audio output
+
+*/
+
+class APU {
+    public:
+        APU(Gameboy* gameboy);
+        ~APU();
+
+        // Scheduled event, frame sequencer tick, the samples up to it are sent to the ring every AUDIO_SEND_PERIOD
+        void onFrameEvent(const uint64_t &timestamp);
+
+        // DIV write, the divider is cleared, a set bit 12 falls and clocks the frame sequencer
+        void onDividerReset(const uint16_t &divider);
+
+        // Registers and wave RAM
+        uint8_t read(const uint16_t &address) const;
+        void write(const uint16_t &address, const uint8_t &value);
+
+        // Output rate, samples per second, 0 (the default) runs the channels without making samples
+        void setSampleRate(const int &sampleRate);
+        inline int getSampleRate() const { return this->sampleRate; }
+
+        // Disabled, the registers are only stored and the channels do not run, the baseline of the audio benchmark
+        void setEnabled(const bool &enabled);
+
+        // Samples made per second of emulation over the output rate, moved around 1 so the output keeps up with the device clock
+        void setRateRatio(const double &ratio);
+
+        // Samples for the audio output, it is the only consumer
+        inline AudioRing* getRing() { return &this->ring; }
+
+        // Save states
+        void saveState(APUState &state) const;
+        void loadState(const APUState &state);
+
+    private:
+        Gameboy* gameboy;
+
+        Log* logger;
+
+        struct Channel {
+            uint64_t next; // Master clock of the next waveform step
+            uint32_t period; // T-cycles per waveform step
+
+            uint16_t length; // Length counter, the channel stops at 0 when the length is enabled
+            bool enabled;
+
+            uint8_t position; // Duty step or wave sample
+            uint8_t volume; // Envelope volume
+            uint8_t envelopeTimer;
+
+            uint8_t output; // Digital output, 0 - 15
+        };
+
+        uint8_t registers[SOUND_REGISTERS];
+        Channel channels[SOUND_CHANNELS];
+
+        uint64_t lastSync; // Master clock the channels are at
+        uint8_t frameStep;
+
+        // Channel 1 frequency sweep
+        uint16_t sweepShadow;
+        uint8_t sweepTimer;
+        bool sweepEnabled;
+
+        // Channel 4 noise shift register
+        uint16_t lfsr;
+
+        // Output, not in save states
+        bool enabled;
+        int sampleRate;
+        double rateRatio;
+        BandLimitedBuffer buffer;
+        int32_t leftGain[SOUND_CHANNELS], rightGain[SOUND_CHANNELS]; // Level per output step of each channel, from the last mix
+        int32_t leftLevel, rightLevel; // Levels of the last steps
+        uint64_t frameStart; // Master clock of the first sample not sent yet
+
+        AudioFrame frames[BLIP_BUFFER_SIZE];
+        AudioRing ring;
+
+        inline uint8_t& reg(const uint16_t &address) { return this->registers[address - SOUND_OFFSET]; }
+        inline const uint8_t& reg(const uint16_t &address) const { return this->registers[address - SOUND_OFFSET]; }
+
+        // Register n (0 - 4) of a channel
+        inline uint8_t& channelReg(const int &channel, const int &index) { return this->registers[5 * channel + index]; }
+        inline const uint8_t& channelReg(const int &channel, const int &index) const { return this->registers[5 * channel + index]; }
+
+        inline bool isPowered() const { return this->reg(NR52) & 0x80; }
+        bool isDacEnabled(const int &channel) const;
+        uint32_t getPeriod(const int &channel) const;
+        uint16_t getFrequency(const int &channel) const; // Square and wave channels
+
+        void sync(const uint64_t &cycles); // Waveform steps up to a master clock timestamp
+        void skip(const int &channel, const uint64_t &cycles); // Whole waveform steps up to a timestamp at once, the noise is not shifted (a trigger resets it)
+        void syncSquare(const int &channel, const uint64_t &cycles); // From duty edge to duty edge
+        void syncNoise(const uint64_t &cycles); // From change to change of the output bit, 15-bit mode
+        void syncSteps(const int &channel, const uint64_t &cycles); // Each waveform step, the wave channel and the 7-bit noise
+        void step(const int &channel);
+        uint8_t sample(const int &channel) const; // Digital output from the waveform position and the volume
+        void updateOutput(const int &channel, const uint64_t &time); // New output of a channel at a waveform step, its change is a step of the buffers
+        void mix(const uint64_t &time); // Channel outputs to the stereo levels, a change is a step of the buffers
+        void addDelta(const uint64_t &time, const int32_t &left, const int32_t &right); // Step of the levels, none when neither side changes
+
+        void trigger(const int &channel);
+        bool isFrameStepAudible() const; // The next frame sequencer step can change a channel output
+        void clockFrameSequencer();
+        void clockLength();
+        void clockSweep();
+        void clockEnvelope();
+        uint16_t computeSweep(); // Next sweep frequency, the channel stops past 2047
+
+        void endFrame(const uint64_t &timestamp); // Samples up to a timestamp to the ring
+};
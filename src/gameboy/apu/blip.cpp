@@ -0,0 +1,213 @@
+#include <stdint.h>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <array>
+
+#if defined(__SSE2__)
+#define BLIP_SSE2 true
+#include <immintrin.h>
+#else
+#define BLIP_SSE2 false
+#endif
+
+using namespace std;
+
+#include "blip.hpp"
+
+/*
+
+    Impulse table, a windowed sinc for each sub-sample phase
+
+*/
+
+// 16-bit taps and steps, a widening multiply
+// The taps start from the even sample at or before the step, one later for a step at an odd sample, so the SSE2 vectors
+// of two stereo samples stay aligned with the buffer, and in groups of 4
+template<int Taps> using Kernel = array<array<array<int16_t, Taps + 4>, BLIP_PHASES>, 2>;
+
+// Passband up to 90% of the Nyquist frequency of the output
+#define BLIP_CUTOFF 0.9
+
+template<int Taps> static Kernel<Taps> buildKernel() {
+    Kernel<Taps> kernel = {};
+
+    for(int phase = 0; phase < BLIP_PHASES; phase++) {
+        double taps[Taps];
+        double sum = 0;
+
+        // Tap distance to the impulse, which is half the table after the sample of the step
+        for(int i = 0; i < Taps; i++) {
+            const double x = i - (Taps / 2 - 1) - (double) phase / BLIP_PHASES;
+            const double sinc = x == 0 ? 1 : sin(M_PI * BLIP_CUTOFF * x) / (M_PI * BLIP_CUTOFF * x);
+
+            // Blackman window over the table
+            const double w = M_PI * x / (Taps / 2);
+            const double window = 0.42 + 0.5 * cos(w) + 0.08 * cos(2 * w);
+
+            taps[i] = sinc * window;
+            sum += taps[i];
+        }
+
+        // Each phase sums to exactly one step, the rounding error goes to the largest tap
+        int16_t rounded[Taps];
+        int32_t total = 0;
+        int largest = 0;
+
+        for(int i = 0; i < Taps; i++) {
+            rounded[i] = (int16_t) lround(taps[i] / sum * (1 << BLIP_KERNEL_BITS));
+            total += rounded[i];
+
+            if(rounded[i] > rounded[largest]) largest = i;
+        }
+
+        rounded[largest] += (1 << BLIP_KERNEL_BITS) - total;
+
+        for(int odd = 0; odd < 2; odd++) {
+            for(int i = 0; i < Taps; i++) kernel[odd][phase][odd + i] = rounded[i];
+        }
+    }
+
+    return kernel;
+}
+
+static const Kernel<BLIP_TAPS> kernel = buildKernel<BLIP_TAPS>();
+static const Kernel<BLIP_SHORT_TAPS> shortKernel = buildKernel<BLIP_SHORT_TAPS>();
+
+// Impulse at a sample position, a short one starts later so that both have the same center
+template<int Taps> static inline void addImpulse(int32_t* buffer, const Kernel<Taps> &kernel, const uint64_t &position, const int16_t &left, const int16_t &right) {
+    const uint64_t index = (position >> BLIP_TIME_BITS) + (BLIP_TAPS - Taps) / 2;
+    const int phase = (position >> (BLIP_TIME_BITS - BLIP_PHASE_BITS)) & (BLIP_PHASES - 1);
+
+    const array<int16_t, Taps + 4> &taps = kernel[index & 1][phase];
+    int32_t* out = buffer + (index & ~1ull) * BLIP_CHANNELS;
+
+#if BLIP_SSE2
+    // 4 taps at a time, each one doubled for both sides, the full 32-bit products from the low and high halves
+    const __m128i deltas = _mm_unpacklo_epi16(_mm_set1_epi16(left), _mm_set1_epi16(right));
+
+    __m128i* vectors = (__m128i*) out;
+    for(int i = 0; i < (Taps + 4) / 4; i++) {
+        __m128i quad = _mm_loadl_epi64((const __m128i*) (taps.data() + 4 * i));
+        quad = _mm_unpacklo_epi16(quad, quad);
+
+        const __m128i low = _mm_mullo_epi16(quad, deltas);
+        const __m128i high = _mm_mulhi_epi16(quad, deltas);
+
+        vectors[2 * i] = _mm_add_epi32(vectors[2 * i], _mm_unpacklo_epi16(low, high));
+        vectors[2 * i + 1] = _mm_add_epi32(vectors[2 * i + 1], _mm_unpackhi_epi16(low, high));
+    }
+#else
+    for(int i = 0; i < Taps + 1; i++) {
+        out[2 * i] += taps[i] * left;
+        out[2 * i + 1] += taps[i] * right;
+    }
+#endif
+}
+
+#if BLIP_SSE2
+// One sample of both sides, the running sums wait on an add and a subtract, the leak is taken before the step
+static inline __m128i integrate(__m128i &levels, const __m128i &steps) {
+    const __m128i leak = _mm_srai_epi32(levels, BLIP_HIGH_PASS_SHIFT);
+
+    levels = _mm_add_epi32(levels, steps);
+    const __m128i sample = _mm_srai_epi32(levels, BLIP_KERNEL_BITS);
+
+    levels = _mm_sub_epi32(levels, leak);
+    return sample;
+}
+#endif
+
+/*
+
+    Constructors
+
+*/
+
+BandLimitedBuffer::BandLimitedBuffer() : factor(0), offset(0), integrators(), buffer() {}
+
+/*
+
+    Methods
+
+*/
+
+void BandLimitedBuffer::setRates(const double &clockRate, const double &sampleRate) {
+    this->factor = (uint64_t) llround(sampleRate / clockRate * (double) (1ull << BLIP_TIME_BITS));
+}
+
+void BandLimitedBuffer::addDelta(const uint64_t &time, const int32_t &left, const int32_t &right) {
+    const uint64_t position = this->offset + time * this->factor;
+
+    // Past the buffer, the frame was not ended in time
+    if((position >> BLIP_TIME_BITS) >= BLIP_BUFFER_SIZE) return;
+
+    addImpulse<BLIP_TAPS>(this->buffer, kernel, position, left, right);
+}
+
+void BandLimitedBuffer::addShortDelta(const uint64_t &time, const int32_t &left, const int32_t &right) {
+    const uint64_t position = this->offset + time * this->factor;
+    if((position >> BLIP_TIME_BITS) >= BLIP_BUFFER_SIZE) return;
+
+    addImpulse<BLIP_SHORT_TAPS>(this->buffer, shortKernel, position, left, right);
+}
+
+void BandLimitedBuffer::endFrame(const uint64_t &duration) {
+    this->offset += duration * this->factor;
+
+    // Samples that do not fit are dropped, the caller reads every frame
+    if(this->getAvailable() > BLIP_BUFFER_SIZE) this->offset = (uint64_t) BLIP_BUFFER_SIZE << BLIP_TIME_BITS;
+}
+
+void BandLimitedBuffer::readSamples(int16_t* samples, const int &count) {
+    const int length = count * BLIP_CHANNELS;
+
+    // Leaky sums, the DC level decays by 1 / 2^BLIP_HIGH_PASS_SHIFT each sample and the output is high-passed
+#if BLIP_SSE2
+    // Both sides in one register, two samples a loop, the pack saturates to 16 bits
+    __m128i levels = _mm_loadl_epi64((const __m128i*) this->integrators);
+    int i = 0;
+
+    for(; i + 2 * BLIP_CHANNELS <= length; i += 2 * BLIP_CHANNELS) {
+        const __m128i steps = _mm_load_si128((const __m128i*) (this->buffer + i));
+
+        const __m128i first = integrate(levels, steps);
+        const __m128i second = integrate(levels, _mm_srli_si128(steps, 8));
+
+        _mm_storel_epi64((__m128i*) (samples + i), _mm_packs_epi32(_mm_unpacklo_epi64(first, second), _mm_setzero_si128()));
+    }
+
+    if(i < length) {
+        const int32_t packed = _mm_cvtsi128_si32(_mm_packs_epi32(integrate(levels, _mm_loadl_epi64((const __m128i*) (this->buffer + i))), _mm_setzero_si128()));
+        memcpy(samples + i, &packed, sizeof(packed));
+    }
+
+    _mm_storel_epi64((__m128i*) this->integrators, levels);
+#else
+    int32_t left = this->integrators[0], right = this->integrators[1];
+
+    for(int i = 0; i < length; i += BLIP_CHANNELS) {
+        const int32_t leftLeak = left >> BLIP_HIGH_PASS_SHIFT;
+        const int32_t rightLeak = right >> BLIP_HIGH_PASS_SHIFT;
+
+        left += this->buffer[i];
+        right += this->buffer[i + 1];
+
+        samples[i] = (int16_t) clamp<int32_t>(left >> BLIP_KERNEL_BITS, INT16_MIN, INT16_MAX);
+        samples[i + 1] = (int16_t) clamp<int32_t>(right >> BLIP_KERNEL_BITS, INT16_MIN, INT16_MAX);
+
+        left -= leftLeak;
+        right -= rightLeak;
+    }
+
+    this->integrators[0] = left;
+    this->integrators[1] = right;
+#endif
+
+    // Unread samples and the tails of the impulses move to the start
+    const int remaining = (this->getAvailable() - count + BLIP_TAPS) * BLIP_CHANNELS;
+    memmove(this->buffer, this->buffer + count * BLIP_CHANNELS, remaining * sizeof(int32_t));
+    memset(this->buffer + remaining, 0, count * BLIP_CHANNELS * sizeof(int32_t));
+
+    this->offset -= (uint64_t) count << BLIP_TIME_BITS;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+
+    Band-limited step synthesis, the output of a channel only changes by steps at clock times
+    Each step adds a windowed sinc impulse at its sub-sample position, the samples are the running sum of the impulses,
+    so the cost is per step and not per clock cycle, and the steps do not alias at the output rate
+    The two sides are interleaved, a step of both sides finds its impulse once
+
+*/
+
+// Sub-sample positions of the impulse table, and its length in samples
+#define BLIP_PHASE_BITS 5
+#define BLIP_PHASES (1 << BLIP_PHASE_BITS)
+#define BLIP_TAPS 16
+
+// Shorter impulse for a broadband output (the noise), its aliasing is noise as well, centered on the long one
+#define BLIP_SHORT_TAPS 8
+
+// Taps written by a step, from the even sample at or before it and in groups of 4
+#define BLIP_VECTOR_TAPS (BLIP_TAPS + 4)
+
+// Impulse scale, the taps of each phase sum to 1 << BLIP_KERNEL_BITS
+#define BLIP_KERNEL_BITS 15
+
+// Sample positions are 32.32 fixed point
+#define BLIP_TIME_BITS 32
+
+// Samples ended and not read yet, at most, and the interleaved sides
+#define BLIP_BUFFER_SIZE 4096
+#define BLIP_CHANNELS 2
+
+// High-pass of the output, the capacitor of the hardware, about 15 Hz at 48 kHz
+#define BLIP_HIGH_PASS_SHIFT 9
+
+class BandLimitedBuffer {
+    public:
+        BandLimitedBuffer();
+
+        // Clock cycles and samples per second
+        void setRates(const double &clockRate, const double &sampleRate);
+
+        // Step of both sides at a clock time from the start of the frame, the steps fit in 16 bits
+        void addDelta(const uint64_t &time, const int32_t &left, const int32_t &right);
+        void addShortDelta(const uint64_t &time, const int32_t &left, const int32_t &right); // With the short impulse
+
+        // The frame ends after duration clock cycles, its samples can be read
+        void endFrame(const uint64_t &duration);
+        inline int getAvailable() const { return (int) (this->offset >> BLIP_TIME_BITS); }
+
+        // Read and remove count samples of both sides, interleaved
+        void readSamples(int16_t* samples, const int &count);
+
+    private:
+        uint64_t factor; // Sample position per clock cycle
+        uint64_t offset; // Position of the frame start from the first unread sample
+
+        int32_t integrators[BLIP_CHANNELS]; // Running sums of the impulses, the output levels
+
+        alignas(16) int32_t buffer[(BLIP_BUFFER_SIZE + BLIP_VECTOR_TAPS) * BLIP_CHANNELS];
+};
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+#include <type_traits>
+
+using namespace std;
+
+/*
+
+    Single producer, single consumer ring buffer, lock-free
+    Each index is only stored by its side, the producer never waits: what does not fit is dropped
+
+*/
+
+template<typename T, size_t Size>
+class RingBuffer {
+    static_assert(Size && (Size & (Size - 1)) == 0, "The ring size is a power of two");
+    static_assert(is_trivially_copyable<T>::value, "Ring items are copied as raw bytes");
+
+    public:
+        RingBuffer() : head(0), tail(0) {}
+
+        // Producer side, copies up to count items, returns the number written
+        size_t push(const T* items, size_t count) {
+            const size_t head = this->head.load(memory_order_relaxed);
+            const size_t tail = this->tail.load(memory_order_acquire);
+
+            count = min(count, Size - (head - tail));
+
+            // In two parts when it wraps
+            const size_t position = head & (Size - 1);
+            const size_t first = min(count, Size - position);
+
+            memcpy(this->items + position, items, first * sizeof(T));
+            memcpy(this->items, items + first, (count - first) * sizeof(T));
+
+            this->head.store(head + count, memory_order_release);
+            return count;
+        }
+
+        // Consumer side, copies up to count items, returns the number read
+        size_t pop(T* items, size_t count) {
+            const size_t tail = this->tail.load(memory_order_relaxed);
+            const size_t head = this->head.load(memory_order_acquire);
+
+            count = min(count, head - tail);
+
+            const size_t position = tail & (Size - 1);
+            const size_t first = min(count, Size - position);
+
+            memcpy(items, this->items + position, first * sizeof(T));
+            memcpy(items + first, this->items, (count - first) * sizeof(T));
+
+            this->tail.store(tail + count, memory_order_release);
+            return count;
+        }
+
+        // Drops everything, consumer side
+        inline void clear() { this->tail.store(this->head.load(memory_order_acquire), memory_order_release); }
+
+        // Items waiting, exact on either side, a snapshot from any other thread
+        inline size_t size() const { return this->head.load(memory_order_acquire) - this->tail.load(memory_order_acquire); }
+        static constexpr size_t capacity() { return Size; }
+
+    private:
+        // Free running indexes, on their own cache line so the two sides do not share one
+        alignas(64) atomic<size_t> head; // Next item written
+        alignas(64) atomic<size_t> tail; // Next item read
+
+        alignas(64) T items[Size];
+};
@@ -0,0 +1,351 @@
+#include <iostream>
+#include <string>
+#include <cstring>
+#include <stdint.h>
+#include <ctime>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+#include "../utils/utils.hpp"
+#include "../logging/logger/logger.hpp"
+
+#include "cartridge.hpp"
+#include "../savestate/savestate.hpp"
+
+/*
+
+    Constructors and Destructors
+
+*/
+
+Cartridge::Cartridge(Gameboy* gameboy) : gameboy(gameboy), rom(nullptr), romSize(0), mappedSize(0), romMapped(false), romBanks(0), ram(nullptr), ramBanks(0), mbc(MBC::None), ramEnabled(false), bankingMode(false), bankLow(1), bankHigh(0), romBank(1), romBank0(0), ramBank(0), rtc(), rtcLatched(), rtcLatch(0xFF), rtcLastTime(0) {
+    logger = gameboy->getMasterLogger()->getLogger("Cartridge");
+    logger->log("Cartridge Constructor");
+
+    // Empty cartridge until a ROM is loaded, reads return 0xFF
+    char* empty = new char[ROM_BANK_SIZE * 2];
+    memset(empty, 0xFF, ROM_BANK_SIZE * 2);
+
+    this->rom = empty;
+    this->romSize = ROM_BANK_SIZE * 2;
+    this->romBanks = 2;
+
+    this->updateBanks();
+}
+
+Cartridge::~Cartridge() {
+    logger->log("Cartridge Destructor");
+
+    this->unload();
+
+    delete logger;
+}
+
+void Cartridge::unload() {
+    if(this->romMapped) munmap((void*) this->rom, this->mappedSize);
+    else delete[] this->rom;
+
+    delete[] this->ram;
+
+    this->rom = nullptr;
+    this->ram = nullptr;
+}
+
+/*
+
+    Functions
+
+*/
+
+void Cartridge::load(const string &romPath) {
+    // Open ROM file
+    const int fd = open(romPath.c_str(), O_RDONLY);
+
+    // Check if the file was opened successfully
+    struct stat fileStat;
+    if(fd < 0 || fstat(fd, &fileStat) < 0) {
+        logger->error("Error: Could not open ROM file : ", romPath);
+        exit(1);
+    } else logger->log("ROM at path ", romPath, " opened successfully");
+
+    this->unload();
+
+    // Determine size
+    const size_t fileSize = fileStat.st_size;
+    this->romSize = fileSize;
+
+    if(fileSize >= ROM_BANK_SIZE * 2 && fileSize % ROM_BANK_SIZE == 0) {
+        // Map the whole ROM, banks are only pointers in this mapping
+        void* mapping = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(mapping == MAP_FAILED) {
+            logger->error("Error: Could not map ROM file : ", romPath);
+            exit(1);
+        }
+
+        this->rom = (const char*) mapping;
+        this->mappedSize = fileSize;
+        this->romMapped = true;
+    } else {
+        // Small or truncated ROM (test ROMs), copy it in a buffer padded to whole banks
+        this->romSize = max((fileSize + ROM_BANK_SIZE - 1) / ROM_BANK_SIZE, (size_t) 2) * ROM_BANK_SIZE;
+
+        char* buffer = new char[this->romSize];
+        memset(buffer, 0xFF, this->romSize);
+
+        size_t readSize = 0;
+        while(readSize < fileSize) {
+            const ssize_t count = read(fd, buffer + readSize, fileSize - readSize);
+            if(count <= 0) break;
+
+            readSize += count;
+        }
+
+        this->rom = buffer;
+        this->mappedSize = 0;
+        this->romMapped = false;
+    }
+
+    // Close ROM file, the mapping stays valid
+    close(fd);
+
+    this->romBanks = this->romSize / ROM_BANK_SIZE;
+    logger->log("Loading ROM with size ", (int) fileSize, ", ", (int) this->romBanks, " banks");
+
+    // Controller and RAM
+    this->parseHeader();
+
+    // Reset registers, without controller (ROM+RAM, types 0x08 and 0x09) there is no enable register and the RAM is always on
+    this->ramEnabled = this->mbc == MBC::None;
+    this->bankingMode = false;
+    this->bankLow = 1;
+    this->bankHigh = 0;
+    this->rtcLastTime = time(nullptr);
+
+    this->updateBanks();
+
+    logger->log("ROM loaded successfully");
+}
+
+void Cartridge::parseHeader() {
+    const uint8_t type = this->rom[CARTRIDGE_TYPE_ADDRESS];
+
+    switch(type) {
+        case 0x00: case 0x08: case 0x09: this->mbc = MBC::None; break;
+        case 0x01: case 0x02: case 0x03: this->mbc = MBC::MBC1; break;
+        case 0x0F: case 0x10: case 0x11: case 0x12: case 0x13: this->mbc = MBC::MBC3; break;
+        case 0x19: case 0x1A: case 0x1B: case 0x1C: case 0x1D: case 0x1E: this->mbc = MBC::MBC5; break;
+
+        default: {
+            logger->error("Error: Unsupported cartridge type ", toHex(type), ", running without controller");
+            this->mbc = MBC::None;
+        } break;
+    }
+
+    // External RAM size
+    switch(this->rom[CARTRIDGE_RAM_SIZE_ADDRESS]) {
+        case 0x01: case 0x02: this->ramBanks = 1; break;
+        case 0x03: this->ramBanks = 4; break;
+        case 0x04: this->ramBanks = 16; break;
+        case 0x05: this->ramBanks = 8; break;
+        default: this->ramBanks = 0; break;
+    }
+
+    if(this->ramBanks > 0) this->ram = new char[this->ramBanks * RAM_BANK_SIZE]();
+
+    logger->log("Cartridge type ", toHex(type), ", ", (int) this->ramBanks, " RAM banks");
+}
+
+/*
+
+    Bank registers
+
+*/
+
+void Cartridge::writeRegister(const uint16_t &address, const uint8_t &value) {
+    switch(this->mbc) {
+        case MBC::None: return;
+
+        case MBC::MBC1: {
+            if(address < 0x2000) this->ramEnabled = (value & 0x0F) == 0x0A;
+            else if(address < 0x4000) this->bankLow = value & 0x1F;
+            else if(address < 0x6000) this->bankHigh = value & 0x03;
+            else this->bankingMode = value & 0x01;
+        } break;
+
+        case MBC::MBC3: {
+            if(address < 0x2000) this->ramEnabled = (value & 0x0F) == 0x0A;
+            else if(address < 0x4000) this->bankLow = value & 0x7F;
+            else if(address < 0x6000) this->bankHigh = value;
+            else {
+                // Latch the clock on a 0x00 then 0x01 write
+                if(this->rtcLatch == 0x00 && value == 0x01) {
+                    this->updateRtc();
+                    memcpy(this->rtcLatched, this->rtc, sizeof(this->rtc));
+                }
+
+                this->rtcLatch = value;
+                return;
+            }
+        } break;
+
+        case MBC::MBC5: {
+            if(address < 0x2000) this->ramEnabled = (value & 0x0F) == 0x0A;
+            else if(address < 0x3000) this->bankLow = (this->bankLow & 0x100) | value;
+            else if(address < 0x4000) this->bankLow = (this->bankLow & 0xFF) | ((uint16_t) (value & 0x01) << 8);
+            else if(address < 0x6000) this->bankHigh = value & 0x0F;
+            else return;
+        } break;
+    }
+
+    this->updateBanks();
+}
+
+void Cartridge::updateBanks() {
+    switch(this->mbc) {
+        case MBC::None: {
+            this->romBank0 = 0;
+            this->romBank = 1;
+            this->ramBank = 0;
+        } break;
+
+        case MBC::MBC1: {
+            // Bank 0 of the register selects bank 1, the upper bits also apply to the 0x0000 - 0x3FFF area in advanced mode
+            this->romBank = this->maskRomBank((this->bankHigh << 5) | (this->bankLow == 0 ? 1 : this->bankLow));
+            this->romBank0 = this->bankingMode ? this->maskRomBank(this->bankHigh << 5) : 0;
+            this->ramBank = this->bankingMode ? this->bankHigh : 0;
+        } break;
+
+        case MBC::MBC3: {
+            this->romBank = this->maskRomBank(this->bankLow == 0 ? 1 : this->bankLow);
+            this->romBank0 = 0;
+            this->ramBank = this->bankHigh & 0x03;
+        } break;
+
+        case MBC::MBC5: {
+            // Bank 0 can be selected on MBC5
+            this->romBank = this->maskRomBank(this->bankLow);
+            this->romBank0 = 0;
+            this->ramBank = this->bankHigh;
+        } break;
+    }
+
+    // Swap the page pointers, no copy
+    this->gameboy->memory->mapRom(this->rom + this->romBank0 * ROM_BANK_SIZE, this->rom + this->romBank * ROM_BANK_SIZE);
+
+    // RAM is mapped directly when enabled and not replaced by the MBC3 clock registers
+    const bool rtcSelected = this->mbc == MBC::MBC3 && this->bankHigh >= 0x08;
+    if(this->ramEnabled && this->ramBanks > 0 && !rtcSelected) this->gameboy->memory->mapExtram(this->ram + (this->ramBank % this->ramBanks) * RAM_BANK_SIZE);
+    else this->gameboy->memory->mapExtram(nullptr);
+}
+
+int Cartridge::maskRomBank(const int &bank) const {
+    return bank % this->romBanks;
+}
+
+/*
+
+    External RAM
+
+*/
+
+uint8_t Cartridge::readRam(const uint16_t &address) const {
+    // RAM disabled or not present
+    if(!this->ramEnabled) return 0xFF;
+
+    // MBC3 clock registers
+    if(this->mbc == MBC::MBC3 && this->bankHigh >= 0x08 && this->bankHigh <= 0x0C) return this->rtcLatched[this->bankHigh - 0x08];
+
+    logger->warning("Warning: Reading missing cartridge RAM at address ", toHex(address));
+    return 0xFF;
+}
+
+void Cartridge::writeRam(const uint16_t &address, const uint8_t &value) {
+    if(!this->ramEnabled) return;
+
+    // MBC3 clock registers
+    if(this->mbc == MBC::MBC3 && this->bankHigh >= 0x08 && this->bankHigh <= 0x0C) {
+        this->updateRtc();
+        this->rtc[this->bankHigh - 0x08] = value;
+        return;
+    }
+
+    logger->warning("Warning: Writing missing cartridge RAM at address ", toHex(address));
+}
+
+/*
+
+    MBC3 real time clock
+
+*/
+
+void Cartridge::updateRtc() {
+    const time_t now = time(nullptr);
+    const time_t elapsed = now - this->rtcLastTime;
+    this->rtcLastTime = now;
+
+    // Clock halted
+    if(this->rtc[4] & 0x40 || elapsed <= 0) return;
+
+    int days = this->rtc[3] | ((this->rtc[4] & 0x01) << 8);
+    long seconds = this->rtc[0] + this->rtc[1] * 60L + this->rtc[2] * 3600L + days * 86400L + elapsed;
+
+    this->rtc[0] = seconds % 60;
+    this->rtc[1] = (seconds / 60) % 60;
+    this->rtc[2] = (seconds / 3600) % 24;
+
+    days = seconds / 86400;
+    if(days > 0x1FF) this->rtc[4] |= 0x80; // Day counter carry
+
+    days &= 0x1FF;
+    this->rtc[3] = days & 0xFF;
+    this->rtc[4] = (this->rtc[4] & 0xFE) | (days >> 8);
+}
+
+/*
+
+    Save states
+
+*/
+
+uint16_t Cartridge::getGlobalChecksum() const {
+    return ((uint8_t) this->rom[CARTRIDGE_GLOBAL_CHECKSUM_ADDRESS] << 8) | (uint8_t) this->rom[CARTRIDGE_GLOBAL_CHECKSUM_ADDRESS + 1];
+}
+
+void Cartridge::saveState(CartridgeState &state) const {
+    state.rtcLastTime = this->rtcLastTime;
+
+    state.bankLow = this->bankLow;
+    state.bankHigh = this->bankHigh;
+    state.ramEnabled = this->ramEnabled;
+    state.bankingMode = this->bankingMode;
+
+    state.rtcLatch = this->rtcLatch;
+    memcpy(state.rtc, this->rtc, sizeof(this->rtc));
+    memcpy(state.rtcLatched, this->rtcLatched, sizeof(this->rtcLatched));
+
+    memset(state.ram, 0, SAVE_STATE_RAM_SIZE);
+    if(this->ram) memcpy(state.ram, this->ram, this->ramBanks * RAM_BANK_SIZE);
+}
+
+void Cartridge::loadState(const CartridgeState &state) {
+    this->rtcLastTime = state.rtcLastTime;
+
+    this->bankLow = state.bankLow;
+    this->bankHigh = state.bankHigh;
+    this->ramEnabled = state.ramEnabled;
+    this->bankingMode = state.bankingMode;
+
+    this->rtcLatch = state.rtcLatch;
+    memcpy(this->rtc, state.rtc, sizeof(this->rtc));
+    memcpy(this->rtcLatched, state.rtcLatched, sizeof(this->rtcLatched));
+
+    if(this->ram) memcpy(this->ram, state.ram, this->ramBanks * RAM_BANK_SIZE);
+
+    // Map the restored banks
+    this->updateBanks();
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <string>
+#include <stdint.h>
+#include <ctime>
+
+using namespace std;
+
+#include "../logging/log/log.hpp"
+
+#include "../gameboy.hpp"
+
+// Forward declaration
+class Gameboy;
+struct CartridgeState;
+
+// Cartridge header
+#define CARTRIDGE_TYPE_ADDRESS 0x147
+#define CARTRIDGE_ROM_SIZE_ADDRESS 0x148
+#define CARTRIDGE_RAM_SIZE_ADDRESS 0x149
+#define CARTRIDGE_GLOBAL_CHECKSUM_ADDRESS 0x14E
+
+// Banks sizes
+#define ROM_BANK_SIZE 16384
+#define RAM_BANK_SIZE 8192
+
+// Memory bank controllers
+enum class MBC : uint8_t {
+    None,
+    MBC1,
+    MBC3,
+    MBC5
+};
+
+class Cartridge {
+    public:
+        Cartridge(Gameboy* gameboy);
+        ~Cartridge();
+
+        // Load a ROM file, the file is mapped read only
+        void load(const string &romPath);
+
+        // Bank registers, called on writes to 0x0000 - 0x7FFF
+        void writeRegister(const uint16_t &address, const uint8_t &value);
+
+        // External RAM access when the RAM bank can not be mapped directly (disabled, RTC registers)
+        uint8_t readRam(const uint16_t &address) const;
+        void writeRam(const uint16_t &address, const uint8_t &value);
+
+        // Save states, bank registers, clock and external RAM
+        void saveState(CartridgeState &state) const;
+        void loadState(const CartridgeState &state);
+
+        /*
+
+            Getters
+
+        */
+
+        inline const MBC& getMBC() const { return this->mbc; }
+        inline const int& getRomBank() const { return this->romBank; }
+        inline const int& getRamBank() const { return this->ramBank; }
+        uint16_t getGlobalChecksum() const; // Header checksum of the whole ROM, identifies the game
+
+    private:
+        // Gameboy ref
+        Gameboy* gameboy;
+
+        Log* logger;
+
+        // ROM image, mapped read only (or copied when the file is too small to be mapped as whole banks)
+        const char* rom;
+        size_t romSize;
+        size_t mappedSize;
+        bool romMapped;
+
+        int romBanks;
+
+        // External RAM
+        char* ram;
+        int ramBanks;
+
+        // Controller state
+        MBC mbc;
+        bool ramEnabled;
+        bool bankingMode; // MBC1 banking mode, 0: simple, 1: advanced
+
+        uint16_t bankLow; // ROM bank register, MBC1 5 bits, MBC3 7 bits, MBC5 9 bits
+        uint8_t bankHigh; // MBC1 2 bits upper register, MBC3 / MBC5 RAM bank or RTC register select
+
+        int romBank; // Mapped banks
+        int romBank0;
+        int ramBank;
+
+        // MBC3 real time clock
+        uint8_t rtc[5]; // S, M, H, DL, DH
+        uint8_t rtcLatched[5];
+        uint8_t rtcLatch;
+        time_t rtcLastTime;
+
+        void unload(); // Free the ROM and RAM
+
+        void parseHeader(); // Read controller type and RAM size
+        void updateBanks(); // Compute the banks from the registers and map them
+        void updateRtc(); // Advance the clock with the host time
+
+        int maskRomBank(const int &bank) const; // Wrap bank number to the ROM size
+};
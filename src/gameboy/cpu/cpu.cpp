@@ -8,6 +8,7 @@ using namespace std;
 #include "../logging/logger/logger.hpp"
 
 #include "cpu.hpp"
+#include "../savestate/savestate.hpp"
 
 /*
 
@@ -15,12 +16,14 @@ using namespace std;
 
 */
 
-CPU::CPU(Gameboy* gameboy) : gameboy(gameboy), logger(Logger::getInstance()->getLogger("CPU")), a(0), f(0), b(0), c(0), d(0), e(0), h(0), l(0), sp(0), pc(0) {
+CPU::CPU(Gameboy* gameboy) : gameboy(gameboy), logger(gameboy->getMasterLogger()->getLogger("CPU")), a(0), f(0), b(0), c(0), d(0), e(0), h(0), l(0), sp(0), pc(0), ime(0), halted(false), prefixed(0), microOps(nullptr), microOp(0), microCycles(0), branchTaken(false), idleLoop(), idleLoopStep(0), decodedPages(), decodedLookup(), immediate(0) {
     *logger << "CPU Constructor";
 }
 
 CPU::~CPU() {
     *logger << "CPU Destructor";
+
+    for(auto &page : this->decodedPages) delete page.second;
     
     delete logger;
 }
@@ -31,41 +34,103 @@ CPU::~CPU() {
 
 */
 
-void CPU::cycle() {
-    logger->log("CPU Cycle, PC: " + intToHex(this->pc));
+uint8_t CPU::cycle() {
+    logger->log("CPU Cycle, PC: ", toHex(this->pc));
+
+    this->idleLoopStep = 0;
+
+    // Halted until an interrupt is pending, it wakes the CPU even with IME reset
+    if(this->halted) {
+        if(!this->isInterruptPending()) return 4;
+        this->halted = false;
+    }
 
-    this->checkInterrupts();
+    const uint8_t interrupt = this->checkInterrupts() ? 4 * interruptMicroOps.length : 0;
 
     // Fetch the next instruction
-    const uint8_t& opcode = this->fetch();
+    const uint8_t opcode = this->fetch();
+
+    // Decode and execute the instruction, prefixed instructions go through the 0xCB handler
+    this->dispatch(opcode);
+
+    return interrupt + instructionCycles(opcode, this->prefixed);
+}
+
+uint8_t CPU::cycleTable() {
+    logger->log("CPU Cycle, PC: ", toHex(this->pc));
+
+    this->idleLoopStep = 0;
+
+    // Halted until an interrupt is pending, it wakes the CPU even with IME reset
+    if(this->halted) {
+        if(!this->isInterruptPending()) return 4;
+        this->halted = false;
+    }
+
+    const uint8_t interrupt = this->checkInterrupts() ? 4 * interruptMicroOps.length : 0;
+
+    // Fetch the next instruction
+    const uint8_t opcode = this->fetch();
+
+    // Decode and execute the instruction, one indirect call, prefixed instructions go through the 0xCB handler
+    (this->*opcodeTable[opcode])();
 
-    // Check for prefixed instructions
-    if(opcode == 0xCB) {
-        *logger << "Prefixed instruction";
+    return interrupt + instructionCycles(opcode, this->prefixed);
+}
+
+uint8_t CPU::cycleDecoded() {
+    logger->log("CPU Cycle, PC: ", toHex(this->pc));
 
-        this->pc ++;
-        return this->decodeAndExecutePrefixed(this->fetch());
+    this->idleLoopStep = 0;
+
+    // Halted until an interrupt is pending, it wakes the CPU even with IME reset
+    if(this->halted) {
+        if(!this->isInterruptPending()) return 4;
+        this->halted = false;
     }
 
-    // Decode and execute the instruction
-    return this->decodeAndExecute(opcode);
+    const uint8_t interrupt = this->checkInterrupts() ? 4 * interruptMicroOps.length : 0;
+
+    // Instruction already decoded in the page mapped there, the lookup is reset when the mapping changes
+    const DecodedLookup &entry = this->decodedLookup[this->pc >> 8];
+    const DecodedInstruction* instruction = entry.page ? &entry.page->instructions[this->pc & 0xFF] : nullptr;
+
+    if(!instruction || !instruction->handler) instruction = this->decode(this->pc);
+
+    // Not cacheable, fetched from memory
+    if(!instruction) {
+        const uint8_t opcode = this->fetch();
+        (this->*opcodeTable[opcode])();
+
+        return interrupt + instructionCycles(opcode, this->prefixed);
+    }
+
+    // The handler may drop the record (write to its own page)
+    const OpcodeThunk handler = instruction->handler;
+    const uint8_t cycles = instruction->cycles;
+    this->immediate = instruction->immediate;
+
+    handler(this);
+
+    // 0xCB across the end of the page, its prefixed opcode is only known once run
+    return interrupt + (cycles ? cycles : instructionCycles(0xCB, this->prefixed));
 }
 
-void CPU::checkInterrupts() {
+bool CPU::checkInterrupts() {
     // Check if an interrupt is pending and execute it
     if(this->ime) {
         // Read IF interrupt flag memory
-        uint8_t& ifRegister = (uint8_t&) this->gameboy->memory->fetch8(0xFF0F);
+        const uint8_t ifRegister = this->gameboy->memory->getIO(INTERRUPT_FLAG);
 
         // Read IE interrupt enable memory
-        uint8_t& ieRegister = (uint8_t&) this->gameboy->memory->fetch8(0xFFFF);
+        const uint8_t ieRegister = this->gameboy->memory->read8(INTERRUPT_ENABLE);
 
         // Check if any interrupt is pending
         for(uint8_t i = 0; i < 5; i++) {
             // Check if the interrupt is enabled
             if((ieRegister & (1 << i)) && (ifRegister & (1 << i))) {
                 // Clear the interrupt flag
-                ifRegister &= ~(1 << i);
+                this->gameboy->memory->setIO(INTERRUPT_FLAG, ifRegister & ~(1 << i));
 
                 // Set the interrupt master enable flag to 0
                 this->ime = 0;
@@ -83,1096 +148,57 @@ void CPU::checkInterrupts() {
                 }
 
                 // Log the interrupt
-                *logger << "Interrupt " + to_string(i) + " triggered, PC: " + intToHex(this->pc) + ", IF: " + intToHex(ifRegister) + ", IE: " + intToHex(ieRegister);
+                logger->log("Interrupt ", (int) i, " triggered, PC: ", toHex(this->pc), ", IF: ", toHex(ifRegister), ", IE: ", toHex(ieRegister));
                 
-                return;
+                return true;
             }
         }
     }
+
+    return false;
 }
 
-const uint8_t& CPU::fetch() const {
+uint8_t CPU::fetch() {
     // Fetch the next instruction
-    const uint8_t& opcode = (uint8_t&) this->gameboy->memory->fetch8(this->pc);
+    const uint8_t opcode = this->read8(this->pc);
 
-    *logger << "Fetched opcode: " + intToHex(opcode) + ", PC: " + intToHex(this->pc);
+    logger->log("Fetched opcode: ", toHex(opcode), ", PC: ", toHex(this->pc));
     return opcode;
 }
 
-void CPU::decodeAndExecute(const uint8_t& opcode) {
-    *logger << "Decoding opcode: " + intToHex(opcode) + ", PC: " + intToHex(this->pc);
-
-    const uint8_t high = opcode >> 4;
-    const uint8_t low = opcode & 0xF;
-
-    /*
-    
-        Switch case for LD on: r r, r [HL], [HL] r (lines 0x40 to 0x7F)
-    
-    */
-
-    if(high >= 0x4 && high <= 0x7) {
-        this->pc ++;
-
-        // Get operand
-        const uint8_t& r2 = this->getArith8Operand(low - (low <= 0x7 ? 0 : 0x8));
-
-        switch(high) {
-            case 0x4: {
-                if(low <= 0x7) { // LD B r
-                    logger->log("LD B r with r: " + intToHex(r2));
-                    return this->LD(this->b, r2);
-                } else { // LD C r
-                    logger->log("LD C r with r: " + intToHex(r2));
-                    return this->LD(this->c, r2);
-                }
-            } break;
-
-            case 0x5: {
-                if(low <= 0x7)  { // LD D r
-                    logger->log("LD D r with r: " + intToHex(r2));
-                    return this->LD(this->d, r2);
-                } else { // LD E r
-                    logger->log("LD E r with r: " + intToHex(r2));
-                    return this->LD(this->e, r2);
-                }
-            } break;
-
-            case 0x6: {
-                if(low <= 0x7) { // LD H r
-                    logger->log("LD H r with r: " + intToHex(r2));
-                    return this->LD(this->h, r2);
-                } else { // LD L r
-                    logger->log("LD L r with r: " + intToHex(r2));
-                    return this->LD(this->l, r2);
-                }
-            } break;
-
-            case 0x7: {
-                if(low != 6) {
-                    if(low <= 0x7) { // LD [HL] r
-                        uint16_t address = (this->h << 8) + this->l;
-    
-                        logger->log("LD [HL] r with r: " + intToHex(r2) + ", at address: " + intToHex(address));
-                        return this->LD((uint8_t&) this->gameboy->memory->fetch8(address), r2);
-                    } else { // LD A r
-                        logger->log("LD A r with r: " + intToHex(r2));
-                        return this->LD(this->a, r2);
-                    }
-                }
-            } break;
-        }
-    }
-
-    /*
-    
-        Other LD instructions, LD n8 r (0x02, 0x12, 0x22, 0x32, 0x06, 0x16, 0x26, 0x36, 0x0A, 0x1A, 0x2A, 0x3A, 0x0E, 0x1E, 0x2E, 0x3E)
-    
-    */
-
-    if(high <= 0x3) switch(low) {
-        case 0x2: {
-            logger->log("LD [rr], A");
-            this->pc ++;
-
-            // Fetch memory address reference
-            uint16_t address;
-            if(high == 0x0) address = ((uint16_t) this->b << 8) + this->c; // BC
-            else if(high == 0x1) address = (uint16_t) (this->d << 8) + this->e; // DE
-            else if(high == 0x2) { // HL+
-                address = ((uint16_t) this->h << 8) + this->l;
-
-                this->h = (address + 1) >> 8;
-                this->l = (address + 1) & 0xFF;
-            } else if(high == 0x3) { // HL-
-                address = ((uint16_t) this->h << 8) + this->l;
-
-                this->h = (address - 1) >> 8;
-                this->l = (address - 1) & 0xFF;
-            }
-
-            // Execute
-            return this->LD((uint8_t&) this->gameboy->memory->fetch8(address), this->a);
-        } break;
-
-        case 0x6: {
-            const uint8_t& value = (uint8_t&) this->gameboy->memory->fetch8(this->pc + 1);
-            this->pc += 2;
-
-            logger->log("LD r, n8 or LD [HL] n8 with n8: " + intToHex(value));
-
-            if(high == 0x0) return this->LD(this->b, value);
-            else if(high == 0x1) return this->LD(this->d, value);
-            else if(high == 0x2) return this->LD(this->h, value);
-            else if(high == 0x3) return this->LD((uint8_t&) this->gameboy->memory->fetch8((this->h << 8) + this->l), value);
-        } break;
-
-        case 0xA: {
-            this->pc ++;
-
-            // Fetch memory address reference
-            uint16_t address;
-            if(high == 0x0) address = ((uint16_t) this->b << 8) + this->c; // BC
-            else if(high == 0x1) address = ((uint16_t) this->d << 8) + this->e; // DE
-            else if(high == 0x2) { // HL+
-                address = ((uint16_t) this->h << 8) + this->l;
-
-                this->h = (address + 1) >> 8;
-                this->l = (address + 1) & 0xFF;
-            } else if(high == 0x3) { // HL-
-                address = ((uint16_t) this->h << 8) + this->l;
-
-                this->h = (address - 1) >> 8;
-                this->l = (address - 1) & 0xFF;
-            }
-
-            // Execute
-            logger->log("LD A, [adr] at adress: " + intToHex(address));
-            return this->LD(this->a, this->gameboy->memory->fetch8(address));
-        } break;
-
-        case 0xE: {
-            const uint8_t& value = (uint8_t&) this->gameboy->memory->fetch8(this->pc + 1);
-            this->pc += 2;
-
-            logger->log("LD r, n8 with n8: " + intToHex(value));
-
-            if(high == 0x0) return this->LD(this->c, value);
-            else if(high == 0x1) return this->LD(this->e, value);
-            else if(high == 0x2) return this->LD(this->l, value);
-            else if(high == 0x3) return this->LD(this->a, value);
-        } break;
-    }
-
-    /*
-    
-        LD 16 instructions, LD rr, n16 (0x01, 0x11, 0x21, 0x31)
-    
-    */
-
-    if(high <= 0x3) switch(low) {
-        case 0x1: {
-            const uint8_t& r4 = (uint8_t&) this->gameboy->memory->fetch8(this->pc + 1);
-            const uint8_t& r3 = (uint8_t&) this->gameboy->memory->fetch8(this->pc + 2);
-            this->pc += 3;
-
-            logger->log("LD rr, n16 with n16: " + intToHex((uint16_t) (r3 << 8) + r4));
-
-            if(high == 0x0) return this->LD(this->b, this->c, r3, r4);
-            else if(high == 0x1) return this->LD(this->d, this->e, r3, r4);
-            else if(high == 0x2) return this->LD(this->h, this->l, r3, r4);
-            else if(high == 0x3) return this->LD(this->sp, r3, r4);
-        } break;
-    }
-
-    /*
-    
-        Switch case for ADD, ADC, SUB, SBC, AND, XOR, OR, CP on: r r or r [HL] (lines 0x80 to 0xBF)
-    
-    */
-
-    if(high >= 0x8 && high <= 0xB) {
-        this->pc ++;
-
-        // Get operand
-        const uint8_t& r2 = this->getArith8Operand(low - (low <= 0x7 ? 0 : 0x8));
-
-        switch(high) {
-            case 0x8: {
-                if(low <= 0x7) { // ADD A, r
-                    logger->log("ADD A, r with r: " + intToHex(r2));
-                    return this->ADD(this->a, r2);
-                } else { // ADC A, r
-                    logger->log("ADC A, r with r: " + intToHex(r2));
-                    return this->ADDC(this->a, r2);
-                }
-            } break;
-
-            case 0x9: {
-                if(low <= 0x7) { // SUB A, r
-                    logger->log("SUB A, r with r: " + intToHex(r2));
-                    return this->SUB(this->a, r2);
-                } else { // SBC A, r
-                    logger->log("SBC A, r with r: " + intToHex(r2));
-                    return this->SUBC(this->a, r2);
-                }
-            } break;
-
-            case 0xA: {
-                if(low <= 0x7) {// AND A, r
-                    logger->log("AND A, r with r: " + intToHex(r2));
-                    return this->AND(this->a, r2);
-                } else { // XOR A, r
-                    logger->log("XOR A, r with r: " + intToHex(r2));
-                    return this->XOR(this->a, r2);
-                }
-            } break;
-
-            case 0xB: {
-                if(low <= 0x7) { // OR A, r
-                    logger->log("OR A, r with r: " + intToHex(r2));
-                    return this->OR(this->a, r2);
-                } else { // CP A, r
-                    logger->log("CP A, r with r: " + intToHex(r2));
-                    return this->CP(this->a, r2);
-                }
-            } break;
-        }
-    }
-
-    /*
-    
-        Switch case for INC, DEC on: r or [HL] (columns 0x03, 0x04, 0x05, 0x0B, 0x0C, 0x0D)
-    
-    */
-
-    if(high <= 0x3) {
-        switch(low) {
-            case 0x3: {
-                logger->log("INC rr");
-                return this->INC((uint8_t&) this->getIncDec8Operand(high), (uint8_t&) this->getIncDec8Operand(high + 0x4));
-            } break;
-
-            case 0x4: {
-                logger->log("INC r");
-                return this->INC((uint8_t&) this->getIncDec8Operand(high));
-            } break;
-
-            case 0x5: {
-                logger->log("DEC r");
-                return this->DEC((uint8_t&) this->getIncDec8Operand(high));
-            } break;
-
-            case 0xB: {
-                logger->log("DEC rr");
-                return this->DEC((uint8_t&) this->getIncDec8Operand(high), (uint8_t&) this->getIncDec8Operand(high + 0x4));
-            } break;
-
-            case 0xC: {
-                logger->log("INC r");
-                return this->INC((uint8_t&) this->getIncDec8Operand(high + 0x4));
-            } break;
-
-            case 0xD: {
-                logger->log("DEC r");
-                return this->DEC((uint8_t&) this->getIncDec8Operand(high + 0x4));
-            } break;
-        }
-    }
-
-    /*
-    
-        Other instructions
-    
-    */
-
-    switch(opcode) {
-        /*
-            0x0x instructions
-        */
-
-        case 0x00: {
-            logger->log("NOP");
-            this->pc++;
-
-            // return this->gameboy->stop();
-            return;
-        } break;
-
-        case 0x07: { // RLCA
-            logger->log("RLCA");
-            this->pc++;
-
-            return this->RLCA();
-        } break;
-
-        case 0x08: { // LD [n16], SP
-            uint8_t& adr_lsb = (uint8_t&) this->gameboy->memory->fetch8(this->pc + 1);
-            uint8_t& adr_msb = (uint8_t&) this->gameboy->memory->fetch8(this->pc + 2);
-
-            this->pc += 3;
-            return this->LD(adr_msb, adr_lsb, this->sp >> 8, this->sp & 0xFF);
-        } break;
-
-        case 0x09: { // ADD HL, BC
-            logger->log("ADD HL, BC");
-            this->pc++;
-
-            return this->ADD(this->h, this->l, this->b, this->c);
-        } break;
-
-        /*
-            0x1x instructions
-        */
-
-        case 0x10: { // STOP n8
-            logger->log("STOP");
-            return this->gameboy->stop();
-        } break;
-
-        case 0x17: { // RLA
-            logger->log("RLA");
-            this->pc++;
-
-            return this->RLA();
-        } break;
-
-        case 0x18: { // JR e8
-            const int8_t& e8 = (int8_t&) this->gameboy->memory->fetch8(this->pc + 1);
-            logger->log("JR e8 with value " + intToHex(e8));
-
-            this->pc += 2 + e8;
-            return;
-        } break;
-
-        case 0x19: { // ADD HL, DE
-            logger->log("ADD HL, DE");
-            this->pc ++;
-
-            return this->ADD(this->h, this->l, this->d, this->e);
-        } break;
-
-        case 0x1F: { // RRA
-            logger->log("RRA");
-            this->pc++;
-
-            return this->RRA();
-        } break;
-
-        /*
-            0x2x instructions
-        */
-
-        case 0x20: { // JR NZ, e8
-            const int8_t& e8 = (int8_t&) this->gameboy->memory->fetch8(this->pc + 1);
-            logger->log("JR NZ, e8 with value " + intToHex(e8));
-
-            this->pc += 2;
-            return this->JRN(e8, this->getZero());
-        } break;
-
-        case 0x27: { // DAA
-            logger->log("DAA");
-            this->pc++;
-
-            return this->DAA();
-        } break;
-
-        case 0x28: { // JR Z, e8
-            const int8_t& e8 = (int8_t&) this->gameboy->memory->fetch8(this->pc + 1);
-            logger->log("JR Z, e8 with value " + intToHex(e8));
-
-            this->pc += 2;
-            return this->JRS(e8, this->getZero());
-        } break;
-
-        case 0x29: { // ADD HL, HL
-            logger->log("ADD HL, HL");
-            this->pc++;
-
-            return this->ADD(this->h, this->l, this->h, this->l);
-        } break;
-
-        case 0x2F: { // CPL
-            logger->log("CPL");
-            this->pc++;
-
-            return this->CPL();
-        } break;
-
-        /*
-            0x3x instructions
-        */
-
-        case 0x30: { // JR NC, e8
-            const int8_t& e8 = (int8_t&) this->gameboy->memory->fetch8(this->pc + 1);
-            logger->log("JR NC, e8 with value " + intToHex(e8));
-
-            this->pc += 2;
-            return this->JRN(e8, this->getCarry());
-        } break;
-
-        case 0x37: { // SCF
-            logger->log("SCF");
-            this->pc++;
-
-            return this->SCF();
-        } break;
-
-        case 0x38: { // JR C, e8
-            const int8_t& e8 = (int8_t&) this->gameboy->memory->fetch8(this->pc + 1);
-            logger->log("JR C, e8 with value " + intToHex(e8));
-
-            this->pc += 2;
-            return this->JRS(e8, this->getCarry());
-        } break;
-
-        case 0x39: { // ADD HL, SP
-            logger->log("ADD HL, SP");
-            this->pc++;
-
-            return this->ADD(this->h, this->l, this->sp >> 8, this->sp & 0xFF);
-        } break;
-
-        /*
-            0xCx instructions
-        */
-
-        case 0xC0: { // RET NZ
-            logger->log("RET NZ");
-
-            this->pc++;
-
-            // Check if the zero flag is not set
-            if(this->getZero() == 0) {
-                return this->RET();
-            } else {
-                logger->log("Zero flag is set, skipping RET NZ");
-                return;
-            }
-        } break;
-
-        case 0xC1: { // POP BC
-            logger->log("POP BC");
-
-            this->pc++;
-            return this->POP(this->b, this->c);
-        } break;
-
-        case 0xC2: { // JP NZ, n16
-            const uint8_t& adr_lsb = (uint8_t&) this->gameboy->memory->fetch8(this->pc + 1);
-            const uint8_t& adr_msb = (uint8_t&) this->gameboy->memory->fetch8(this->pc + 2);
-            const uint16_t address = ((uint16_t) adr_msb << 8) + adr_lsb;
-
-            logger->log("JP NZ, n16 with address " + intToHex(address));
-
-            this->pc += 3;
-            return this->JPN(address, this->getZero());
-        } break;
-
-        case 0xC3: { // JP n16
-            const uint8_t& adr_lsb = (uint8_t&) this->gameboy->memory->fetch8(this->pc + 1);
-            const uint8_t& adr_msb = (uint8_t&) this->gameboy->memory->fetch8(this->pc + 2);
-            const uint16_t address = ((uint16_t) adr_msb << 8) + adr_lsb;
-
-            logger->log("JP n16 with address " + intToHex(address));
-
-            this->pc = address;
-            return;
-        } break;
-
-        case 0xC4: { // CALL NZ, n16
-            const uint8_t& adr_lsb = (uint8_t&) this->gameboy->memory->fetch8(this->pc + 1);
-            const uint8_t& adr_msb = (uint8_t&) this->gameboy->memory->fetch8(this->pc + 2);
-            const uint16_t address = ((uint16_t) adr_msb << 8) + adr_lsb;
-
-            logger->log("CALL NZ, n16 with address " + intToHex(address));
-
-            this->pc += 3;
-            return this->CALLN(address, this->getZero());
-        } break;
-
-        case 0xC5: { // PUSH BC
-            logger->log("PUSH rr");
-
-            this->pc++;
-            return this->PUSH(this->b, this->c);
-        } break;
-
-        case 0xC6: { // ADD A, n8
-            const uint8_t& value = (uint8_t&) this->gameboy->memory->fetch8(this->pc + 1);
-            logger->log("ADD A, n8 with value " + intToHex(value));
-
-            this->pc += 2;
-            return this->ADD(this->a, value);
-        } break;
-
-        case 0xC7: { // RST 00
-            logger->log("RST 00");
-
-            return this->RST(0x00);
-        } break;
-
-        case 0xC8: { // RET Z
-            logger->log("RET Z");
-
-            this->pc++;
-
-            // Check if the zero flag is set
-            if(this->getZero() == 1) {
-                return this->RET();
-            } else {
-                logger->log("Zero flag is not set, skipping RET Z");
-                return;
-            }
-        } break;
-
-        case 0xC9: { // RET
-            logger->log("RET");
-
-            this->pc++;
-            return this->RET();
-        } break;
-
-        case 0xCA: { // JP Z, n16
-            const uint8_t& adr_lsb = (uint8_t&) this->gameboy->memory->fetch8(this->pc + 1);
-            const uint8_t& adr_msb = (uint8_t&) this->gameboy->memory->fetch8(this->pc + 2);
-            const uint16_t address = ((uint16_t) adr_msb << 8) + adr_lsb;
-
-            logger->log("JP Z, n16 with address " + intToHex(address));
-
-            this->pc += 3;
-            return this->JPS(address, this->getZero());
-        } break;
-
-
-        case 0xCC: { // CALL Z, n16
-            const uint8_t& adr_lsb = (uint8_t&) this->gameboy->memory->fetch8(this->pc + 1);
-            const uint8_t& adr_msb = (uint8_t&) this->gameboy->memory->fetch8(this->pc + 2);
-            const uint16_t address = ((uint16_t) adr_msb << 8) + adr_lsb;
-
-            logger->log("CALL Z, n16 with address " + intToHex(address));
-
-            this->pc += 3;
-            return this->CALLS(address, this->getZero());
-        } break;
-
-        case 0xCD: { // CALL n16
-            const uint8_t& adr_lsb = (uint8_t&) this->gameboy->memory->fetch8(this->pc + 1);
-            const uint8_t& adr_msb = (uint8_t&) this->gameboy->memory->fetch8(this->pc + 2);
-            const uint16_t address = ((uint16_t) adr_msb << 8) + adr_lsb;
-
-            logger->log("CALL n16 with address " + intToHex(address));
-
-            this->pc += 3;
-            return this->CALL(address);
-        } break;
-
-        case 0xCE: { // ADC A, n8
-            const uint8_t& value = (uint8_t&) this->gameboy->memory->fetch8(this->pc + 1);
-            logger->log("ADC A, n8 with value " + intToHex(value));
-
-            this->pc += 2;
-            return this->ADDC(this->a, value);
-        } break;
-
-        case 0xCF: { // RST 08
-            logger->log("RST 08");
-
-            return this->RST(0x08);
-        } break;
-
-        /*
-            0xDx instructions
-        */
-
-        case 0xD0: { // RET NC
-            logger->log("RET NC");
-
-            this->pc++;
-
-            // Check if the carry flag is not set
-            if(this->getCarry() == 0) {
-                return this->RET();
-            } else {
-                logger->log("Carry flag is set, skipping RET NC");
-                return;
-            }
-        } break;
-
-        case 0xD1: { // POP DE
-            logger->log("POP DE");
-
-            this->pc++;
-            return this->POP(this->d, this->e);
-        } break;
-
-        case 0xD2:{ // JP NC, n16
-            const uint8_t& adr_lsb = (uint8_t&) this->gameboy->memory->fetch8(this->pc + 1);
-            const uint8_t& adr_msb = (uint8_t&) this->gameboy->memory->fetch8(this->pc + 2);
-            const uint16_t address = ((uint16_t) adr_msb << 8) + adr_lsb;
-
-            logger->log("JP NC, n16 with address " + intToHex(address));
-
-            this->pc += 3;
-            return this->JPN(address, this->getCarry());
-        }
-
-        case 0xD4: { // CALL NC, n16
-            const uint8_t& adr_lsb = (uint8_t&) this->gameboy->memory->fetch8(this->pc + 1);
-            const uint8_t& adr_msb = (uint8_t&) this->gameboy->memory->fetch8(this->pc + 2);
-            const uint16_t address = ((uint16_t) adr_msb << 8) + adr_lsb;
-
-            logger->log("CALL NC, n16 with address " + intToHex(address));
-
-            this->pc += 3;
-            return this->CALLN(address, this->getCarry());
-        } break;
-
-        case 0xD5: { // PUSH DE
-            logger->log("PUSH DE");
-
-            this->pc++;
-            return this->PUSH(this->d, this->e);
-        } break;
-
-        case 0xD6: { // SUB A, n8
-            const uint8_t& value = (uint8_t&) this->gameboy->memory->fetch8(this->pc + 1);
-            logger->log("SUB A, n8 with value " + intToHex(value));
-
-            this->pc += 2;
-            return this->SUB(this->a, value);
-        } break;
-
-        case 0xD7: { // RST 10
-            logger->log("RST 10");
-
-            return this->RST(0x10);
-        } break;
-
-        case 0xD8: { // RET C
-            logger->log("RET C");
-
-            this->pc++;
-
-            // Check if the carry flag is set
-            if(this->getCarry() == 1) {
-                return this->RET();
-            } else {
-                logger->log("Carry flag is not set, skipping RET C");
-                return;
-            }
-        } break;
-
-        case 0xD9: { // RETI
-            logger->log("RETI");
-
-            // Set the interrupt master enable flag to 1
-            this->ime = 1;
-
-            this->pc++;
-            return this->RET();
-        } break;
-
-        case 0xDA: { // JP C, n16
-            const uint8_t& adr_lsb = (uint8_t&) this->gameboy->memory->fetch8(this->pc + 1);
-            const uint8_t& adr_msb = (uint8_t&) this->gameboy->memory->fetch8(this->pc + 2);
-            const uint16_t address = ((uint16_t) adr_msb << 8) + adr_lsb;
-
-            logger->log("JP C, n16 with address " + intToHex(address));
-
-            this->pc += 3;
-            return this->JPS(address, this->getCarry());
-        } break;
-
-        case 0xDC: { // CALL C, n16
-            const uint8_t& adr_lsb = (uint8_t&) this->gameboy->memory->fetch8(this->pc + 1);
-            const uint8_t& adr_msb = (uint8_t&) this->gameboy->memory->fetch8(this->pc + 2);
-            const uint16_t address = ((uint16_t) adr_msb << 8) + adr_lsb;
-
-            logger->log("CALL C, n16 with address " + intToHex(address));
-
-            this->pc += 3;
-            return this->CALLS(address, this->getCarry());
-        } break;
-
-        case 0xDE: { // SBC A, n8
-            const uint8_t& value = (uint8_t&) this->gameboy->memory->fetch8(this->pc + 1);
-            logger->log("SBC A, n8 with value " + intToHex(value));
-
-            this->pc += 2;
-            return this->SUBC(this->a, value);
-        } break;
-
-        case 0xDF: { // RST 18
-            logger->log("RST 18");
-
-            return this->RST(0x18);
-        } break;
-
-        /*
-            0xEx instructions
-        */
-
-        case 0xE0: { // LD [FF00 + n8], A
-            const uint8_t& value = (uint8_t&) this->gameboy->memory->fetch8(this->pc + 1);
-            logger->log("LD [FF00 + n8], A with n8 value " + intToHex(value));
-
-            this->pc += 2;
-            return this->LD((uint8_t&) this->gameboy->memory->fetch8(0xFF00 + value), this->a);
-        } break;
-
-        case 0xE1: { // POP HL
-            logger->log("POP HL");
-
-            this->pc++;
-            return this->POP(this->h, this->l);
-        } break;
-
-        case 0xE2: { // LD [FF00 + C], A
-            logger->log("LD [FF00 + C], A with C value " + intToHex(this->c) + ", A: " + intToHex(this->a));
-
-            this->pc++;
-            return this->LD((uint8_t&) this->gameboy->memory->fetch8(0xFF00 + this->c), this->a);
-        } break;
-
-        case 0xE5: { // PUSH rr
-            logger->log("PUSH rr");
-
-            this->pc++;
-            return this->PUSH(this->h, this->l);
-        } break;
-
-        case 0xE6: { // AND A, n8
-            const uint8_t& value = (uint8_t&) this->gameboy->memory->fetch8(this->pc + 1);
-            logger->log("AND A, n8 with value " + intToHex(value));
-
-            this->pc += 2;
-            return this->AND(this->a, value);
-        } break;
-
-        case 0xE7: { // RST 20
-            logger->log("RST 20");
-
-            return this->RST(0x20);
-        } break;
-
-        case 0xE8: { // ADD SP, e8
-            const int8_t& e8 = (int8_t&) this->gameboy->memory->fetch8(this->pc + 1);
-            logger->log("ADD SP, e8 with value " + intToHex(e8));
-
-            this->pc += 2;
-            return this->ADD(this->sp, e8);
-        } break;
-
-        case 0xE9: { // JP HL
-            logger->log("JP HL");
-
-            this->pc = (this->h << 8) + this->l;
-            return;
-        } break;
-
-        case 0xEA: { // LD [adr], A
-            const uint8_t& adr_lsb = (uint8_t&) this->gameboy->memory->fetch8(this->pc + 1);
-            const uint8_t& adr_msb = (uint8_t&) this->gameboy->memory->fetch8(this->pc + 2);
-            const uint16_t address = ((uint16_t) adr_msb << 8) + adr_lsb;
-
-            logger->log("LD [adr], A with address " + intToHex(address));
-
-            this->pc += 3;
-            return this->LD((uint8_t&) this->gameboy->memory->fetch8(address), this->a);
-        } break;
-
-        case 0xEE: { // XOR A, n8
-            const uint8_t& value = (uint8_t&) this->gameboy->memory->fetch8(this->pc + 1);
-            logger->log("XOR A, n8 with value " + intToHex(value));
-
-            this->pc += 2;
-            return this->XOR(this->a, value);
-        } break;
-
-        case 0xEF: { // RST 28
-            logger->log("RST 28");
-
-            return this->RST(0x28);
-        } break;
-
-        /*
-            0xFx instructions
-        */
-
-        case 0xF0: { // LD A, [FF00 + a8]
-            const uint8_t& value = (uint8_t&) this->gameboy->memory->fetch8(this->pc + 1);
-            logger->log("LD A, [FF00 + a8] with value " + intToHex(value));
-
-            this->pc += 2;
-            return this->LD(this->a, this->gameboy->memory->fetch8(0xFF00 + value));
-        } break;
-
-        case 0xF1: { // POP AF
-            logger->log("POP AF");
-
-            this->pc++;
-            return this->POP(this->a, this->f);
-        } break;
-
-        case 0xF2: { // LD A, [FF00 + C]
-            logger->log("LD A, [FF00 + C] with C value " + intToHex(this->c) + ", A: " + intToHex(this->a));
-
-            this->pc++;
-            return this->LD(this->a, this->gameboy->memory->fetch8(0xFF00 + this->c));
-        } break;
-
-        case 0xF3: { // DI
-            logger->log("DI");
-            this->pc++;
-
-            this->ime = 0;
-            return;
-        } break;
-
-        case 0xF5: { // PUSH AF
-            logger->log("PUSH AF");
-
-            this->pc++;
-        
-            return this->PUSH(this->a, this->f);
-        } break;
-
-        case 0xF6: { // OR A, n8
-            const uint8_t& value = (uint8_t&) this->gameboy->memory->fetch8(this->pc + 1);
-            logger->log("OR A, n8 with value " + intToHex(value));
-
-            this->pc += 2;
-            return this->OR(this->a, value);
-        } break;
-
-        case 0xF7: { // RST 30
-            logger->log("RST 30");
-
-            return this->RST(0x30);
-        } break;
-
-        case 0xF8: { // LD HL, SP + e8
-            const int8_t& e8 = (int8_t&) this->gameboy->memory->fetch8(this->pc + 1);
-            logger->log("LD HL, SP + e8 with value " + intToHex(e8));
-
-            this->pc += 2;
-            return this->LD(this->h, this->l, this->sp + e8);
-        } break;
-
-        case 0xF9: { // LD SP, HL
-            logger->log("LD SP, HL");
-
-            this->pc++;
-            return this->LD(this->sp, this->h, this->l);
-        } break;
-
-        case 0xFA: { // LD A [adr]
-            const uint8_t& adr_lsb = (uint8_t&) this->gameboy->memory->fetch8(this->pc + 1);
-            const uint8_t& adr_msb = (uint8_t&) this->gameboy->memory->fetch8(this->pc + 2);
-            const uint16_t address = ((uint16_t) adr_msb << 8) + adr_lsb;
-
-            logger->log("LD A, [adr] with address " + intToHex(address));
-
-            this->pc += 3;
-            return this->LD(this->a, this->gameboy->memory->fetch8(address));
-        } break;
-
-        case 0xFB: { // EI
-            logger->log("EI");
-            this->pc++;
-
-            this->ime = 1;
-            return;
-        } break;
-
-        case 0xFE: { // CP A, n8
-            const uint8_t& value = (uint8_t&) this->gameboy->memory->fetch8(this->pc + 1);
-            logger->log("CP A, n8 with n value " + intToHex(value) + ", A: " + intToHex(this->a));
-
-            this->pc += 2;
-            return this->CP(this->a, value);
-        } break;
-
-        case 0xFF: { // RST 38
-            logger->log("RST 38");
-
-            return this->RST(0x38);
-        } break;
-    }
-
-    /*
-    
-        Switch case for custom instructions, DUMPR, DUMPW, DUMPV (0xE3, 0xE4, 0xEB, 0xEC, 0xED)
-    
-    */
-
-    switch(high) {
-        case 0xE: {
-            if(low == 0xB) {
-                this->pc++;
-                return this->DUMPR();
-            } else if(low == 0xC) {
-                // Read PC + 1 and PC + 2 to get the adress
-                const uint8_t& r2 = (uint8_t&) this->gameboy->memory->fetch8(this->pc + 1);
-                const uint8_t& r3 = (uint8_t&) this->gameboy->memory->fetch8(this->pc + 2);
-
-                const uint16_t address = ((uint16_t) r2 << 8) + r3;
-
-                this->pc += 3;
-                return logger->log("\033[34mAddress: " + intToHex(address) + " Value: " + intToHex((uint8_t&) this->gameboy->memory->fetch8(address)) + "\033[0m");
-            }
-        } break;
-    }
-
-    logger->error("Unknown opcode: " + intToHex(opcode));
-    this->gameboy->stop();
-}
-
 /*
 
-    Decode and execute prefixed instructions
+    Memory access
 
 */
 
-void CPU::decodeAndExecutePrefixed(const uint8_t& opcode) {
-    *logger << "Decoding prefixed opcode: " + intToHex(opcode) + ", PC: " + intToHex(this->pc);
-
-    const uint8_t high = opcode >> 4;
-    const uint8_t low = opcode & 0xF;
-
-    if(high == 0x1) {
-        if(low <= 0x7) { // RL r
-            uint8_t& r = this->getArith8Operand(low);
-            logger->log("RL r with r: " + intToHex(r));
-
-            this->pc ++;
-            return this->RL(r);
-        } else { // RR r
-            uint8_t& r = this->getArith8Operand(low - 0x8);
-            logger->log("RR r with r: " + intToHex(r));
-
-            this->pc ++;
-            return this->RR(r);
-        }
-    }
-
-    if(high == 0x2) {
-        if(low <= 0x7) { // SLA r
-            uint8_t& r = this->getArith8Operand(low);
-            logger->log("SLA r with r: " + intToHex(r));
-
-            this->pc ++;
-            return this->SLA(r);
-        } else { // SRA r
-            // uint8_t& r = this->getArith8Operand(low - 0x8);
-            // logger->log("SRA r with r: " + intToHex(r));
-
-            // this->pc ++;
-            // return this->SRA(r);
-        }
-    }
-
-    if(high == 0x3) { // SWAP r
-        if(low <= 0x7) {
-            this->pc ++;
-            uint8_t& r = this->getArith8Operand(low);
-
-            logger->log("SWAP r with r: " + intToHex(r));
-            return this->SWAP(r);
-        } else { // SLR
-            this->pc ++;
-            uint8_t& r = this->getArith8Operand(low - 0x8);
-
-            logger->log("SRL r with r: " + intToHex(r));
-            return this->SRL(r);
-        }
-    }
-
-    if(high >= 0x4 && high <= 0x7) {
-        this->pc ++;
-        const uint8_t& r = this->getArith8Operand(low - (low <= 0x7 ? 0 : 0x8));
-        
-        if(low <= 0x7) {
-            logger->log("BIT " + to_string(((high * 2) - (0x4 * 2))) + ", r with r: " + intToHex(r));
-            return this->BIT((high * 2) - (0x4 * 2), r);
-        } else {
-            logger->log("BIT " + to_string(((high * 2) - (0x4 * 2) + 1)) + ", r with r: " + intToHex(r));
-            return this->BIT((high * 2) - (0x4 * 2) + 1, r);
-        }
-    }
-
-    if(high >= 0x8 && high <= 0xB) {
-        this->pc ++;
-        uint8_t& r = this->getArith8Operand(low - (low <= 0x7 ? 0 : 0x8));
-
-        if(low <= 0x7) {
-            logger->log("RES " + to_string(((high * 2) - (0x8 * 2))) + ", r with r: " + intToHex(r));
-            return this->RES((high * 2) - (0x8 * 2), r);
-        } else {
-            logger->log("RES " + to_string(((high * 2) - (0x8 * 2) + 1)) + ", r with r: " + intToHex(r));
-            return this->RES((high * 2) - (0x8 * 2) + 1, r);
-        }
-    }
-
-    if(high >= 0xC && high <= 0xF) {
-        this->pc ++;
-        uint8_t& r = this->getArith8Operand(low - (low <= 0x7 ? 0 : 0x8));
+uint8_t CPU::read8(const uint16_t &address) {
+    if(this->microOps) this->busAccess();
 
-        if(low <= 0x7) {
-            logger->log("SET " + to_string(((high * 2) - (0xC * 2))) + ", r with r: " + intToHex(r));
-            return this->SET((high * 2) - (0xC * 2), r);
-        } else {
-            logger->log("SET " + to_string(((high * 2) - (0xC * 2) + 1)) + ", r with r: " + intToHex(r));
-            return this->SET((high * 2) - (0xC * 2) + 1, r);
-        }
-    }
+    // OAM DMA holds the bus of its source and OAM
+    Memory* memory = this->gameboy->memory;
+    if(memory->isDmaActive() && memory->isDmaConflict(address)) return 0xFF;
 
-    logger->error("Unknown prefixed opcode: " + intToHex(opcode));
-    this->gameboy->stop();
+    return memory->read8(address);
 }
 
-/*
-
-    Util to select the r operand for ADD, ADC, SUB, SBC, AND, XOR, OR, CP
-
-*/
-
-uint8_t& CPU::getArith8Operand(const uint8_t& opcode) {
-    switch(opcode) {
-        case 0x0: return this->b;
-        case 0x1: return this->c;
-        case 0x2: return this->d;
-        case 0x3: return this->e;
-        case 0x4: return this->h;
-        case 0x5: return this->l;
-
-        case 0x6: {
-            const uint16_t address = ((uint16_t) this->h << 8) + this->l;
-            return (uint8_t&) this->gameboy->memory->fetch8(address);
-        }
+void CPU::write8(const uint16_t &address, const uint8_t &value) {
+    if(this->microOps) this->busAccess();
 
-        case 0x7: return this->a;
+    Memory* memory = this->gameboy->memory;
+    if(memory->isDmaActive() && memory->isDmaConflict(address)) return;
 
-        default: {
-            logger->error("Unknown operand: " + intToHex(opcode));
-            this->gameboy->stop();
-
-            return this->a; // Return default value
-        }
-    }
+    memory->write8(address, value);
 }
 
 /*
 
-    Util to select the r operand for INC, DEC
+    HALT
 
 */
 
-uint8_t& CPU::getIncDec8Operand(const uint8_t& opcode) {
-    switch(opcode) {
-        case 0x0: return this->b;
-        case 0x1: return this->d;
-        case 0x2: return this->h;
-
-        case 0x3: {
-            const uint16_t address = ((uint16_t) this->h << 8) + this->l;
-            return (uint8_t&) this->gameboy->memory->fetch8(address);
-        }
-
-        case 0x4: return this->c;
-        case 0x5: return this->e;
-        case 0x6: return this->l;
-        case 0x7: return this->a;
-
-        default: {
-            logger->error("Unknown operand: " + intToHex(opcode));
-            this->gameboy->stop();
-
-            return this->a; // Return default value
-        }
-    }
+void CPU::HALT() { // 0x76 -> stop until an interrupt is pending, the HALT bug (IME reset and interrupt already pending) is not emulated
+    if(!this->isInterruptPending()) this->halted = true;
 }
 
 /*
@@ -1182,19 +208,31 @@ uint8_t& CPU::getIncDec8Operand(const uint8_t& opcode) {
 */
 
 void CPU::JRN(const int8_t& e8, const uint8_t& flag) { // 0x20, 0x30 -> jump to pc + e8 if z flag, c flag RESET respectively
-    if(flag == 0) this->pc += e8;
+    if(flag != 0) return;
+
+    this->pc += e8;
+    this->takeBranch(0x20);
 }
 
 void CPU::JRS(const int8_t& e8, const uint8_t& flag) { // 0x18, 0x28 -> jump to pc + e8 if z flag, c flag SET respectively
-    if(flag == 1) this->pc += e8;
+    if(flag != 1) return;
+
+    this->pc += e8;
+    this->takeBranch(0x28);
 }
 
 void CPU::JPN(const uint16_t& address, const uint8_t& flag) { // 0xC2, 0xD2 -> jump to address if z flag, c flag RESET respectively
-    if(flag == 0) this->pc = address;
+    if(flag != 0) return;
+
+    this->pc = address;
+    this->takeBranch(0xC2);
 }
 
 void CPU::JPS(const uint16_t& address, const uint8_t& flag) { // 0xCA, 0xDA -> jump to address if z flag, c flag SET respectively
-    if(flag == 1) this->pc = address;
+    if(flag != 1) return;
+
+    this->pc = address;
+    this->takeBranch(0xCA);
 }
 
 
@@ -1206,7 +244,7 @@ LDH A, [FF00 + n8]
 */
 
 // void CPU::LDH(uint8_t &r1, const uint8_t &r2) {
-//     r1 = this->gameboy->memory->fetch8(0xFF00 + r2);
+//     r1 = this->read8(0xFF00 + r2);
 // }
 
 
@@ -1218,67 +256,77 @@ LDH A, [FF00 + n8]
 */
 
 void CPU::ADD(uint8_t &r1, const uint8_t &r2) {
-    // Add r2 to r1
-    const uint8_t result = r1 + r2;
-    r1 = result;
+    // Add r2 to r1, the carries come from the operands
+    const uint16_t result = r1 + r2;
 
     this->resetSub();
 
-    if(r1 == 0) this->setZero();
+    if((uint8_t) result == 0) this->setZero();
     else this->resetZero();
 
     if(halfCarryOnAddition(r1, r2)) this->setHalfCarry();
     else this->resetHalfCarry();
 
-    if(r1 < r2) this->setCarry();
+    if(result > 0xFF) this->setCarry();
     else this->resetCarry();
+
+    r1 = result;
 }
 
 
 void CPU::ADD(uint16_t &r1, const int8_t &r2) {
-    // Add r2 to r1
-    const uint16_t result = r1 + r2;
-    r1 = result;
+    // Add r2 to r1, H and C come from the unsigned addition of the low byte
+    const uint8_t low = r1 & 0xFF;
+    const uint8_t offset = (uint8_t) r2;
 
+    this->resetZero();
     this->resetSub();
 
-    if(halfCarryOnAddition(r1, r2)) this->setHalfCarry();
+    if(halfCarryOnAddition(low, offset)) this->setHalfCarry();
     else this->resetHalfCarry();
 
-    if(r1 < r2) this->setCarry();
+    if(low + offset > 0xFF) this->setCarry();
     else this->resetCarry();
+
+    r1 = r1 + r2;
 }
 
 void CPU::ADDC(uint8_t &r1, const uint8_t &r2) {
-    // Add r2 to r1
-    const uint8_t result = r1 + r2 + this->getCarry();
-    r1 = result;
+    // Add r2 and the carry to r1
+    const uint8_t carry = this->getCarry();
+    const uint16_t result = r1 + r2 + carry;
 
     this->resetSub();
 
-    if(r1 == 0) this->setZero();
+    if((uint8_t) result == 0) this->setZero();
     else this->resetZero();
 
-    if(halfCarryOnAddition(r1, r2)) this->setHalfCarry();
+    if((r1 & 0x0F) + (r2 & 0x0F) + carry > 0x0F) this->setHalfCarry();
     else this->resetHalfCarry();
 
-    if(r1 < r2) this->setCarry();
+    if(result > 0xFF) this->setCarry();
     else this->resetCarry();
+
+    r1 = result;
 }
 
 void CPU::ADD(uint8_t &r1, uint8_t &r2, const uint8_t &r3, const uint8_t &r4) {
     // Add r2 to r1
     const uint16_t result = ((uint16_t) r1 << 8) + r2 + ((uint16_t) r3 << 8) + r4;
 
+    const uint16_t left = ((uint16_t) r1 << 8) + r2;
+    const uint16_t right = ((uint16_t) r3 << 8) + r4;
+
     r1 = result >> 8;
     r2 = result & 0xFF;
 
+    // Z is kept, H from bit 11 and C from bit 15
     this->resetSub();
 
-    if(halfCarryOnAddition(result, ((uint16_t) r3 << 8) + r4)) this->setHalfCarry();
+    if((left & 0x0FFF) + (right & 0x0FFF) > 0x0FFF) this->setHalfCarry();
     else this->resetHalfCarry();
 
-    if(r1 < r2) this->setCarry();
+    if(left + right > 0xFFFF) this->setCarry();
     else this->resetCarry();
 }
 
@@ -1289,37 +337,29 @@ void CPU::ADD(uint8_t &r1, uint8_t &r2, const uint8_t &r3, const uint8_t &r4) {
 */
 
 void CPU::SUB(uint8_t &r1, const uint8_t &r2) {
-    // Subtract r2 from r1
-    const uint8_t result = r1 - r2;
-    r1 = result;
-
-    this->setSub();
+    // Subtract r2 from r1, C is the borrow, set when r2 is above r1
+    this->CP(r1, r2);
 
-    if(r1 == 0) this->setZero();
-    else this->resetZero();
-
-    if(halfCarryOnSubtration(r1, r2)) this->setHalfCarry();
-    else this->resetHalfCarry();
-
-    if(r1 > r2) this->setCarry();
-    else this->resetCarry();
+    r1 = r1 - r2;
 }
 
 void CPU::SUBC(uint8_t &r1, const uint8_t &r2) {
-    // Subtract r2 from r1
-    const uint8_t result = r1 - r2 - this->getCarry();
-    r1 = result;
+    // Subtract r2 and the carry from r1
+    const uint8_t carry = this->getCarry();
+    const int result = r1 - r2 - carry;
 
     this->setSub();
 
-    if(r1 == 0) this->setZero();
+    if((uint8_t) result == 0) this->setZero();
     else this->resetZero();
 
-    if(halfCarryOnSubtration(r1, r2)) this->setHalfCarry();
+    if((int) (r1 & 0x0F) - (int) (r2 & 0x0F) - carry < 0) this->setHalfCarry();
     else this->resetHalfCarry();
 
-    if(r1 > r2) this->setCarry();
+    if(result < 0) this->setCarry();
     else this->resetCarry();
+
+    r1 = result;
 }
 
 /*
@@ -1340,7 +380,7 @@ void CPU::CP(const uint8_t &r1, const uint8_t &r2) {
     if(halfCarryOnSubtration(r1, r2)) this->setHalfCarry();
     else this->resetHalfCarry();
 
-    if(r1 > r2) this->setCarry();
+    if(r1 < r2) this->setCarry();
     else this->resetCarry();
 }
 
@@ -1360,7 +400,8 @@ void CPU::INC(uint8_t &r1) {
     if(r1 == 0) this->setZero();
     else this->resetZero();
 
-    if(halfCarryOnAddition(r1, 1)) this->setHalfCarry();
+    // Carry out of the low nibble, it wrapped to 0
+    if((r1 & 0x0F) == 0) this->setHalfCarry();
     else this->resetHalfCarry();
 
     this->pc ++;
@@ -1392,7 +433,8 @@ void CPU::DEC(uint8_t &r1) {
     if(r1 == 0) this->setZero();
     else this->resetZero();
 
-    if(halfCarryOnSubtration(r1, 1)) this->setHalfCarry();
+    // Borrow from the high nibble, the low nibble wrapped to 0xF
+    if((r1 & 0x0F) == 0x0F) this->setHalfCarry();
     else this->resetHalfCarry();
 
     this->pc ++;
@@ -1505,18 +547,18 @@ void CPU::SCF() {
 void CPU::DAA() {
     uint8_t adjustment = 0;
 
+    // After a subtraction C is kept, after an addition it is set when the high digit overflows
     if(this->getSub()) {
         if(this->getHalfCarry()) adjustment += 0x06;
         if(this->getCarry()) adjustment += 0x60;
 
-        this->resetCarry();
-
         this->a -= adjustment;
     } else {
         if(this->getHalfCarry() || (this->a & 0x0F) > 9) adjustment += 0x06;
-        if(this->getCarry() || this->a > 0x99) adjustment += 0x60;
-
-        this->setCarry();
+        if(this->getCarry() || this->a > 0x99) {
+            adjustment += 0x60;
+            this->setCarry();
+        }
 
         this->a += adjustment;
     }
@@ -1588,12 +630,10 @@ void CPU::BIT(const uint8_t &bit, const uint8_t &r) {
 void CPU::PUSH(const uint8_t &r1, const uint8_t &r2) {
     // Push r1 and r2 onto the stack
     this->sp--;
-    uint8_t& m1 = (uint8_t&) this->gameboy->memory->fetch8(this->sp);
-    m1 = r1;
+    this->write8(this->sp, r1);
 
     this->sp--;
-    uint8_t& m2 = (uint8_t&) this->gameboy->memory->fetch8(this->sp);
-    m2 = r2;
+    this->write8(this->sp, r2);
 }
 
 /*
@@ -1609,6 +649,8 @@ void CPU::CALL(const uint16_t &adr) {
 
 void CPU::CALLN(const uint16_t &adr, const uint8_t &flag) {
     if(flag == 0) {
+        this->takeBranch(0xC4);
+
         this->PUSH(this->pc >> 8, this->pc & 0xFF);
         this->pc = adr;
     }
@@ -1617,6 +659,8 @@ void CPU::CALLN(const uint16_t &adr, const uint8_t &flag) {
 
 void CPU::CALLS(const uint16_t &adr, const uint8_t &flag) {
     if(flag == 1) {
+        this->takeBranch(0xCC);
+
         this->PUSH(this->pc >> 8, this->pc & 0xFF);
         this->pc = adr;
     }
@@ -1628,10 +672,10 @@ void CPU::CALLS(const uint16_t &adr, const uint8_t &flag) {
 */
 
 void CPU::RET() {
-    const uint8_t& m1 = (uint8_t&) this->gameboy->memory->fetch8(this->sp);
+    const uint8_t m1 = this->read8(this->sp);
     this->sp++;
 
-    const uint8_t& m2 = (uint8_t&) this->gameboy->memory->fetch8(this->sp);
+    const uint8_t m2 = this->read8(this->sp);
     this->sp++;
 
     this->pc = ((uint16_t) m2 << 8) + m1;
@@ -1644,13 +688,40 @@ void CPU::RET() {
 */
 
 void CPU::RL(uint8_t &r) {
-    // Rotate r left
+    // Rotate r left through the carry
     const uint8_t carry = this->getCarry();
     this->resetCarry();
 
     if(r & 0x80) this->setCarry();
 
     r = (r << 1) + carry;
+
+    this->resetSub();
+    this->resetHalfCarry();
+
+    if(r == 0) this->setZero();
+    else this->resetZero();
+}
+
+/*
+
+    RLC
+
+*/
+
+void CPU::RLC(uint8_t &r) {
+    // Rotate r left, bit 7 goes to the carry and bit 0
+    this->resetCarry();
+
+    if(r & 0x80) this->setCarry();
+
+    r = (r << 1) | (r >> 7);
+
+    this->resetSub();
+    this->resetHalfCarry();
+
+    if(r == 0) this->setZero();
+    else this->resetZero();
 }
 
 /*
@@ -1660,10 +731,10 @@ void CPU::RL(uint8_t &r) {
 */
 
 void CPU::POP(uint8_t &r1, uint8_t &r2) {
-    const uint8_t& m1 = (uint8_t&) this->gameboy->memory->fetch8(this->sp);
+    const uint8_t m1 = this->read8(this->sp);
     this->sp++;
 
-    const uint8_t& m2 = (uint8_t&) this->gameboy->memory->fetch8(this->sp);
+    const uint8_t m2 = this->read8(this->sp);
     this->sp++;
 
     r1 = m2;
@@ -1684,6 +755,10 @@ void CPU::RLA() {
     if(this->a & 0x80) this->setCarry();
 
     this->a = (this->a << 1) + carry;
+
+    this->resetZero();
+    this->resetSub();
+    this->resetHalfCarry();
 }
 
 
@@ -1701,6 +776,30 @@ void CPU::RLCA() {
     if(carry) this->setCarry();
 
     this->a = (this->a << 1) + (carry >> 7);
+
+    this->resetZero();
+    this->resetSub();
+    this->resetHalfCarry();
+}
+
+/*
+
+    RRCA
+
+*/
+
+void CPU::RRCA() {
+    // Rotate a right circular
+    const uint8_t carry = this->a & 0x01;
+    this->resetCarry();
+
+    if(carry) this->setCarry();
+
+    this->a = (this->a >> 1) + (carry << 7);
+
+    this->resetZero();
+    this->resetSub();
+    this->resetHalfCarry();
 }
 
 /*
@@ -1735,6 +834,10 @@ void CPU::RRA() {
     if(this->a & 0x01) this->setCarry();
 
     this->a = (this->a >> 1) + (carry << 7);
+
+    this->resetZero();
+    this->resetSub();
+    this->resetHalfCarry();
 }
 
 /*
@@ -1758,6 +861,27 @@ void CPU::SRL(uint8_t &r) {
     else this->resetZero();
 }
 
+/*
+
+    SRA
+
+*/
+
+void CPU::SRA(uint8_t &r) {
+    // Shift r right, bit 7 is kept
+    this->resetCarry();
+
+    if(r & 0x01) this->setCarry();
+
+    r = (r >> 1) | (r & 0x80);
+
+    this->resetSub();
+    this->resetHalfCarry();
+
+    if(r == 0) this->setZero();
+    else this->resetZero();
+}
+
 /*
 
     RR
@@ -1765,13 +889,40 @@ void CPU::SRL(uint8_t &r) {
 */
 
 void CPU::RR(uint8_t &r) {
-    // Rotate r right
+    // Rotate r right through the carry
     const uint8_t carry = this->getCarry();
     this->resetCarry();
 
     if(r & 0x01) this->setCarry();
 
     r = (r >> 1) + (carry << 7);
+
+    this->resetSub();
+    this->resetHalfCarry();
+
+    if(r == 0) this->setZero();
+    else this->resetZero();
+}
+
+/*
+
+    RRC
+
+*/
+
+void CPU::RRC(uint8_t &r) {
+    // Rotate r right, bit 0 goes to the carry and bit 7
+    this->resetCarry();
+
+    if(r & 0x01) this->setCarry();
+
+    r = (r >> 1) | (r << 7);
+
+    this->resetSub();
+    this->resetHalfCarry();
+
+    if(r == 0) this->setZero();
+    else this->resetZero();
 }
 
 /*
@@ -1842,13 +993,13 @@ void CPU::SET(const uint8_t &bit, uint8_t &r) {
 void CPU::DUMPR() {
     // Dump registers
     logger->log("\033[34mDumping registers\033[0m");
-    logger->log("\033[34mA: " + intToHex(this->a) + " F: " + intToHex(this->f) + " B: " + intToHex(this->b) + " C: " + intToHex(this->c) + " D: " + intToHex(this->d) + " E: " + intToHex(this->e) + " H: " + intToHex(this->h) + " L: " + intToHex(this->l) + " SP: " + intToHex(this->sp) + " PC: " + intToHex(this->pc) + " IME: " + to_string(this->ime) + "\033[0m");
+    logger->log("\033[34mA: ", toHex(this->a), " F: ", toHex(this->f), " B: ", toHex(this->b), " C: ", toHex(this->c), " D: ", toHex(this->d), " E: ", toHex(this->e), " H: ", toHex(this->h), " L: ", toHex(this->l), " SP: ", toHex(this->sp), " PC: ", toHex(this->pc), " IME: ", (int) this->ime, "\033[0m");
 }
 
 void CPU::DUMPFlags() {
     // Dump flags
     logger->log("\033[34mDumping flags\033[0m");
-    logger->log("\033[34mZ: " + to_string(this->getZero()) + " N: " + to_string(this->getSub()) + " H: " + to_string(this->getHalfCarry()) + " C: " + to_string(this->getCarry()) + "\033[0m");
+    logger->log("\033[34mZ: ", (int) this->getZero(), " N: ", (int) this->getSub(), " H: ", (int) this->getHalfCarry(), " C: ", (int) this->getCarry(), "\033[0m");
 }
 
 void CPU::DUMPW() {
@@ -1856,9 +1007,9 @@ void CPU::DUMPW() {
     for (uint16_t addr = 0xC000; addr <= 0xDFFF; addr += 16) {
         std::string line = intToHex(addr) + ": ";
         for (uint8_t i = 0; i < 16; i++) {
-            line += intToHex(this->gameboy->memory->fetch8(addr + i)) + " ";
+            line += intToHex(this->read8(addr + i)) + " ";
         }
-        logger->log("\033[36" + line + "\033[0m");
+        logger->log("\033[36", line, "\033[0m");
     }
 }
 
@@ -1867,9 +1018,9 @@ void CPU::DUMPV() { // vram stored b/w 0x8000 and 0x9FFF
     for (uint16_t addr = 0x8000; addr <= 0x9FFF; addr += 16) {
         std::string line = intToHex(addr) + ": ";
         for (uint8_t i = 0; i < 16; i++) {
-            line += intToHex(this->gameboy->memory->fetch8(addr + i)) + " ";
+            line += intToHex(this->read8(addr + i)) + " ";
         }
-        logger->log("\033[96" + line + "\033[0m");
+        logger->log("\033[96", line, "\033[0m");
     }
 }
 
@@ -1880,11 +1031,11 @@ void CPU::DUMPV() { // vram stored b/w 0x8000 and 0x9FFF
 */
 
 void CPU::enableInterrupt(const Interrupt interrupt) {
-    this->gameboy->memory->fetch8(0xFFFF) |= (uint8_t) interrupt;
+    this->write8(INTERRUPT_ENABLE, this->read8(INTERRUPT_ENABLE) | (uint8_t) interrupt);
 }
 
 void CPU::disableInterrupt(const Interrupt interrupt) {
-    this->gameboy->memory->fetch8(0xFFFF) &= ~(uint8_t) interrupt;
+    this->write8(INTERRUPT_ENABLE, this->read8(INTERRUPT_ENABLE) & ~(uint8_t) interrupt);
 }
 
 void CPU::triggerInterrupt(const Interrupt interrupt) {
@@ -1893,9 +1044,190 @@ void CPU::triggerInterrupt(const Interrupt interrupt) {
         logger->warning("VBLANK interrupt triggered");
     }
 
-    this->gameboy->memory->fetch8(0xFF0F) |= (uint8_t) interrupt;
+    this->gameboy->memory->setIO(INTERRUPT_FLAG, this->gameboy->memory->getIO(INTERRUPT_FLAG) | (uint8_t) interrupt);
 }
 
 void CPU::clearInterrupt(const Interrupt interrupt) {
-    this->gameboy->memory->fetch8(0xFF0F) &= ~(uint8_t) interrupt;
-}
\ No newline at end of file
+    this->gameboy->memory->setIO(INTERRUPT_FLAG, this->gameboy->memory->getIO(INTERRUPT_FLAG) & ~(uint8_t) interrupt);
+}
+
+bool CPU::isInterruptPending() {
+    return (this->gameboy->memory->getIO(INTERRUPT_FLAG) & this->gameboy->memory->read8(INTERRUPT_ENABLE) & 0x1F) != 0;
+}
+
+/*
+
+    Idle loops
+
+*/
+
+uint64_t CPU::getIdleStep() {
+    // Halted, one M cycle per step until the next event raises an interrupt
+    if(this->halted) return this->isInterruptPending() ? 0 : 4;
+
+    return this->idleLoopStep;
+}
+
+void CPU::onBackwardJump(const uint16_t &branch) {
+    const uint64_t cycles = this->gameboy->scheduler->getCycles();
+    const uint64_t deadline = this->gameboy->scheduler->getNextTimestamp();
+    const uint64_t registers = this->packRegisters();
+
+    IdleLoop &loop = this->idleLoop;
+
+    if(loop.valid && loop.branch == branch && loop.target == this->pc) {
+        // Body with side effects, already checked
+        if(!loop.step) return;
+
+        // One straight iteration since the last jump, no event in between and nothing changed, the loop waits for the next event
+        if(cycles - loop.cycles == loop.step && deadline == loop.deadline && registers == loop.registers && this->sp == loop.sp) {
+            logger->log("Idle loop at ", toHex(loop.target), " - ", toHex(loop.branch));
+            this->idleLoopStep = loop.step;
+        }
+    } else {
+        loop.valid = true;
+        loop.branch = branch;
+        loop.target = this->pc;
+        loop.step = this->analyzeIdleLoop(this->pc, branch);
+    }
+
+    loop.cycles = cycles;
+    loop.deadline = deadline;
+    loop.registers = registers;
+    loop.sp = this->sp;
+}
+
+bool CPU::isIdleRead(const uint16_t &address) const {
+    // Timer registers count between the overflow events, RTC registers follow the host clock
+    if(address >= IO_OFFSET + DIVIDER_REGISTER && address <= IO_OFFSET + TIMER_CONTROL) return false;
+    if(address >= EXTRAM_OFFSET && address < EXTRAM_OFFSET + EXTRAM_SIZE) return false;
+
+    return true;
+}
+
+uint64_t CPU::analyzeIdleLoop(const uint16_t &target, const uint16_t &branch) {
+    // Registers written by the body, bit per register index (B, C, D, E, H, L), an indirect read through one of them is rejected
+    uint8_t written = 0;
+
+    // Register values are the ones at the start of each iteration
+    const uint16_t bc = ((uint16_t) this->b << 8) + this->c;
+    const uint16_t de = ((uint16_t) this->d << 8) + this->e;
+    const uint16_t hl = ((uint16_t) this->h << 8) + this->l;
+
+    // Code reads, not bus accesses of the running instruction
+    Memory* memory = this->gameboy->memory;
+
+    uint32_t address = target;
+    int length = 0;
+    uint64_t step = 0;
+
+    while(address <= branch && length < IDLE_LOOP_MAX_LENGTH) {
+        const uint8_t opcode = memory->read8(address);
+        const uint8_t high = opcode >> 4;
+        const uint8_t low = opcode & 0xF;
+        const uint8_t source = opcode & 0x7;
+        const uint8_t destination = (opcode >> 3) & 0x7;
+
+        length ++;
+        step += instructionCycles(opcode, opcode == 0xCB ? memory->read8(address + 1) : 0);
+
+        // The backward jump closes the body, it is taken
+        if(address == branch) return step + 4 * branchCycles[opcode];
+
+        if(opcode == 0x00 || opcode == 0x07 || opcode == 0x17 || opcode == 0x1F || opcode == 0x27 || opcode == 0x2F || opcode == 0x37) { // NOP, rotations, DAA, CPL, SCF
+            address ++;
+        } else if(high <= 0x3 && (low == 0x6 || low == 0xE) && destination != 6) { // LD r, n8
+            written |= 1 << destination;
+            address += 2;
+        } else if(high <= 0x3 && (low == 0x4 || low == 0x5 || low == 0xC || low == 0xD) && destination != 6) { // INC r, DEC r
+            written |= 1 << destination;
+            address ++;
+        } else if(high >= 0x4 && high <= 0x7 && destination != 6) { // LD r, r and LD r, [HL]
+            if(source == 6 && ((written & 0x30) || !this->isIdleRead(hl))) return 0;
+
+            written |= 1 << destination;
+            address ++;
+        } else if(high >= 0x8 && high <= 0xB) { // ALU A, r and ALU A, [HL]
+            if(source == 6 && ((written & 0x30) || !this->isIdleRead(hl))) return 0;
+
+            address ++;
+        } else if((opcode & 0xC7) == 0xC6) { // ALU A, n8
+            address += 2;
+        } else if(opcode == 0x0A || opcode == 0x1A) { // LD A, [BC], LD A, [DE]
+            const uint8_t pair = opcode == 0x0A ? 0x03 : 0x0C;
+            if((written & pair) || !this->isIdleRead(opcode == 0x0A ? bc : de)) return 0;
+
+            address ++;
+        } else if(opcode == 0xF0) { // LDH A, [FF00 + n8]
+            if(!this->isIdleRead(0xFF00 + memory->read8(address + 1))) return 0;
+
+            address += 2;
+        } else if(opcode == 0xF2) { // LD A, [FF00 + C]
+            if((written & 0x02) || !this->isIdleRead(0xFF00 + this->c)) return 0;
+
+            address ++;
+        } else if(opcode == 0xFA) { // LD A, [n16]
+            if(!this->isIdleRead(((uint16_t) memory->read8(address + 2) << 8) + memory->read8(address + 1))) return 0;
+
+            address += 3;
+        } else if(opcode == 0xCB) { // BIT on r or [HL], other prefixed instructions on r only
+            const uint8_t prefixed = memory->read8(address + 1);
+            const uint8_t prefixedHigh = prefixed >> 4;
+            const uint8_t prefixedSource = prefixed & 0x7;
+
+            if(prefixedHigh >= 0x4 && prefixedHigh <= 0x7) {
+                if(prefixedSource == 6 && ((written & 0x30) || !this->isIdleRead(hl))) return 0;
+            } else if(prefixedSource != 6 && (prefixedHigh >= 0x8 || (prefixed >= 0x10 && prefixed <= 0x27) || prefixedHigh == 0x3)) {
+                written |= 1 << prefixedSource;
+            } else return 0;
+
+            address += 2;
+        } else if((opcode & 0xE7) == 0x20) { // JR cc, e8, only as an exit of the loop
+            const uint32_t exit = (address + 2 + (int8_t) memory->read8(address + 1)) & 0xFFFF;
+            if(exit >= target && exit <= branch) return 0;
+
+            address += 2;
+        } else if((opcode & 0xE7) == 0xC2) { // JP cc, n16, only as an exit of the loop
+            const uint32_t exit = ((uint16_t) memory->read8(address + 2) << 8) + memory->read8(address + 1);
+            if(exit >= target && exit <= branch) return 0;
+
+            address += 3;
+        } else return 0; // Writes, stack, calls and anything else
+    }
+
+    return 0;
+}
+
+/*
+
+    Save states
+
+*/
+
+void CPU::saveState(CPUState &state) const {
+    state.a = this->a; state.f = this->f;
+    state.b = this->b; state.c = this->c;
+    state.d = this->d; state.e = this->e;
+    state.h = this->h; state.l = this->l;
+
+    state.sp = this->sp;
+    state.pc = this->pc;
+    state.ime = this->ime;
+    state.halted = this->halted;
+}
+
+void CPU::loadState(const CPUState &state) {
+    this->a = state.a; this->f = state.f;
+    this->b = state.b; this->c = state.c;
+    this->d = state.d; this->e = state.e;
+    this->h = state.h; this->l = state.l;
+
+    this->sp = state.sp;
+    this->pc = state.pc;
+    this->ime = state.ime;
+    this->halted = state.halted;
+
+    // The detector starts over, its timestamps belong to the previous run
+    this->idleLoop = {};
+    this->idleLoopStep = 0;
+}
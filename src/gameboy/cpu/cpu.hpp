@@ -2,6 +2,9 @@
 
 #include <stdint.h>
 #include <vector>
+#include <array>
+#include <utility>
+#include <unordered_map>
 
 #include "../logging/log/log.hpp"
 
@@ -9,6 +12,7 @@
 
 // Forward declaration
 class Gameboy;
+struct CPUState;
 
 // Interrupts
 enum class Interrupt : uint8_t {
@@ -19,12 +23,61 @@ enum class Interrupt : uint8_t {
     Joypad = 0x1 << 4,
 };
 
+// Longest loop body checked by the idle loop detector, in instructions
+#define IDLE_LOOP_MAX_LENGTH 16
+
+// Longest micro-op sequence of an instruction, CALL n16
+#define MICRO_OPS_MAX_LENGTH 6
+
+// One M cycle of an instruction, the bus accesses are the fetches, reads and writes
+enum class MicroOp : uint8_t {
+    Fetch, // Opcode or prefixed opcode fetch
+    Read,
+    Write,
+    Internal // No bus access
+};
+
+// Micro-ops of an instruction, on a conditional one the first ones up to untaken are run when the condition fails
+struct MicroOps {
+    MicroOp ops[MICRO_OPS_MAX_LENGTH];
+    uint8_t length; // M cycles when taken
+    uint8_t untaken; // M cycles when not taken, 0 if unconditional
+};
+
 class CPU {
+    // The JIT blocks address the registers and call the handlers
+    friend class Jit;
+
     public:
         CPU(Gameboy* gameboy);
         ~CPU();
 
-        void cycle(); // Will run a single cycle of the CPU, call in order the following functions: fetch, decode, fetchOperands, executes
+        // Run one instruction, returns the T-cycles left to add to the clock, a taken branch adds its extra cycles itself
+        uint8_t cycle(); // Will run a single cycle of the CPU, call in order the following functions: fetch, decode, fetchOperands, executes
+        uint8_t cycleTable(); // Same as cycle through the handler table, kept to measure the dispatch (see src/bench/dispatch.cpp)
+        uint8_t cycleDecoded(); // Same as cycle with the pre-decoded instruction cache
+        uint8_t cycleAccurate(); // Same as cycle with the bus accesses on their M cycle, the clock runs during the instruction
+
+        // Pre-decoded instruction cache, a written RAM page holding decoded instructions is dropped
+        void flushDecoded();
+        void invalidateDecoded(const char* page);
+        void unmapDecoded(const uint8_t &page, const int &count); // Pages mapped to other memory (bank switch), looked up again
+
+        static int instructionLength(const uint8_t &opcode); // Opcode and immediate operands, in bytes
+
+        // Instruction timings, generated from the micro-op description of each opcode (see timing.cpp)
+        static const array<MicroOps, 256> opcodeMicroOps;
+        static const array<MicroOps, 256> prefixedMicroOps;
+        static const MicroOps interruptMicroOps;
+
+        static const array<uint8_t, 256> opcodeCycles; // M cycles, not taken for the conditional instructions
+        static const array<uint8_t, 256> prefixedCycles;
+        static const array<uint8_t, 256> branchCycles; // Extra M cycles of a taken conditional instruction
+
+        // T-cycles of an instruction, not taken, the prefixed opcode is only read for 0xCB
+        static inline int instructionCycles(const uint8_t &opcode, const uint8_t &prefixed) {
+            return 4 * (opcode == 0xCB ? prefixedCycles[prefixed] : opcodeCycles[opcode]);
+        }
 
         void enableInterrupt(const Interrupt interrupt); 
         void disableInterrupt(const Interrupt interrupt);
@@ -45,6 +98,10 @@ class CPU {
         void DUMPW(); // WRAM, Banked WRAM, HRAM
         void DUMPV(); // VRAM, OAM
 
+        // Save states
+        void saveState(CPUState &state) const;
+        void loadState(const CPUState &state);
+
         /*
         
             Getters and Setters
@@ -52,6 +109,16 @@ class CPU {
         */
 
         inline const uint16_t& getPC() const { return this->pc; }
+        inline size_t getDecodedPageCount() const { return this->decodedPages.size(); }
+
+        // Idle CPU, halted or spinning in a side effect free loop, only an event can change what it does next
+        inline bool isHalted() const { return this->halted; }
+        inline bool isIdle() const { return this->halted || this->idleLoopStep; }
+
+        inline bool isInInstruction() const { return this->microOps != nullptr; } // Accurate timing, the clock runs inside the instruction
+
+        bool isInterruptPending(); // IF & IE, an interrupt that wakes the CPU from HALT
+        uint64_t getIdleStep(); // T-cycles of one idle iteration, 0 if the CPU is not idle
 
     private:
         // Gameboy ref
@@ -65,17 +132,153 @@ class CPU {
         uint16_t sp, pc; // 16-bit registers
         uint8_t ime; // 8-bit interrupt master enable flag
 
+        // HALT, no instruction runs until an interrupt is pending
+        bool halted;
+
+        uint8_t prefixed; // Prefixed opcode of the last 0xCB instruction, for its cycles
+
+        /*
+
+            Accurate timing, the instruction runs at once but each bus access first runs the other components
+            up to the M cycle of the access in the micro-op sequence of the instruction
+
+        */
+
+        const MicroOps* microOps; // Sequence of the instruction being run, nullptr in fast timing
+        uint8_t microOp; // Next micro-op of the sequence
+        uint8_t microCycles; // M cycles of the instruction already run
+        bool branchTaken;
+
+        void busAccess(); // Called before each access, runs the M cycles up to it
+        void tick(); // One M cycle of the other components
+        uint8_t finishMicroOps(); // Returns the T-cycles left, the sequence is over
+
+        // Taken conditional instruction, extra cycles of the opcode
+        void takeBranch(const uint8_t &opcode);
+
+        /*
+
+            Idle loop detector, checked on taken backward jumps
+            A loop whose body only reads memory and registers is idle when an iteration ends with the same registers
+            and no event ran during it, the next iterations read the same values until the next event
+
+        */
+
+        struct IdleLoop {
+            bool valid;
+            uint16_t branch, target; // Address of the backward jump and of its destination
+            uint64_t step; // T-cycles of one iteration, 0 if the body has side effects
+            uint64_t cycles; // Master clock when the jump was last taken
+            uint64_t deadline; // Next event deadline at that time
+            uint64_t registers; // A, F, B, C, D, E, H, L packed when the jump was last taken
+            uint16_t sp;
+        };
+
+        IdleLoop idleLoop;
+        uint64_t idleLoopStep; // T-cycles of one iteration of the loop detected by the last instruction, 0 if none
+
+        void onBackwardJump(const uint16_t &branch); // Called after a taken backward jump, PC is the loop start
+        uint64_t analyzeIdleLoop(const uint16_t &target, const uint16_t &branch); // T-cycles of one iteration, 0 if the body has side effects
+        bool isIdleRead(const uint16_t &address) const; // Memory read allowed in an idle loop body
+
+        inline uint64_t packRegisters() const {
+            return ((uint64_t) this->a << 56) | ((uint64_t) this->f << 48) | ((uint64_t) this->b << 40) | ((uint64_t) this->c << 32) |
+                   ((uint64_t) this->d << 24) | ((uint64_t) this->e << 16) | ((uint64_t) this->h << 8) | this->l;
+        }
+
         // Interrupts
-        void checkInterrupts(); // Check if an interrupt is pending and execute it
+        bool checkInterrupts(); // Check if an interrupt is pending and execute it, true if one was dispatched
+
+        // Memory access, the bus accesses of the instructions
+        uint8_t read8(const uint16_t &address);
+        void write8(const uint16_t &address, const uint8_t &value);
 
         // Execution steps
-        const uint8_t& fetch() const; // Fetch the next instruction
-        void decodeAndExecute(const uint8_t& opcode);
-        void decodeAndExecutePrefixed(const uint8_t& opcode);
+        uint8_t fetch(); // Fetch the next instruction
+
+        /*
+
+            Table dispatch, one handler per opcode generated at compile time (see dispatch.cpp)
+
+        */
+
+        typedef void (CPU::*OpcodeHandler)();
+
+        static const array<OpcodeHandler, 256> opcodeTable;
+        static const array<OpcodeHandler, 256> prefixedTable;
+
+        template<size_t... opcodes> static constexpr array<OpcodeHandler, 256> buildOpcodeTable(index_sequence<opcodes...>);
+        template<size_t... opcodes> static constexpr array<OpcodeHandler, 256> buildPrefixedTable(index_sequence<opcodes...>);
 
-        // Operand fetchers
-        uint8_t& getArith8Operand(const uint8_t& opcode);
-        uint8_t& getIncDec8Operand(const uint8_t& opcode);
+        void dispatch(const uint8_t &opcode); // Switch over the handlers, used by the interpreter
+
+        template<uint8_t opcode, bool decoded = false> void execute();
+        template<uint8_t opcode> void executePrefixed();
+
+        // Same handlers as plain functions, for the JIT
+        typedef void (*OpcodeThunk)(CPU* cpu);
+
+        static const array<OpcodeThunk, 256> thunkTable;
+
+        template<size_t... opcodes> static constexpr array<OpcodeThunk, 256> buildThunkTable(index_sequence<opcodes...>);
+        template<uint8_t opcode> static void executeThunk(CPU* cpu);
+
+        /*
+
+            Pre-decoded instruction cache (see decoded.cpp)
+            Each instruction of ROM, WRAM and HRAM is decoded once into a record, pages are keyed by their host memory so the banks have their own records
+            The handlers of the records take their immediate operands from the record, a RAM page holding records loses its direct store
+
+        */
+
+        struct DecodedInstruction {
+            OpcodeThunk handler; // nullptr until decoded
+            uint16_t immediate; // Immediate operands, little endian
+            uint8_t length; // Bytes
+            uint8_t cycles; // T-cycles, not taken, 0 for a prefixed opcode read from memory
+        };
+
+        struct DecodedPage {
+            DecodedInstruction instructions[256];
+        };
+
+        // Page last seen at each page of the address space, checked against the current mapping
+        struct DecodedLookup {
+            const char* host;
+            DecodedPage* page;
+        };
+
+        static const array<OpcodeThunk, 256> decodedTable;
+        template<size_t... opcodes> static constexpr array<OpcodeThunk, 256> buildDecodedTable(index_sequence<opcodes...>);
+        template<uint8_t opcode> static void executeDecoded(CPU* cpu);
+
+        unordered_map<const char*, DecodedPage*> decodedPages;
+        DecodedLookup decodedLookup[256];
+
+        uint16_t immediate; // Immediate operands of the instruction run from the cache
+
+        const DecodedInstruction* decode(const uint16_t &address); // nullptr if the address can not be cached (VRAM, external RAM, OAM, IOs)
+        void decodeInstruction(DecodedInstruction &instruction, const uint16_t &address);
+
+        // Immediate operands, from the record or from memory
+        template<bool decoded> inline uint8_t immediateLow() {
+            if constexpr(decoded) return this->immediate & 0xFF;
+            else return this->read8(this->pc + 1);
+        }
+
+        template<bool decoded> inline uint8_t immediateHigh() {
+            if constexpr(decoded) return this->immediate >> 8;
+            else return this->read8(this->pc + 2);
+        }
+
+        void unknownOpcode(const uint8_t &opcode);
+
+        // Operands baked in the handlers, register index from the opcode bits: B, C, D, E, H, L, [HL], A
+        template<uint8_t index> uint8_t& register8();
+        template<uint8_t index> uint8_t readRegister8();
+        template<uint8_t index> void writeRegister8(const uint8_t &value);
+
+        template<uint8_t pair> uint16_t indirectAddress(); // [BC], [DE], [HL+], [HL-]
 
         /*
         
@@ -83,6 +286,9 @@ class CPU {
 
         */
 
+        // HALT
+        void HALT(); // 0x76
+
         // JUMP
         void JRN(const int8_t& e8, const uint8_t& flag); // 0x20, 0x30
         void JRS(const int8_t& e8, const uint8_t& flag); // 0x18, 0x28
@@ -151,6 +357,9 @@ class CPU {
         // RL
         void RL(uint8_t &r);
 
+        // RLC
+        void RLC(uint8_t &r);
+
         // POP
         void POP(uint8_t &r1, uint8_t &r2);
 
@@ -160,6 +369,9 @@ class CPU {
         //RLCA
         void RLCA();
 
+        // RRCA
+        void RRCA();
+
         // SWAP
         void SWAP(uint8_t &r);
 
@@ -169,9 +381,15 @@ class CPU {
         // SRL
         void SRL(uint8_t &r);
 
+        // SRA
+        void SRA(uint8_t &r);
+
         // RR
         void RR(uint8_t &r);
 
+        // RRC
+        void RRC(uint8_t &r);
+
         // RES
         void RES(const uint8_t &bit, uint8_t &r);
 
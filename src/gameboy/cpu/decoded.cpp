@@ -0,0 +1,106 @@
+#include <iostream>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+
+using namespace std;
+
+#include "../utils/utils.hpp"
+#include "../logging/logger/logger.hpp"
+
+#include "cpu.hpp"
+
+/*
+
+    Pre-decoded instruction cache
+
+*/
+
+int CPU::instructionLength(const uint8_t &opcode) {
+    const uint8_t high = opcode >> 4;
+    const uint8_t low = opcode & 0xF;
+
+    if(opcode == 0x08 || opcode == 0xC3 || opcode == 0xCD || opcode == 0xEA || opcode == 0xFA || opcode == 0xEC) return 3;
+    if(high <= 0x3 && low == 0x1) return 3; // LD rr, n16
+    if((opcode & 0xE7) == 0xC2 || (opcode & 0xE7) == 0xC4) return 3; // JP cc, CALL cc
+
+    if(high <= 0x3 && (low == 0x6 || low == 0xE)) return 2; // LD r, n8
+    if(opcode == 0x18 || (opcode & 0xE7) == 0x20 || opcode == 0x10) return 2; // JR, STOP
+    if((opcode & 0xC7) == 0xC6) return 2; // ALU A, n8
+    if(opcode == 0xE0 || opcode == 0xF0 || opcode == 0xE8 || opcode == 0xF8 || opcode == 0xCB) return 2;
+
+    return 1;
+}
+
+const CPU::DecodedInstruction* CPU::decode(const uint16_t &address) {
+    const char* host = this->gameboy->memory->getCodePage(address);
+    DecodedLookup &entry = this->decodedLookup[address >> 8];
+
+    if(entry.host != host || !entry.page) {
+        if(!host) return nullptr;
+
+        DecodedPage* &page = this->decodedPages[host];
+        if(!page) {
+            page = new DecodedPage();
+
+            // Writes to the RAM page go through the memory handler, which drops the page
+            if(address >= WRAM_FIXED_OFFSET) this->gameboy->memory->protectCode(host);
+        }
+
+        entry = { host, page };
+    }
+
+    DecodedInstruction &instruction = entry.page->instructions[address & 0xFF];
+    if(!instruction.handler) this->decodeInstruction(instruction, address);
+
+    return &instruction;
+}
+
+void CPU::decodeInstruction(DecodedInstruction &instruction, const uint16_t &address) {
+    const uint8_t opcode = this->read8(address);
+    const uint8_t length = instructionLength(opcode);
+
+    instruction.length = length;
+
+    // The immediates of an instruction across the end of the page are not covered by its invalidation, they are read from memory
+    // A prefixed opcode there is only known once run, its cycles are 0
+    const int end = address >= HRAM_OFFSET ? (INTERRUPT_ENABLE & 0xFF) : 0x100;
+    if((address & 0xFF) + length > end) {
+        instruction.handler = thunkTable[opcode];
+        instruction.immediate = 0;
+        instruction.cycles = opcode == 0xCB ? 0 : instructionCycles(opcode, 0);
+
+        return;
+    }
+
+    instruction.handler = decodedTable[opcode];
+    instruction.immediate = length > 1 ? this->read8(address + 1) : 0;
+    if(length > 2) instruction.immediate |= this->read8(address + 2) << 8;
+
+    instruction.cycles = instructionCycles(opcode, instruction.immediate & 0xFF);
+}
+
+void CPU::flushDecoded() {
+    for(auto &page : this->decodedPages) delete page.second;
+
+    this->decodedPages.clear();
+    for(DecodedLookup &entry : this->decodedLookup) entry = {};
+
+    this->gameboy->memory->unprotectCode();
+}
+
+void CPU::invalidateDecoded(const char* page) {
+    auto found = this->decodedPages.find(page);
+    if(found == this->decodedPages.end()) return;
+
+    logger->log("Decoded page written, dropping its instructions");
+
+    delete found->second;
+    this->decodedPages.erase(found);
+
+    for(DecodedLookup &entry : this->decodedLookup) if(entry.host == page) entry = {};
+}
+
+void CPU::unmapDecoded(const uint8_t &page, const int &count) {
+    for(int i = page; i < page + count && i < 256; i++) this->decodedLookup[i] = {};
+}
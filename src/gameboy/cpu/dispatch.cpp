@@ -0,0 +1,551 @@
+#include <iostream>
+#include <stdint.h>
+#include <string>
+#include <array>
+#include <utility>
+
+using namespace std;
+
+#include "../utils/utils.hpp"
+#include "../logging/logger/logger.hpp"
+
+#include "cpu.hpp"
+
+/*
+
+    Opcode tables, one handler instantiated per opcode
+
+*/
+
+template<size_t... opcodes>
+constexpr array<CPU::OpcodeHandler, 256> CPU::buildOpcodeTable(index_sequence<opcodes...>) {
+    return {{ &CPU::execute<opcodes>... }};
+}
+
+template<size_t... opcodes>
+constexpr array<CPU::OpcodeHandler, 256> CPU::buildPrefixedTable(index_sequence<opcodes...>) {
+    return {{ &CPU::executePrefixed<opcodes>... }};
+}
+
+template<size_t... opcodes>
+constexpr array<CPU::OpcodeThunk, 256> CPU::buildDecodedTable(index_sequence<opcodes...>) {
+    return {{ &CPU::executeDecoded<opcodes>... }};
+}
+
+template<size_t... opcodes>
+constexpr array<CPU::OpcodeThunk, 256> CPU::buildThunkTable(index_sequence<opcodes...>) {
+    return {{ &CPU::executeThunk<opcodes>... }};
+}
+
+const array<CPU::OpcodeHandler, 256> CPU::opcodeTable = CPU::buildOpcodeTable(make_index_sequence<256>());
+const array<CPU::OpcodeHandler, 256> CPU::prefixedTable = CPU::buildPrefixedTable(make_index_sequence<256>());
+const array<CPU::OpcodeThunk, 256> CPU::thunkTable = CPU::buildThunkTable(make_index_sequence<256>());
+const array<CPU::OpcodeThunk, 256> CPU::decodedTable = CPU::buildDecodedTable(make_index_sequence<256>());
+
+// Same handlers behind one switch, the compiler inlines them behind a jump table
+#define DISPATCH_CASE(opcode) case opcode: return this->execute<opcode>();
+#define DISPATCH_ROW(high) \
+    DISPATCH_CASE(high + 0x0) DISPATCH_CASE(high + 0x1) DISPATCH_CASE(high + 0x2) DISPATCH_CASE(high + 0x3) \
+    DISPATCH_CASE(high + 0x4) DISPATCH_CASE(high + 0x5) DISPATCH_CASE(high + 0x6) DISPATCH_CASE(high + 0x7) \
+    DISPATCH_CASE(high + 0x8) DISPATCH_CASE(high + 0x9) DISPATCH_CASE(high + 0xA) DISPATCH_CASE(high + 0xB) \
+    DISPATCH_CASE(high + 0xC) DISPATCH_CASE(high + 0xD) DISPATCH_CASE(high + 0xE) DISPATCH_CASE(high + 0xF)
+
+void CPU::dispatch(const uint8_t &opcode) {
+    switch(opcode) {
+        DISPATCH_ROW(0x00) DISPATCH_ROW(0x10) DISPATCH_ROW(0x20) DISPATCH_ROW(0x30)
+        DISPATCH_ROW(0x40) DISPATCH_ROW(0x50) DISPATCH_ROW(0x60) DISPATCH_ROW(0x70)
+        DISPATCH_ROW(0x80) DISPATCH_ROW(0x90) DISPATCH_ROW(0xA0) DISPATCH_ROW(0xB0)
+        DISPATCH_ROW(0xC0) DISPATCH_ROW(0xD0) DISPATCH_ROW(0xE0) DISPATCH_ROW(0xF0)
+    }
+}
+
+// Plain function entry of a handler, called from the JIT blocks
+template<uint8_t opcode>
+void CPU::executeThunk(CPU* cpu) {
+    cpu->execute<opcode>();
+}
+
+// Same with the immediate operands from the pre-decoded record
+template<uint8_t opcode>
+void CPU::executeDecoded(CPU* cpu) {
+    cpu->execute<opcode, true>();
+}
+
+/*
+
+    Operands
+
+*/
+
+template<uint8_t index>
+inline uint8_t& CPU::register8() {
+    static_assert(index != 6, "[HL] is not a register");
+
+    if constexpr(index == 0) return this->b;
+    else if constexpr(index == 1) return this->c;
+    else if constexpr(index == 2) return this->d;
+    else if constexpr(index == 3) return this->e;
+    else if constexpr(index == 4) return this->h;
+    else if constexpr(index == 5) return this->l;
+    else return this->a;
+}
+
+template<uint8_t index>
+inline uint8_t CPU::readRegister8() {
+    if constexpr(index == 6) return this->read8(((uint16_t) this->h << 8) + this->l);
+    else return this->register8<index>();
+}
+
+template<uint8_t index>
+inline void CPU::writeRegister8(const uint8_t &value) {
+    if constexpr(index == 6) this->write8(((uint16_t) this->h << 8) + this->l, value);
+    else this->register8<index>() = value;
+}
+
+template<uint8_t pair>
+inline uint16_t CPU::indirectAddress() {
+    if constexpr(pair == 0x0) return ((uint16_t) this->b << 8) + this->c; // BC
+    else if constexpr(pair == 0x1) return ((uint16_t) this->d << 8) + this->e; // DE
+    else {
+        const uint16_t address = ((uint16_t) this->h << 8) + this->l;
+        const uint16_t next = pair == 0x2 ? address + 1 : address - 1; // HL+, HL-
+
+        this->h = next >> 8;
+        this->l = next & 0xFF;
+
+        return address;
+    }
+}
+
+/*
+
+    Unknown opcodes
+
+*/
+
+void CPU::unknownOpcode(const uint8_t &opcode) {
+    logger->error("Unknown opcode: ", toHex(opcode));
+    this->gameboy->stop();
+}
+
+/*
+
+    Instructions, decoded at compile time from the opcode bits
+    The pre-decoded instances take the immediate operands from the cache record instead of memory
+
+*/
+
+template<uint8_t opcode, bool decoded>
+void CPU::execute() {
+    constexpr uint8_t high = opcode >> 4;
+    constexpr uint8_t low = opcode & 0xF;
+
+    // Register index in the opcode bits
+    constexpr uint8_t source = opcode & 0x7;
+    constexpr uint8_t destination = (opcode >> 3) & 0x7;
+
+    // Condition in the opcode bits, 0: NZ, 1: Z, 2: NC, 3: C
+    constexpr uint8_t condition = (opcode >> 3) & 0x3;
+
+    /*
+
+        LD r r, r [HL], [HL] r (lines 0x40 to 0x7F), 0x76 is HALT
+
+    */
+
+    if constexpr(opcode == 0x76) {
+        logger->log("HALT");
+        this->pc ++;
+
+        return this->HALT();
+    } else if constexpr(high >= 0x4 && high <= 0x7) {
+        this->pc ++;
+
+        const uint8_t r2 = this->readRegister8<source>();
+        logger->log("LD r, r with r: ", toHex(r2));
+
+        return this->writeRegister8<destination>(r2);
+    }
+
+    /*
+
+        ADD, ADC, SUB, SBC, AND, XOR, OR, CP on r or [HL] (lines 0x80 to 0xBF), and on n8 (0xC6 to 0xFE)
+
+    */
+
+    else if constexpr((high >= 0x8 && high <= 0xB) || (opcode & 0xC7) == 0xC6) {
+        uint8_t r2;
+        if constexpr(high <= 0xB) {
+            this->pc ++;
+            r2 = this->readRegister8<source>();
+        } else {
+            r2 = this->immediateLow<decoded>();
+            this->pc += 2;
+        }
+
+        logger->log("ALU A, r with r: ", toHex(r2));
+
+        if constexpr(destination == 0) return this->ADD(this->a, r2);
+        else if constexpr(destination == 1) return this->ADDC(this->a, r2);
+        else if constexpr(destination == 2) return this->SUB(this->a, r2);
+        else if constexpr(destination == 3) return this->SUBC(this->a, r2);
+        else if constexpr(destination == 4) return this->AND(this->a, r2);
+        else if constexpr(destination == 5) return this->XOR(this->a, r2);
+        else if constexpr(destination == 6) return this->OR(this->a, r2);
+        else return this->CP(this->a, r2);
+    }
+
+    /*
+
+        Lines 0x00 to 0x3F, columns 0x1 to 0x6 and 0x9 to 0xE
+
+    */
+
+    else if constexpr(high <= 0x3 && low == 0x1) { // LD rr, n16
+        const uint8_t r4 = this->immediateLow<decoded>();
+        const uint8_t r3 = this->immediateHigh<decoded>();
+        this->pc += 3;
+
+        logger->log("LD rr, n16 with n16: ", toHex((uint16_t) (r3 << 8) + r4));
+
+        if constexpr(high == 0x3) return this->LD(this->sp, r3, r4);
+        else return this->LD(this->register8<high * 2>(), this->register8<high * 2 + 1>(), r3, r4);
+    } else if constexpr(high <= 0x3 && low == 0x2) { // LD [rr], A
+        logger->log("LD [rr], A");
+        this->pc ++;
+
+        return this->write8(this->indirectAddress<high>(), this->a);
+    } else if constexpr(high <= 0x3 && low == 0xA) { // LD A, [rr]
+        this->pc ++;
+
+        const uint16_t address = this->indirectAddress<high>();
+
+        logger->log("LD A, [adr] at adress: ", toHex(address));
+        return this->LD(this->a, this->read8(address));
+    } else if constexpr(high <= 0x3 && (low == 0x3 || low == 0xB)) { // INC rr, DEC rr
+        logger->log(low == 0x3 ? "INC rr" : "DEC rr");
+
+        if constexpr(high == 0x3) {
+            if constexpr(low == 0x3) this->sp ++;
+            else this->sp --;
+
+            this->pc ++;
+            return;
+        } else {
+            if constexpr(low == 0x3) return this->INC(this->register8<high * 2>(), this->register8<high * 2 + 1>());
+            else return this->DEC(this->register8<high * 2>(), this->register8<high * 2 + 1>());
+        }
+    } else if constexpr(high <= 0x3 && (low == 0x4 || low == 0xC)) { // INC r
+        logger->log("INC r");
+
+        uint8_t r = this->readRegister8<destination>();
+        this->INC(r);
+
+        return this->writeRegister8<destination>(r);
+    } else if constexpr(high <= 0x3 && (low == 0x5 || low == 0xD)) { // DEC r
+        logger->log("DEC r");
+
+        uint8_t r = this->readRegister8<destination>();
+        this->DEC(r);
+
+        return this->writeRegister8<destination>(r);
+    } else if constexpr(high <= 0x3 && (low == 0x6 || low == 0xE)) { // LD r, n8
+        const uint8_t value = this->immediateLow<decoded>();
+        this->pc += 2;
+
+        logger->log("LD r, n8 with n8: ", toHex(value));
+
+        return this->writeRegister8<destination>(value);
+    } else if constexpr(high <= 0x3 && low == 0x9) { // ADD HL, rr
+        logger->log("ADD HL, rr");
+        this->pc ++;
+
+        if constexpr(high == 0x3) return this->ADD(this->h, this->l, this->sp >> 8, this->sp & 0xFF);
+        else return this->ADD(this->h, this->l, this->register8<high * 2>(), this->register8<high * 2 + 1>());
+    }
+
+    /*
+
+        Jumps, calls and returns
+
+    */
+
+    else if constexpr(opcode == 0x18) { // JR e8
+        const int8_t e8 = (int8_t) this->immediateLow<decoded>();
+        logger->log("JR e8 with value ", toHex(e8));
+
+        const uint16_t branch = this->pc;
+        this->pc += 2 + e8;
+
+        // Backward jump, maybe an idle loop
+        if(e8 <= -2) this->onBackwardJump(branch);
+        return;
+    } else if constexpr((opcode & 0xE7) == 0x20) { // JR cc, e8
+        const int8_t e8 = (int8_t) this->immediateLow<decoded>();
+        logger->log("JR cc, e8 with value ", toHex(e8));
+
+        const uint16_t branch = this->pc;
+        this->pc += 2;
+
+        const uint8_t flag = condition <= 0x1 ? this->getZero() : this->getCarry();
+        if constexpr(condition % 2 == 0) this->JRN(e8, flag);
+        else this->JRS(e8, flag);
+
+        if(e8 <= -2 && this->pc != (uint16_t) (branch + 2)) this->onBackwardJump(branch);
+        return;
+    } else if constexpr((opcode & 0xE7) == 0xC0) { // RET cc
+        logger->log("RET cc");
+        this->pc ++;
+
+        const uint8_t flag = condition <= 0x1 ? this->getZero() : this->getCarry();
+        if(flag == (condition % 2)) {
+            this->takeBranch(opcode);
+            return this->RET();
+        }
+
+        logger->log("Condition not met, skipping RET cc");
+        return;
+    } else if constexpr((opcode & 0xE7) == 0xC2 || (opcode & 0xE7) == 0xC4 || opcode == 0xC3 || opcode == 0xCD) { // JP cc, n16, CALL cc, n16, JP n16, CALL n16
+        const uint8_t adr_lsb = this->immediateLow<decoded>();
+        const uint8_t adr_msb = this->immediateHigh<decoded>();
+        const uint16_t address = ((uint16_t) adr_msb << 8) + adr_lsb;
+
+        logger->log("JP / CALL n16 with address ", toHex(address));
+
+        if constexpr(opcode == 0xC3) {
+            const uint16_t branch = this->pc;
+            this->pc = address;
+
+            if(address <= branch) this->onBackwardJump(branch);
+            return;
+        }
+
+        this->pc += 3;
+        if constexpr(opcode == 0xCD) return this->CALL(address);
+        else {
+            const uint8_t flag = condition <= 0x1 ? this->getZero() : this->getCarry();
+
+            if constexpr((opcode & 0x7) == 0x2) {
+                const uint16_t branch = this->pc - 3;
+
+                if constexpr(condition % 2 == 0) this->JPN(address, flag);
+                else this->JPS(address, flag);
+
+                if(address <= branch && this->pc == address) this->onBackwardJump(branch);
+                return;
+            } else {
+                if constexpr(condition % 2 == 0) return this->CALLN(address, flag);
+                else return this->CALLS(address, flag);
+            }
+        }
+    } else if constexpr(opcode == 0xC9 || opcode == 0xD9) { // RET, RETI
+        logger->log("RET");
+
+        // Set the interrupt master enable flag to 1
+        if constexpr(opcode == 0xD9) this->ime = 1;
+
+        this->pc ++;
+        return this->RET();
+    } else if constexpr((opcode & 0xC7) == 0xC7) { // RST
+        logger->log("RST ", toHex((uint8_t) (opcode & 0x38)));
+
+        return this->RST(opcode & 0x38);
+    } else if constexpr(opcode == 0xE9) { // JP HL
+        logger->log("JP HL");
+
+        this->pc = (this->h << 8) + this->l;
+        return;
+    }
+
+    /*
+
+        Stack
+
+    */
+
+    else if constexpr((opcode & 0xCF) == 0xC1 || (opcode & 0xCF) == 0xC5) { // POP rr, PUSH rr
+        logger->log((opcode & 0xF) == 0x1 ? "POP rr" : "PUSH rr");
+        this->pc ++;
+
+        constexpr uint8_t pair = (opcode >> 4) & 0x3;
+
+        if constexpr((opcode & 0xF) == 0x1) {
+            if constexpr(pair == 0x3) {
+                this->POP(this->a, this->f);
+
+                // The low nibble of F does not exist and always reads 0
+                this->f &= 0xF0;
+                return;
+            }
+            else return this->POP(this->register8<pair * 2>(), this->register8<pair * 2 + 1>());
+        } else {
+            if constexpr(pair == 0x3) return this->PUSH(this->a, this->f);
+            else return this->PUSH(this->register8<pair * 2>(), this->register8<pair * 2 + 1>());
+        }
+    }
+
+    /*
+
+        Other LD instructions
+
+    */
+
+    else if constexpr(opcode == 0x08) { // LD [n16], SP
+        const uint8_t adr_lsb = this->immediateLow<decoded>();
+        const uint8_t adr_msb = this->immediateHigh<decoded>();
+        const uint16_t address = ((uint16_t) adr_msb << 8) + adr_lsb;
+
+        logger->log("LD [n16], SP with address ", toHex(address));
+
+        this->pc += 3;
+        this->write8(address, this->sp & 0xFF);
+        return this->write8(address + 1, this->sp >> 8);
+    } else if constexpr(opcode == 0xE0 || opcode == 0xF0) { // LD [FF00 + n8], A, LD A, [FF00 + n8]
+        const uint8_t value = this->immediateLow<decoded>();
+        logger->log("LDH with n8 value ", toHex(value));
+
+        this->pc += 2;
+        if constexpr(opcode == 0xE0) return this->write8(0xFF00 + value, this->a);
+        else return this->LD(this->a, this->read8(0xFF00 + value));
+    } else if constexpr(opcode == 0xE2 || opcode == 0xF2) { // LD [FF00 + C], A, LD A, [FF00 + C]
+        logger->log("LDH with C value ", toHex(this->c), ", A: ", toHex(this->a));
+
+        this->pc ++;
+        if constexpr(opcode == 0xE2) return this->write8(0xFF00 + this->c, this->a);
+        else return this->LD(this->a, this->read8(0xFF00 + this->c));
+    } else if constexpr(opcode == 0xEA || opcode == 0xFA) { // LD [adr], A, LD A, [adr]
+        const uint8_t adr_lsb = this->immediateLow<decoded>();
+        const uint8_t adr_msb = this->immediateHigh<decoded>();
+        const uint16_t address = ((uint16_t) adr_msb << 8) + adr_lsb;
+
+        logger->log("LD with address ", toHex(address));
+
+        this->pc += 3;
+        if constexpr(opcode == 0xEA) return this->write8(address, this->a);
+        else return this->LD(this->a, this->read8(address));
+    } else if constexpr(opcode == 0xF8) { // LD HL, SP + e8
+        const int8_t e8 = (int8_t) this->immediateLow<decoded>();
+        logger->log("LD HL, SP + e8 with value ", toHex(e8));
+
+        // Same flags as ADD SP, e8
+        uint16_t address = this->sp;
+        this->ADD(address, e8);
+
+        this->pc += 2;
+        return this->LD(this->h, this->l, address);
+    } else if constexpr(opcode == 0xF9) { // LD SP, HL
+        logger->log("LD SP, HL");
+
+        this->pc ++;
+        return this->LD(this->sp, this->h, this->l);
+    } else if constexpr(opcode == 0xE8) { // ADD SP, e8
+        const int8_t e8 = (int8_t) this->immediateLow<decoded>();
+        logger->log("ADD SP, e8 with value ", toHex(e8));
+
+        this->pc += 2;
+        return this->ADD(this->sp, e8);
+    }
+
+    /*
+
+        Accumulator and flags, misc
+
+    */
+
+    else if constexpr(opcode == 0x00 || opcode == 0x07 || opcode == 0x0F || opcode == 0x17 || opcode == 0x1F || opcode == 0x27 || opcode == 0x2F || opcode == 0x37 || opcode == 0x3F || opcode == 0xF3 || opcode == 0xFB) {
+        this->pc ++;
+
+        if constexpr(opcode == 0x00) logger->log("NOP");
+        else if constexpr(opcode == 0x07) this->RLCA();
+        else if constexpr(opcode == 0x0F) this->RRCA();
+        else if constexpr(opcode == 0x17) this->RLA();
+        else if constexpr(opcode == 0x1F) this->RRA();
+        else if constexpr(opcode == 0x27) this->DAA();
+        else if constexpr(opcode == 0x2F) this->CPL();
+        else if constexpr(opcode == 0x37) this->SCF();
+        else if constexpr(opcode == 0x3F) this->CCF();
+        else if constexpr(opcode == 0xF3) this->ime = 0; // DI
+        else this->ime = 1; // EI
+    } else if constexpr(opcode == 0x10) { // STOP n8
+        logger->log("STOP");
+        this->pc += 2;
+
+        // The DMG has no speed switch, STOP resets DIV and the low power mode is not emulated
+        return this->gameboy->timer->setDividerRegister(0);
+    } else if constexpr(opcode == 0xCB) { // Prefix
+        *logger << "Prefixed instruction";
+
+        const uint8_t prefixed = this->immediateLow<decoded>();
+        this->pc ++;
+
+        // The rest of the instruction follows the prefixed opcode timing
+        this->prefixed = prefixed;
+        if(this->microOps) this->microOps = &prefixedMicroOps[prefixed];
+
+        return (this->*prefixedTable[prefixed])();
+    }
+
+    /*
+
+        Custom instructions, DUMPR (0xEB), read address (0xEC)
+
+    */
+
+    else if constexpr(opcode == 0xEB) {
+        this->pc ++;
+        return this->DUMPR();
+    } else if constexpr(opcode == 0xEC) {
+        // Read PC + 1 and PC + 2 to get the adress
+        const uint8_t r2 = this->immediateLow<decoded>();
+        const uint8_t r3 = this->immediateHigh<decoded>();
+
+        const uint16_t address = ((uint16_t) r2 << 8) + r3;
+
+        this->pc += 3;
+        return logger->log("\033[34mAddress: ", toHex(address), " Value: ", toHex(this->read8(address)), "\033[0m");
+    }
+
+    else return this->unknownOpcode(opcode);
+}
+
+/*
+
+    Prefixed instructions
+
+*/
+
+template<uint8_t opcode>
+void CPU::executePrefixed() {
+    constexpr uint8_t high = opcode >> 4;
+
+    // Register index and bit number in the opcode bits
+    constexpr uint8_t source = opcode & 0x7;
+    constexpr uint8_t bit = (opcode >> 3) & 0x7;
+
+    if constexpr(high >= 0x4 && high <= 0x7) { // BIT
+        this->pc ++;
+
+        const uint8_t r = this->readRegister8<source>();
+        logger->log("BIT ", (int) bit, ", r with r: ", toHex(r));
+
+        return this->BIT(bit, r);
+    } else { // RES, SET, rotates and shifts
+        this->pc ++;
+
+        uint8_t r = this->readRegister8<source>();
+        logger->log("CB r with r: ", toHex(r));
+
+        if constexpr(high >= 0xC) this->SET(bit, r);
+        else if constexpr(high >= 0x8) this->RES(bit, r);
+        else if constexpr(bit == 0) this->RLC(r);
+        else if constexpr(bit == 1) this->RRC(r);
+        else if constexpr(bit == 2) this->RL(r);
+        else if constexpr(bit == 3) this->RR(r);
+        else if constexpr(bit == 4) this->SLA(r);
+        else if constexpr(bit == 5) this->SRA(r);
+        else if constexpr(bit == 6) this->SWAP(r);
+        else this->SRL(r);
+
+        return this->writeRegister8<source>(r);
+    }
+}
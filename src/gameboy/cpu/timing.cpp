@@ -0,0 +1,229 @@
+#include <iostream>
+#include <stdint.h>
+#include <string>
+#include <array>
+#include <utility>
+
+using namespace std;
+
+#include "../utils/utils.hpp"
+#include "../logging/logger/logger.hpp"
+
+#include "cpu.hpp"
+
+/*
+
+    Micro-op description of each opcode, one character per M cycle
+    F: opcode fetch, R: read, W: write, I: internal, | ends the M cycles run when the condition fails
+
+*/
+
+static constexpr const char* describeOpcode(const uint8_t opcode) {
+    const uint8_t high = opcode >> 4;
+    const uint8_t low = opcode & 0xF;
+
+    // Register index in the opcode bits, 6 is [HL]
+    const uint8_t source = opcode & 0x7;
+    const uint8_t destination = (opcode >> 3) & 0x7;
+
+    // LD r, r and 8-bit ALU, [HL] is one read or write
+    if(opcode == 0x76) return "F"; // HALT
+    if(high >= 0x4 && high <= 0x7) return destination == 6 ? "FW" : source == 6 ? "FR" : "F";
+    if(high >= 0x8 && high <= 0xB) return source == 6 ? "FR" : "F";
+
+    if(high <= 0x3) {
+        switch(low) {
+            case 0x1: return "FRR"; // LD rr, n16
+            case 0x2: return "FW"; // LD [rr], A
+            case 0xA: return "FR"; // LD A, [rr]
+            case 0x3: case 0xB: case 0x9: return "FI"; // INC rr, DEC rr, ADD HL, rr
+            case 0x4: case 0x5: case 0xC: case 0xD: return destination == 6 ? "FRW" : "F"; // INC, DEC
+            case 0x6: case 0xE: return destination == 6 ? "FRW" : "FR"; // LD r, n8
+            case 0x7: case 0xF: return "F"; // Rotations, DAA, CPL, SCF, CCF
+        }
+
+        if(opcode == 0x08) return "FRRWW"; // LD [n16], SP
+        if(opcode == 0x18) return "FRI"; // JR e8
+        if((opcode & 0xE7) == 0x20) return "FR|I"; // JR cc, e8
+
+        return "F"; // NOP, STOP
+    }
+
+    if((opcode & 0xC7) == 0xC6) return "FR"; // ALU A, n8
+    if((opcode & 0xC7) == 0xC7) return "FIWW"; // RST
+    if((opcode & 0xE7) == 0xC0) return "FI|RRI"; // RET cc
+    if((opcode & 0xE7) == 0xC2) return "FRR|I"; // JP cc, n16
+    if((opcode & 0xE7) == 0xC4) return "FRR|IWW"; // CALL cc, n16
+    if((opcode & 0xCF) == 0xC1) return "FRR"; // POP
+    if((opcode & 0xCF) == 0xC5) return "FIWW"; // PUSH
+
+    switch(opcode) {
+        case 0xC3: return "FRRI"; // JP n16
+        case 0xC9: case 0xD9: return "FRRI"; // RET, RETI
+        case 0xCB: return "FF"; // Prefix, the prefixed opcode continues the sequence
+        case 0xCD: return "FRRIWW"; // CALL n16
+        case 0xE0: return "FRW"; // LDH [n8], A
+        case 0xF0: return "FRR"; // LDH A, [n8]
+        case 0xE2: return "FW"; // LD [C], A
+        case 0xF2: return "FR"; // LD A, [C]
+        case 0xE8: return "FRII"; // ADD SP, e8
+        case 0xF8: return "FRI"; // LD HL, SP + e8
+        case 0xF9: return "FI"; // LD SP, HL
+        case 0xEA: return "FRRW"; // LD [n16], A
+        case 0xFA: return "FRRR"; // LD A, [n16]
+        case 0xEC: return "FRRR"; // Custom read address
+    }
+
+    return "F"; // JP HL, DI, EI, custom DUMPR and unknown opcodes
+}
+
+static constexpr const char* describePrefixed(const uint8_t prefixed) {
+    // Rotations, shifts, BIT, RES and SET, [HL] is read and written back but by BIT
+    if((prefixed & 0x7) != 6) return "FF";
+
+    return (prefixed >> 6) == 0x1 ? "FFR" : "FFRW";
+}
+
+// Interrupt dispatch, PC pushed then the vector loaded
+#define INTERRUPT_DESCRIPTION "IIWWI"
+
+/*
+
+    Tables, generated at compile time from the descriptions
+
+*/
+
+static constexpr MicroOps parseMicroOps(const char* description) {
+    MicroOps sequence = {};
+
+    for(int i = 0; description[i]; i++) {
+        switch(description[i]) {
+            case 'F': sequence.ops[sequence.length++] = MicroOp::Fetch; break;
+            case 'R': sequence.ops[sequence.length++] = MicroOp::Read; break;
+            case 'W': sequence.ops[sequence.length++] = MicroOp::Write; break;
+            case 'I': sequence.ops[sequence.length++] = MicroOp::Internal; break;
+            case '|': sequence.untaken = sequence.length; break;
+        }
+    }
+
+    return sequence;
+}
+
+template<size_t... opcodes>
+static constexpr array<MicroOps, 256> buildOpcodeMicroOps(index_sequence<opcodes...>) {
+    return {{ parseMicroOps(describeOpcode(opcodes))... }};
+}
+
+template<size_t... opcodes>
+static constexpr array<MicroOps, 256> buildPrefixedMicroOps(index_sequence<opcodes...>) {
+    return {{ parseMicroOps(describePrefixed(opcodes))... }};
+}
+
+// M cycles of each sequence, not taken or the extra ones when taken
+static constexpr array<uint8_t, 256> buildCycles(const array<MicroOps, 256> &sequences, const bool &taken) {
+    array<uint8_t, 256> cycles = {};
+
+    for(int i = 0; i < 256; i++) {
+        const MicroOps &sequence = sequences[i];
+
+        if(taken) cycles[i] = sequence.untaken ? sequence.length - sequence.untaken : 0;
+        else cycles[i] = sequence.untaken ? sequence.untaken : sequence.length;
+    }
+
+    return cycles;
+}
+
+static constexpr array<MicroOps, 256> opcodeSequences = buildOpcodeMicroOps(make_index_sequence<256>());
+static constexpr array<MicroOps, 256> prefixedSequences = buildPrefixedMicroOps(make_index_sequence<256>());
+
+static_assert(opcodeSequences[0xCD].length == MICRO_OPS_MAX_LENGTH, "CALL n16 is the longest instruction");
+static_assert(opcodeSequences[0xC4].untaken == 3 && opcodeSequences[0xC4].length == 6, "CALL cc, n16 takes 3 or 6 M cycles");
+
+const array<MicroOps, 256> CPU::opcodeMicroOps = opcodeSequences;
+const array<MicroOps, 256> CPU::prefixedMicroOps = prefixedSequences;
+const MicroOps CPU::interruptMicroOps = parseMicroOps(INTERRUPT_DESCRIPTION);
+
+const array<uint8_t, 256> CPU::opcodeCycles = buildCycles(opcodeSequences, false);
+const array<uint8_t, 256> CPU::prefixedCycles = buildCycles(prefixedSequences, false);
+const array<uint8_t, 256> CPU::branchCycles = buildCycles(opcodeSequences, true);
+
+/*
+
+    Accurate timing
+
+*/
+
+uint8_t CPU::cycleAccurate() {
+    logger->log("CPU Cycle, PC: ", toHex(this->pc));
+
+    this->idleLoopStep = 0;
+
+    // Halted until an interrupt is pending, it wakes the CPU even with IME reset
+    if(this->halted) {
+        if(!this->isInterruptPending()) return 4;
+        this->halted = false;
+    }
+
+    // Interrupt dispatch, the pushes are on their M cycle and the instruction at the vector starts after it
+    this->microOps = &interruptMicroOps;
+    this->microOp = 0;
+    this->microCycles = 0;
+
+    if(this->checkInterrupts()) {
+        while(this->microCycles < interruptMicroOps.length) this->tick();
+    }
+
+    // Opcode fetch on the first M cycle, then the sequence of the opcode
+    this->microOps = nullptr;
+    const uint8_t opcode = this->fetch();
+
+    this->microOps = &opcodeMicroOps[opcode];
+    this->microOp = 1;
+    this->microCycles = 0;
+    this->branchTaken = false;
+
+    (this->*opcodeTable[opcode])();
+
+    return this->finishMicroOps();
+}
+
+void CPU::busAccess() {
+    const MicroOps &sequence = *this->microOps;
+
+    // Next access of the sequence, the internal M cycles before it run first
+    while(this->microOp < sequence.length && sequence.ops[this->microOp] == MicroOp::Internal) this->microOp ++;
+
+    if(this->microOp >= sequence.length) {
+        logger->error("Error: Bus access past the micro-ops of the instruction, PC: ", toHex(this->pc));
+        return;
+    }
+
+    // The access is at the start of its M cycle
+    while(this->microCycles < this->microOp) this->tick();
+    this->microOp ++;
+}
+
+void CPU::tick() {
+    Scheduler* scheduler = this->gameboy->scheduler;
+
+    scheduler->addCycles(4);
+    this->microCycles ++;
+
+    if(scheduler->getCycles() >= scheduler->getNextTimestamp()) scheduler->runEvents();
+}
+
+uint8_t CPU::finishMicroOps() {
+    const MicroOps &sequence = *this->microOps;
+    const uint8_t length = sequence.untaken && !this->branchTaken ? sequence.untaken : sequence.length;
+
+    this->microOps = nullptr;
+
+    // The M cycles after the last access have no effect on the bus, the caller adds them
+    return length > this->microCycles ? 4 * (length - this->microCycles) : 0;
+}
+
+void CPU::takeBranch(const uint8_t &opcode) {
+    // The taken micro-ops run with the instruction, or the clock gets the extra cycles now
+    if(this->microOps) this->branchTaken = true;
+    else this->gameboy->scheduler->addCycles(4 * branchCycles[opcode]);
+}
@@ -1,5 +1,8 @@
 #include <iostream>
 #include <string>
+#include <fstream>
+#include <algorithm>
+#include <cstring>
 
 using namespace std;
 
@@ -9,20 +12,11 @@ using namespace std;
 #include "memory/memory.hpp"
 #include "logging/logger/logger.hpp"
 
-#include "sdl/sdl.hpp"
+#include "sink/sink.hpp"
+#include "savestate/savestate.hpp"
 
-/*
-
-    Get instance
-
-*/
-
-Gameboy* Gameboy::getInstance() {
-    if(!Gameboy::instance) Gameboy::instance = new Gameboy();
-    return Gameboy::instance;
-}
-
-Gameboy* Gameboy::instance = nullptr;
+// Shared by the machines without a sink, it has no state
+static NullSink nullSink;
 
 /*
 
@@ -30,21 +24,28 @@ Gameboy* Gameboy::instance = nullptr;
 
 */
 
-Gameboy::Gameboy() : cpu(new CPU(this)), memory(new Memory(this)), ppu(new PPU(this)), timer(new Timer(this)) ,running(true), cyclesCounter(0), Mcycles(0), Tcycles(0) {
-    logger = Logger::getInstance()->getLogger("Gameboy");
+Gameboy::Gameboy(Logger* masterLogger) : masterLogger(masterLogger ? masterLogger : new Logger()), ownsMasterLogger(!masterLogger), cpu(new CPU(this)), memory(new Memory(this)), ppu(new PPU(this)), timer(new Timer(this)), cartridge(new Cartridge(this)), scheduler(new Scheduler(this)), rewind(new Rewind(this)), jit(new Jit(this)), apu(new APU(this)), joypad(new Joypad(this)), pacer(new Pacer(this)), sink(&nullSink), running(true), engine(Engine::Interpreter), timing(Timing::Fast), lockstep(nullptr), lockstepSteps(0), lockstepMismatch() {
+    logger = this->masterLogger->getLogger("Gameboy");
     logger->log("Gameboy Constructor");
 }
 
 Gameboy::~Gameboy() {
     logger->log("Gameboy Destructor");
 
-    Gameboy::instance = nullptr;
-
+    delete pacer;
+    delete joypad;
+    delete apu;
+    delete jit;
     delete cpu;
     delete memory;
     delete ppu;
     delete logger;
     delete timer;
+    delete cartridge;
+    delete rewind;
+    delete scheduler;
+
+    if(this->ownsMasterLogger) delete this->masterLogger;
 }
 
 /*
@@ -56,10 +57,6 @@ Gameboy::~Gameboy() {
 void Gameboy::init() {
     logger->log("Gameboy initializing");
 
-    // Reset counters
-    this->Mcycles = 0;
-    this->Tcycles = 0;
-
     // Set vars
     this->running = true;
 }
@@ -68,62 +65,257 @@ void Gameboy::runMcycle() {
     // Run one M - cycle
     logger->log("---> Gameboy run M cycle");
 
-    this->cyclesCounter = 0;
-    while(this->cyclesCounter < 4) {
-        /*
-        
-            PPU T cycle
-        
-        */
-
-        // Get LCD status var
-        const uint8_t lcdControl = this->memory->fetch8(0xFF40);
-        const uint8_t isEnable = (lcdControl & 0x80) >> 7;
-
-        // Check if LCD is enabled
-        if(isEnable == 1) {
-            *logger << "PPU cycle, Tcycles: " + to_string(this->Tcycles) + ", Mcycles: " + to_string(this->Mcycles) + ", LY: " + to_string(this->ppu->getCurrentLY());
-            
-            // PPU cycle
-            this->ppu->step();
-
-            // Count cycles
-            this->Tcycles ++;
-            if(this->Tcycles >= 456) this->Tcycles = 0; // Reset cycles
-        } else this->Tcycles = 0; // Reset cycles
-
-        /*
-        
-            CPU M cycle, one every 4 PPU T cycles
-        
-        */
-    
-        if(this->cyclesCounter == 3) {
-            // Memory cycle
-            this->memory->cycle();
-
-            // CPU cycle
-            this->cpu->cycle();
-
-            // Count cycles
-            this->Mcycles ++;
-        }
-        
-        this->cyclesCounter ++;
-    }
+    // CPU instruction, its cycles are added once it ran
+    this->scheduler->addCycles(this->timing == Timing::Accurate ? this->cpu->cycleAccurate() : this->cpu->cycle());
+
+    // PPU and other components, run the events reached by the CPU
+    if(this->scheduler->getCycles() >= this->scheduler->getNextTimestamp()) this->scheduler->runEvents();
+}
+
+void Gameboy::runFrames(const uint64_t &frames) {
+    logger->log("Gameboy running ", frames, " frames");
+
+    this->running = true;
+    this->runPaced(this->scheduler->getCycles() + frames * DOTS_PER_LINE * LINES_PER_FRAME);
 }
 
 void Gameboy::freeRun() {
     logger->log("Gameboy starting");
 
     this->running = true;
-    while(1) {
-        // Do not excute PPU or CPU cycles when on pause
-        if(!this->running) break;
+    this->runPaced(NO_EVENT);
+}
+
+void Gameboy::runPaced(const uint64_t &cycles) {
+    if(this->pacer->getMode() == Pacing::None) {
+        this->runUntil(cycles);
+        return;
+    }
+
+    // The pacer sleeps between two frames, the machine runs them unchanged
+    while(this->running && this->scheduler->getCycles() < cycles) {
+        this->runUntil(min(cycles, this->scheduler->getCycles() + DOTS_PER_LINE * LINES_PER_FRAME));
+        this->pacer->wait();
+    }
+}
+
+void Gameboy::runUntil(const uint64_t &cycles) {
+    while(this->running && this->scheduler->getCycles() < cycles) {
+        // Bus accesses on their M cycle, the clock runs during the instruction
+        if(this->timing == Timing::Accurate) this->scheduler->addCycles(this->cpu->cycleAccurate());
+
+        // OAM DMA, the interpreter checks every access against the bus of the transfer
+        else if(this->memory->isDmaActive()) this->scheduler->addCycles(this->cpu->cycle());
+
+        // Translated block, it ends before the next event and the end of the run
+        else if(this->engine == Engine::Jit) this->jit->run(min(this->scheduler->getNextTimestamp(), cycles));
+
+        // Pre-decoded instruction, the record holds its cycles
+        else if(this->engine == Engine::Threaded) this->scheduler->addCycles(this->cpu->cycleDecoded());
+
+        // CPU instruction
+        else this->scheduler->addCycles(this->cpu->cycle());
+
+        // Run the events reached by the CPU, the deadline is read again as instructions can schedule events
+        if(this->scheduler->getCycles() >= this->scheduler->getNextTimestamp()) this->scheduler->runEvents();
+
+        // Halted or idle loop, nothing changes before the next event
+        else if(this->cpu->isIdle()) this->skipIdle(cycles);
+
+        if(this->lockstep) this->checkLockstep();
+    }
+}
+
+void Gameboy::skipIdle(const uint64_t &cycles) {
+    const uint64_t step = this->cpu->getIdleStep();
+    if(!step) return;
+
+    // Stop before the next event, the end of the run and at most one frame ahead (no event while the LCD is off)
+    const uint64_t now = this->scheduler->getCycles();
+    const uint64_t deadline = min(min(this->scheduler->getNextTimestamp(), cycles), now + DOTS_PER_LINE * LINES_PER_FRAME);
+    if(deadline <= now) return;
+
+    // Whole iterations only, the instruction that reaches the deadline runs as it would have
+    const uint64_t iterations = (deadline - now - 1) / step;
+    this->scheduler->addCycles(iterations * step);
+}
+
+/*
+
+    Engines
+
+*/
+
+bool Gameboy::setEngine(const Engine &engine) {
+    if(engine == Engine::Jit && !Jit::isSupported()) {
+        logger->error("Error: The JIT needs an x86-64 host");
+        return false;
+    }
+
+    // Drop the blocks and the decoded instructions, the RAM pages holding code get their direct store back
+    if(engine != this->engine) {
+        this->jit->flush();
+        this->cpu->flushDecoded();
+    }
+
+    this->engine = engine;
+    return true;
+}
+
+void Gameboy::setLockstep(Gameboy* reference) {
+    this->lockstep = reference;
+    this->lockstepSteps = 0;
+    this->lockstepMismatch = {};
+
+    if(!reference) return;
+
+    SaveState* state = new SaveState();
+    this->saveState(*state);
 
-        // Run one M - cycle
-        this->runMcycle();
+    reference->setEngine(Engine::Interpreter);
+    reference->setTiming(this->timing);
+    reference->loadState(*state);
+
+    delete state;
+}
+
+void Gameboy::checkLockstep() {
+    this->lockstep->runUntil(this->scheduler->getCycles());
+
+    // Registers and clock after every step, the whole state at intervals
+    CPUState cpu = {}, referenceCpu = {};
+    this->cpu->saveState(cpu);
+    this->lockstep->cpu->saveState(referenceCpu);
+
+    const bool sameRegisters = memcmp(&cpu, &referenceCpu, sizeof(CPUState)) == 0 && this->scheduler->getCycles() == this->lockstep->scheduler->getCycles();
+    bool same = sameRegisters;
+
+    if(same && ++this->lockstepSteps % LOCKSTEP_STATE_INTERVAL == 0) {
+        SaveState* state = new SaveState();
+        SaveState* referenceState = new SaveState();
+
+        this->saveState(*state);
+        this->lockstep->saveState(*referenceState);
+        same = memcmp(state, referenceState, sizeof(SaveState)) == 0;
+
+        delete state;
+        delete referenceState;
     }
+
+    if(same) return;
+
+    // Kept for the frontends, the logs may be compiled out
+    this->lockstepMismatch = { true, !sameRegisters, this->scheduler->getCycles(), this->lockstep->scheduler->getCycles(), this->cpu->getPC(), this->lockstep->cpu->getPC(), this->jit->getLastBlock() };
+
+    logger->error("Error: Lockstep mismatch at cycle ", this->scheduler->getCycles(), " (reference ", this->lockstep->scheduler->getCycles(), "), PC ", toHex(this->cpu->getPC()), " (reference ", toHex(this->lockstep->cpu->getPC()), "), last block ", toHex(this->jit->getLastBlock()));
+    this->stop();
+}
+
+/*
+
+    Save states
+
+*/
+
+void Gameboy::saveState(SaveState &state) const {
+    state.header = {};
+    state.header.magic = SAVE_STATE_MAGIC;
+    state.header.version = SAVE_STATE_VERSION;
+    state.header.size = sizeof(SaveState);
+    state.header.romChecksum = this->cartridge->getGlobalChecksum();
+
+    this->scheduler->saveState(state.scheduler);
+    this->cpu->saveState(state.cpu);
+    this->timer->saveState(state.timer);
+    this->joypad->saveState(state.joypad);
+    this->apu->saveState(state.apu);
+    this->ppu->saveState(state.ppu);
+    this->memory->saveState(state.memory);
+    this->cartridge->saveState(state.cartridge);
+}
+
+bool Gameboy::loadState(const SaveState &state, const bool &keepRewind) {
+    if(state.header.magic != SAVE_STATE_MAGIC || state.header.version != SAVE_STATE_VERSION || state.header.size != sizeof(SaveState)) {
+        logger->error("Error: Save state version ", state.header.version, " not supported, expected ", SAVE_STATE_VERSION);
+        return false;
+    }
+
+    if(state.header.romChecksum != this->cartridge->getGlobalChecksum()) {
+        logger->error("Error: Save state made with another ROM, checksum ", toHex(state.header.romChecksum));
+        return false;
+    }
+
+    // Memory first, the cartridge maps its banks over the restored page tables
+    this->memory->loadState(state.memory);
+    this->cartridge->loadState(state.cartridge);
+
+    this->cpu->loadState(state.cpu);
+    this->timer->loadState(state.timer);
+    this->joypad->loadState(state.joypad);
+    this->apu->loadState(state.apu);
+    this->ppu->loadState(state.ppu);
+    this->scheduler->loadState(state.scheduler);
+
+    // Translated blocks and decoded instructions may come from RAM that changed
+    this->jit->flush();
+    this->cpu->flushDecoded();
+
+    // The master clock jumped (forward or back), real time pacing starts again from it
+    this->pacer->start();
+
+    // The history belongs to the previous timeline
+    if(!keepRewind) this->rewind->reset();
+
+    return true;
+}
+
+bool Gameboy::saveState(const string &path) const {
+    SaveState* state = new SaveState();
+    this->saveState(*state);
+
+    // One write of the whole structure
+    ofstream file(path, ios::binary);
+    file.write((const char*) state, sizeof(SaveState));
+
+    const bool written = file.good();
+    delete state;
+
+    if(!written) logger->error("Error: Could not write save state : ", path);
+    return written;
+}
+
+bool Gameboy::loadState(const string &path) {
+    SaveState* state = new SaveState();
+
+    // One read of the whole structure
+    ifstream file(path, ios::binary);
+    file.read((char*) state, sizeof(SaveState));
+
+    bool loaded = false;
+    if(file.gcount() != sizeof(SaveState)) logger->error("Error: Could not read save state : ", path);
+    else loaded = this->loadState(*state);
+
+    delete state;
+    return loaded;
+}
+
+/*
+
+    Getters and Setters
+
+*/
+
+// Cycle counts come from the scheduler master clock
+uint64_t Gameboy::getMcycles() const {
+    return this->scheduler->getCycles() / 4;
+}
+
+uint64_t Gameboy::getTcycles() const {
+    return this->scheduler->getCycles();
+}
+
+void Gameboy::setSink(Sink* sink) {
+    this->sink = sink ? sink : &nullSink;
 }
 
 void Gameboy::setBootRom(const string &bootRomPath) {
@@ -133,6 +325,5 @@ void Gameboy::setBootRom(const string &bootRomPath) {
 
 void Gameboy::setGameRom(const string &gameRomPath) {
     logger->log("Gameboy setting game ROM");
-    this->memory->loadRom(ROM_FIXED, gameRomPath, 0, ROM_FIXED_SIZE);
-    this->memory->loadRom(ROM_BANKED, gameRomPath, ROM_FIXED_SIZE, ROM_BANKED_SIZE);
+    this->cartridge->load(gameRomPath);
 }
\ No newline at end of file
@@ -11,32 +11,83 @@ using namespace std;
 #include "logging/log/log.hpp"
 #include "utils/utils.hpp"
 #include "ppu/ppu.hpp"
-#include "sdl/sdl.hpp"
+#include "sink/sink.hpp"
 #include "timer/timer.hpp"
+#include "cartridge/cartridge.hpp"
+#include "scheduler/scheduler.hpp"
+#include "rewind/rewind.hpp"
+#include "jit/jit.hpp"
+#include "apu/apu.hpp"
+#include "pacer/pacer.hpp"
+#include "joypad/joypad.hpp"
 
 // Forward declaration
 class CPU;
 class Memory;
 class PPU;
 class Timer;
+class Cartridge;
+class Scheduler;
+class Rewind;
+class Jit;
+class APU;
+class Pacer;
+class Joypad;
+struct SaveState;
+
+// CPU execution engine, the interpreter is the reference
+enum class Engine : uint8_t {
+    Interpreter,
+    Threaded, // Interpreter handlers run from the pre-decoded instruction cache
+    Jit // Translated blocks, falls back to the interpreter for the rest
+};
+
+// CPU timing, both charge the cycles of each instruction
+enum class Timing : uint8_t {
+    Fast, // The instruction runs at once, its cycles are added after it
+    Accurate // Each bus access runs on its M cycle from the micro-ops of the opcode, the interpreter runs with any engine
+};
+
+// Instructions or blocks between two full state comparisons in lockstep mode, the CPU and the clock are compared after each one
+#define LOCKSTEP_STATE_INTERVAL 256
+
+// First difference found in lockstep mode
+struct LockstepMismatch {
+    bool found;
+    bool registers; // The CPU registers or the clock differ, else another part of the whole state
+    uint64_t cycles, referenceCycles;
+    uint16_t pc, referencePC;
+    uint16_t lastBlock; // Start of the last block run by the JIT
+};
 
 class Gameboy {
     public:
-        // Get instance
-        static Gameboy* getInstance();
-
-        // Destructor
+        // Constructors, the logger context is shared when given, else the Gameboy owns one
+        Gameboy(Logger* masterLogger = nullptr);
         ~Gameboy();
 
+    private:
+        // Logger context, initialized first as the components get their logger from it
+        Logger* masterLogger;
+        bool ownsMasterLogger;
+
+    public:
         // Components
         CPU* cpu;
         Memory* memory;
         PPU* ppu;
         Timer* timer;
+        Cartridge* cartridge;
+        Scheduler* scheduler;
+        Rewind* rewind;
+        Jit* jit;
+        APU* apu; // After the scheduler, it schedules its first event
+        Joypad* joypad; // Same
+        Pacer* pacer; // Real time pacing of runFrames and freeRun, unbounded by default
         
-        // Renderer
-        SDLRenderer* renderer;
-        inline void setRenderer(SDLRenderer* renderer) { this->renderer = renderer; }
+        // Video and joypad sink, a null sink when none is set
+        Sink* sink;
+        void setSink(Sink* sink);
 
         // Init functions
         void setBootRom(const string &bootRomPath);
@@ -44,31 +95,53 @@ class Gameboy {
 
         // Functions
         void init();
-        void runMcycle();
+        void runMcycle(); // One instruction and the events it reaches
+        void runFrames(const uint64_t &frames); // Run a number of frames worth of cycles, returns early if stopped
         void freeRun();
 
+        // Save states, a load fails on a state from another version or ROM and drops the rewind history unless kept (rewind itself)
+        void saveState(SaveState &state) const;
+        bool loadState(const SaveState &state, const bool &keepRewind = false);
+        bool saveState(const string &path) const;
+        bool loadState(const string &path);
+
+        // Execution engine, false if the JIT is not supported on this host
+        bool setEngine(const Engine &engine);
+
+        inline void setTiming(const Timing &timing) { this->timing = timing; }
+
+        // Differential testing, the reference machine (same ROM) starts from this state and runs with the interpreter behind this one,
+        // the machine stops on the first difference, nullptr to disable
+        void setLockstep(Gameboy* reference);
+        inline const LockstepMismatch& getLockstepMismatch() const { return this->lockstepMismatch; }
+
         inline void pause() { this->running = false; }
         inline void stop() { this->running = false; }
 
         // Getters and Setters
-        inline const int& getMcycles() const { return this->Mcycles; }
-        inline const int& getTcycles() const { return this->Tcycles; }
+        inline bool isRunning() const { return this->running; }
+        inline Logger* getMasterLogger() const { return this->masterLogger; }
+        inline const Engine& getEngine() const { return this->engine; }
+        inline const Timing& getTiming() const { return this->timing; }
+        uint64_t getMcycles() const;
+        uint64_t getTcycles() const;
 
     private:
-        // Constructors
-        Gameboy();
-
-        // Singleton instance
-        static Gameboy* instance;
-
         // Logger
         Log* logger;
     
         // Vars
         bool running;
 
-        // Cycles counters
-        int cyclesCounter;
-        int Mcycles;
-        int Tcycles;
+        Engine engine;
+        Timing timing;
+
+        Gameboy* lockstep; // Reference machine, nullptr if not in lockstep mode
+        uint64_t lockstepSteps;
+        LockstepMismatch lockstepMismatch;
+
+        void runUntil(const uint64_t &cycles); // Run the CPU and the events up to a master clock timestamp
+        void runPaced(const uint64_t &cycles); // Same, one frame at a time with the pacer in between
+        void checkLockstep(); // Bring the reference machine to the same clock and compare
+        void skipIdle(const uint64_t &cycles); // Fast forward an idle CPU to just before the next event or the timestamp
 };
\ No newline at end of file
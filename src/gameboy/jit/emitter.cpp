@@ -0,0 +1,319 @@
+#include <stdint.h>
+#include <vector>
+
+using namespace std;
+
+#include "emitter.hpp"
+
+/*
+
+    Encoding
+
+*/
+
+void Emitter::dword(const uint32_t &value) {
+    for(int i = 0; i < 4; i++) this->byte(value >> (i * 8));
+}
+
+void Emitter::qword(const uint64_t &value) {
+    for(int i = 0; i < 8; i++) this->byte(value >> (i * 8));
+}
+
+void Emitter::rex(const bool &wide, const uint8_t &reg, const bool &byteReg, const Operand &operand, const bool &byteOperand) {
+    const uint8_t value = 0x40 | (wide << 3) | ((reg >> 3) << 2) | (operand.memory ? 0 : operand.reg >> 3);
+
+    // SPL, BPL, SIL and DIL only exist with a REX prefix, AH to BH are never used
+    const bool lowByte = (byteReg && reg >= RSP && reg <= RDI) || (byteOperand && !operand.memory && operand.reg >= RSP && operand.reg <= RDI);
+
+    if(value != 0x40 || lowByte) this->byte(value);
+}
+
+void Emitter::modrm(const uint8_t &reg, const Operand &operand) {
+    if(!operand.memory) return this->byte(0xC0 | ((reg & 0x7) << 3) | (operand.reg & 0x7));
+
+    // [rbp + disp8] or [rbp + disp32]
+    if(operand.displacement >= -128 && operand.displacement <= 127) {
+        this->byte(0x40 | ((reg & 0x7) << 3) | RBP);
+        this->byte(operand.displacement);
+    } else {
+        this->byte(0x80 | ((reg & 0x7) << 3) | RBP);
+        this->dword(operand.displacement);
+    }
+}
+
+void Emitter::encode(const uint8_t &opcode, const uint8_t &reg, const bool &byteReg, const Operand &operand, const bool &byteOperand, const bool &wide) {
+    this->rex(wide, reg, byteReg, operand, byteOperand);
+    this->byte(opcode);
+    this->modrm(reg, operand);
+}
+
+void Emitter::encode2(const uint8_t &opcode, const uint8_t &reg, const bool &byteReg, const Operand &operand, const bool &byteOperand, const bool &wide) {
+    this->rex(wide, reg, byteReg, operand, byteOperand);
+    this->byte(0x0F);
+    this->byte(opcode);
+    this->modrm(reg, operand);
+}
+
+/*
+
+    8-bit operations, two memory operands go through AL
+
+*/
+
+void Emitter::mov8(const Operand &destination, const Operand &source) {
+    if(destination.memory && source.memory) {
+        this->mov8(reg8(RAX), source);
+        return this->mov8(destination, reg8(RAX));
+    }
+
+    if(!destination.memory) this->encode(0x8A, destination.reg, true, source, true);
+    else this->encode(0x88, source.reg, true, destination, true);
+}
+
+void Emitter::movImm8(const Operand &destination, const uint8_t &value) {
+    this->encode(0xC6, 0, false, destination, true);
+    this->byte(value);
+}
+
+void Emitter::alu8(const Alu &op, const Operand &destination, const Operand &source) {
+    if(destination.memory && source.memory) {
+        this->mov8(reg8(RAX), source);
+        return this->alu8(op, destination, reg8(RAX));
+    }
+
+    if(!destination.memory) this->encode((uint8_t) op * 8 + 2, destination.reg, true, source, true);
+    else this->encode((uint8_t) op * 8, source.reg, true, destination, true);
+}
+
+void Emitter::aluImm8(const Alu &op, const Operand &destination, const uint8_t &value) {
+    this->encode(0x80, (uint8_t) op, false, destination, true);
+    this->byte(value);
+}
+
+void Emitter::testImm8(const Operand &operand, const uint8_t &value) {
+    this->encode(0xF6, 0, false, operand, true);
+    this->byte(value);
+}
+
+void Emitter::inc8(const Operand &operand) {
+    this->encode(0xFE, 0, false, operand, true);
+}
+
+void Emitter::dec8(const Operand &operand) {
+    this->encode(0xFE, 1, false, operand, true);
+}
+
+void Emitter::not8(const Operand &operand) {
+    this->encode(0xF6, 2, false, operand, true);
+}
+
+void Emitter::shl8(const Operand &operand, const uint8_t &count) {
+    this->encode(0xC0, 4, false, operand, true);
+    this->byte(count);
+}
+
+void Emitter::setcc(const Condition &condition, const Operand &operand) {
+    this->encode2(0x90 + (uint8_t) condition, 0, false, operand, true);
+}
+
+/*
+
+    32-bit operations
+
+*/
+
+void Emitter::movzx8(const uint8_t &destination, const Operand &source) {
+    this->encode2(0xB6, destination, false, source, true);
+}
+
+void Emitter::mov32(const uint8_t &destination, const uint8_t &source) {
+    this->encode(0x8B, destination, false, reg8(source), false);
+}
+
+void Emitter::movImm32(const uint8_t &destination, const uint32_t &value) {
+    if(destination >= R8) this->byte(0x41);
+    this->byte(0xB8 + (destination & 0x7));
+    this->dword(value);
+}
+
+void Emitter::orReg32(const uint8_t &destination, const uint8_t &source) {
+    this->encode(0x0B, destination, false, reg8(source), false);
+}
+
+void Emitter::orImm32(const uint8_t &destination, const uint32_t &value) {
+    this->encode(0x81, 1, false, reg8(destination), false);
+    this->dword(value);
+}
+
+void Emitter::addImm32(const uint8_t &destination, const int32_t &value) {
+    this->encode(0x81, 0, false, reg8(destination), false);
+    this->dword(value);
+}
+
+void Emitter::shl32(const uint8_t &destination, const uint8_t &count) {
+    this->encode(0xC1, 4, false, reg8(destination), false);
+    this->byte(count);
+}
+
+void Emitter::shr32(const uint8_t &destination, const uint8_t &count) {
+    this->encode(0xC1, 5, false, reg8(destination), false);
+    this->byte(count);
+}
+
+void Emitter::bt32(const uint8_t &reg, const uint8_t &bit) {
+    this->encode2(0xBA, 4, false, reg8(reg), false);
+    this->byte(bit);
+}
+
+/*
+
+    16-bit memory operands
+
+*/
+
+void Emitter::movImm16(const int32_t &displacement, const uint16_t &value) {
+    this->byte(0x66);
+    this->encode(0xC7, 0, false, mem8(displacement), false);
+    this->byte(value & 0xFF);
+    this->byte(value >> 8);
+}
+
+void Emitter::inc16(const int32_t &displacement) {
+    this->byte(0x66);
+    this->encode(0xFF, 0, false, mem8(displacement), false);
+}
+
+void Emitter::dec16(const int32_t &displacement) {
+    this->byte(0x66);
+    this->encode(0xFF, 1, false, mem8(displacement), false);
+}
+
+/*
+
+    64-bit operations, [base] and [base + index] operands take any register but RSP, RBP, R12 and R13 (no SIB or displacement byte)
+
+*/
+
+void Emitter::movImm64(const uint8_t &destination, const uint64_t &value) {
+    this->byte(0x48 | (destination >> 3));
+    this->byte(0xB8 + (destination & 0x7));
+    this->qword(value);
+}
+
+void Emitter::mov64(const uint8_t &destination, const uint8_t &source) {
+    this->encode(0x8B, destination, false, reg8(source), false, true);
+}
+
+void Emitter::test64(const uint8_t &reg) {
+    this->encode(0x85, reg, false, reg8(reg), false, true);
+}
+
+void Emitter::addMemImm64(const uint8_t &base, const int32_t &value) {
+    this->byte(0x48 | (base >> 3));
+    this->byte(0x81);
+    this->byte(base & 0x7);
+    this->dword(value);
+}
+
+void Emitter::cmpMemImm8(const uint8_t &base, const uint8_t &value) {
+    if(base >= R8) this->byte(0x41);
+    this->byte(0x80);
+    this->byte(0x38 | (base & 0x7));
+    this->byte(value);
+}
+
+void Emitter::loadPage(const uint8_t &destination, const uint8_t &base, const uint8_t &index) {
+    this->byte(0x48 | ((destination >> 3) << 2) | ((index >> 3) << 1) | (base >> 3));
+    this->byte(0x8B);
+    this->byte(((destination & 0x7) << 3) | 0x4);
+    this->byte(0xC0 | ((index & 0x7) << 3) | (base & 0x7));
+}
+
+void Emitter::loadByte(const uint8_t &destination, const uint8_t &base, const uint8_t &index) {
+    const uint8_t prefix = 0x40 | ((destination >> 3) << 2) | ((index >> 3) << 1) | (base >> 3);
+    if(prefix != 0x40) this->byte(prefix);
+
+    this->byte(0x0F);
+    this->byte(0xB6);
+    this->byte(((destination & 0x7) << 3) | 0x4);
+    this->byte(((index & 0x7) << 3) | (base & 0x7));
+}
+
+void Emitter::storeByte(const uint8_t &base, const uint8_t &index, const uint8_t &source) {
+    const uint8_t prefix = 0x40 | ((source >> 3) << 2) | ((index >> 3) << 1) | (base >> 3);
+    if(prefix != 0x40 || (source >= RSP && source <= RDI)) this->byte(prefix);
+
+    this->byte(0x88);
+    this->byte(((source & 0x7) << 3) | 0x4);
+    this->byte(((index & 0x7) << 3) | (base & 0x7));
+}
+
+/*
+
+    Stack and calls
+
+*/
+
+void Emitter::push(const uint8_t &reg) {
+    if(reg >= R8) this->byte(0x41);
+    this->byte(0x50 + (reg & 0x7));
+}
+
+void Emitter::pop(const uint8_t &reg) {
+    if(reg >= R8) this->byte(0x41);
+    this->byte(0x58 + (reg & 0x7));
+}
+
+void Emitter::subRsp(const uint8_t &value) {
+    this->byte(0x48);
+    this->byte(0x83);
+    this->byte(0xEC);
+    this->byte(value);
+}
+
+void Emitter::addRsp(const uint8_t &value) {
+    this->byte(0x48);
+    this->byte(0x83);
+    this->byte(0xC4);
+    this->byte(value);
+}
+
+void Emitter::call(const uint8_t &reg) {
+    if(reg >= R8) this->byte(0x41);
+    this->byte(0xFF);
+    this->byte(0xD0 | (reg & 0x7));
+}
+
+void Emitter::ret() {
+    this->byte(0xC3);
+}
+
+/*
+
+    Jumps
+
+*/
+
+size_t Emitter::jcc(const Condition &condition) {
+    this->byte(0x0F);
+    this->byte(0x80 + (uint8_t) condition);
+    this->dword(0);
+
+    return this->code.size() - 4;
+}
+
+size_t Emitter::jmp() {
+    this->byte(0xE9);
+    this->dword(0);
+
+    return this->code.size() - 4;
+}
+
+void Emitter::bind(const size_t &label) {
+    this->bind(label, this->code.size());
+}
+
+void Emitter::bind(const size_t &label, const size_t &target) {
+    const uint32_t displacement = (uint32_t) (target - (label + 4));
+    for(int i = 0; i < 4; i++) this->code[label + i] = displacement >> (i * 8);
+}
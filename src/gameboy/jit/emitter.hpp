@@ -0,0 +1,109 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+using namespace std;
+
+/*
+
+    x86-64 machine code emitter, only the encodings used by the JIT
+    Byte operands are a register or [rbp + displacement], rbp holds the CPU pointer in the translated blocks
+
+*/
+
+enum HostRegister : uint8_t {
+    RAX = 0, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+    R8, R9, R10, R11, R12, R13, R14, R15
+};
+
+// Group 1 operations, the value is the /digit of the 0x80 opcode
+enum class Alu : uint8_t {
+    Add = 0, Or = 1, Adc = 2, Sbb = 3, And = 4, Sub = 5, Xor = 6, Cmp = 7
+};
+
+// Condition codes of jcc and setcc
+enum class Condition : uint8_t {
+    Below = 0x2, AboveEqual = 0x3, Equal = 0x4, NotEqual = 0x5, BelowEqual = 0x6, Above = 0x7
+};
+
+struct Operand {
+    bool memory; // [rbp + displacement] when set, else the register
+    uint8_t reg;
+    int32_t displacement;
+};
+
+inline Operand reg8(const uint8_t &reg) { return { false, reg, 0 }; }
+inline Operand mem8(const int32_t &displacement) { return { true, RBP, displacement }; }
+
+class Emitter {
+    public:
+        inline void clear() { this->code.clear(); }
+        inline size_t size() const { return this->code.size(); }
+        inline const uint8_t* data() const { return this->code.data(); }
+
+        // 8-bit operations
+        void mov8(const Operand &destination, const Operand &source);
+        void movImm8(const Operand &destination, const uint8_t &value);
+        void alu8(const Alu &op, const Operand &destination, const Operand &source);
+        void aluImm8(const Alu &op, const Operand &destination, const uint8_t &value);
+        void testImm8(const Operand &operand, const uint8_t &value);
+        void inc8(const Operand &operand);
+        void dec8(const Operand &operand);
+        void not8(const Operand &operand);
+        void shl8(const Operand &operand, const uint8_t &count);
+        void setcc(const Condition &condition, const Operand &operand);
+
+        // 32-bit operations on registers
+        void movzx8(const uint8_t &destination, const Operand &source); // movzx r32, r/m8
+        void mov32(const uint8_t &destination, const uint8_t &source);
+        void movImm32(const uint8_t &destination, const uint32_t &value);
+        void orReg32(const uint8_t &destination, const uint8_t &source);
+        void orImm32(const uint8_t &destination, const uint32_t &value);
+        void addImm32(const uint8_t &destination, const int32_t &value);
+        void shl32(const uint8_t &destination, const uint8_t &count);
+        void shr32(const uint8_t &destination, const uint8_t &count);
+        void bt32(const uint8_t &reg, const uint8_t &bit); // Bit to the carry flag
+
+        // 16-bit memory operands at [rbp + displacement]
+        void movImm16(const int32_t &displacement, const uint16_t &value);
+        void inc16(const int32_t &displacement);
+        void dec16(const int32_t &displacement);
+
+        // 64-bit
+        void movImm64(const uint8_t &destination, const uint64_t &value);
+        void mov64(const uint8_t &destination, const uint8_t &source);
+        void test64(const uint8_t &reg);
+        void addMemImm64(const uint8_t &base, const int32_t &value); // add qword [base], imm32
+        void cmpMemImm8(const uint8_t &base, const uint8_t &value); // cmp byte [base], imm8
+        void loadPage(const uint8_t &destination, const uint8_t &base, const uint8_t &index); // mov r64, [base + index * 8]
+        void loadByte(const uint8_t &destination, const uint8_t &base, const uint8_t &index); // movzx r32, byte [base + index]
+        void storeByte(const uint8_t &base, const uint8_t &index, const uint8_t &source); // mov byte [base + index], r8
+
+        // Stack and calls
+        void push(const uint8_t &reg);
+        void pop(const uint8_t &reg);
+        void subRsp(const uint8_t &value);
+        void addRsp(const uint8_t &value);
+        void call(const uint8_t &reg);
+        void ret();
+
+        // Jumps, rel32 patched with bind, the returned label is the position of the displacement
+        size_t jcc(const Condition &condition);
+        size_t jmp();
+        void bind(const size_t &label); // Jump to the current position
+        void bind(const size_t &label, const size_t &target);
+
+    private:
+        vector<uint8_t> code;
+
+        inline void byte(const uint8_t &value) { this->code.push_back(value); }
+        void dword(const uint32_t &value);
+        void qword(const uint64_t &value);
+
+        // Prefix, opcode and ModRM, reg is a register or an opcode extension
+        void rex(const bool &wide, const uint8_t &reg, const bool &byteReg, const Operand &operand, const bool &byteOperand);
+        void modrm(const uint8_t &reg, const Operand &operand);
+        void encode(const uint8_t &opcode, const uint8_t &reg, const bool &byteReg, const Operand &operand, const bool &byteOperand, const bool &wide = false);
+        void encode2(const uint8_t &opcode, const uint8_t &reg, const bool &byteReg, const Operand &operand, const bool &byteOperand, const bool &wide = false); // 0x0F escaped opcode
+};
@@ -0,0 +1,750 @@
+#include <iostream>
+#include <stdint.h>
+#include <cstring>
+#include <vector>
+#include <unordered_map>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+using namespace std;
+
+#include "../utils/utils.hpp"
+#include "../logging/logger/logger.hpp"
+
+#include "jit.hpp"
+
+// Host registers of the GB registers kept out of memory inside a block, all callee saved
+#define HOST_A RBX
+#define HOST_F R12
+#define HOST_H R13
+#define HOST_L R14
+#define HOST_B R15
+
+// Flag values of emitFlags that are not a host register
+#define FLAG_KEEP 0xFF
+#define FLAG_ZERO 0xFE
+#define FLAG_ONE 0xFD
+
+/*
+
+    Instruction classes
+
+*/
+
+enum class Translation : uint8_t {
+    None, // Left to the interpreter, ends the block before it
+    Native, // Translated
+    Call, // Interpreter handler called from the block
+    Exit // Interpreter handler called from the block, control flow or interrupt state change, ends the block
+};
+
+static Translation classify(const uint8_t &opcode) {
+    const uint8_t high = opcode >> 4;
+    const uint8_t low = opcode & 0xF;
+
+    // Loads, 8-bit ALU, 16-bit increments, CPL and SCF
+    if(opcode == 0x00 || opcode == 0x2F || opcode == 0x37) return Translation::Native;
+    if(high <= 0x3 && (low == 0x1 || low == 0x2 || low == 0x3 || low == 0xA || low == 0xB || low == 0x6 || low == 0xE)) return Translation::Native;
+    if(high <= 0x3 && (low == 0x4 || low == 0x5 || low == 0xC || low == 0xD)) return ((opcode >> 3) & 0x7) == 6 ? Translation::Call : Translation::Native; // INC / DEC [HL] read and write
+    if(high >= 0x4 && high <= 0xB) return opcode == 0x76 ? Translation::Exit : Translation::Native; // HALT
+    if((opcode & 0xC7) == 0xC6) return Translation::Native;
+    if(opcode == 0xE0 || opcode == 0xF0 || opcode == 0xE2 || opcode == 0xF2 || opcode == 0xEA || opcode == 0xFA) return Translation::Native;
+
+    // Control flow, DI and EI
+    if(opcode == 0x18 || (opcode & 0xE7) == 0x20) return Translation::Exit; // JR
+    if((opcode & 0xE7) == 0xC0 || (opcode & 0xE7) == 0xC2 || (opcode & 0xE7) == 0xC4) return Translation::Exit; // RET cc, JP cc, CALL cc
+    if(opcode == 0xC3 || opcode == 0xCD || opcode == 0xC9 || opcode == 0xD9 || opcode == 0xE9) return Translation::Exit;
+    if((opcode & 0xC7) == 0xC7) return Translation::Exit; // RST
+    if(opcode == 0xF3 || opcode == 0xFB) return Translation::Exit;
+
+    // Other instructions the interpreter implements
+    if(opcode == 0x07 || opcode == 0x0F || opcode == 0x17 || opcode == 0x1F || opcode == 0x27 || opcode == 0x3F || opcode == 0x08) return Translation::Call;
+    if(high <= 0x3 && low == 0x9) return Translation::Call; // ADD HL, rr
+    if((opcode & 0xCF) == 0xC1 || (opcode & 0xCF) == 0xC5) return Translation::Call; // POP, PUSH
+    if(opcode == 0xE8 || opcode == 0xF8 || opcode == 0xF9 || opcode == 0xEB || opcode == 0xEC) return Translation::Call;
+    if(opcode == 0xCB) return Translation::Call;
+
+    // STOP and unknown opcodes
+    return Translation::None;
+}
+
+/*
+
+    Helpers called from the blocks, System V calling convention
+
+*/
+
+static uint32_t readMemory(Memory* memory, uint32_t address) {
+    return memory->read8(address);
+}
+
+static void writeMemory(Memory* memory, uint32_t address, uint32_t value) {
+    memory->write8(address, value);
+}
+
+/*
+
+    Constructors and Destructors
+
+*/
+
+Jit::Jit(Gameboy* gameboy) : gameboy(gameboy), pages(), blocks(), lookup(), code(nullptr), codeUsed(0), lastBlock(0), cycleStart(0), cycleEnd(0) {
+    logger = gameboy->getMasterLogger()->getLogger("JIT");
+    logger->log("JIT Constructor");
+
+    // Register displacements from the CPU object
+    const CPU* cpu = gameboy->cpu;
+    const char* base = (const char*) cpu;
+
+    this->offsetA = (const char*) &cpu->a - base;
+    this->offsetF = (const char*) &cpu->f - base;
+    this->offsetB = (const char*) &cpu->b - base;
+    this->offsetC = (const char*) &cpu->c - base;
+    this->offsetD = (const char*) &cpu->d - base;
+    this->offsetE = (const char*) &cpu->e - base;
+    this->offsetH = (const char*) &cpu->h - base;
+    this->offsetL = (const char*) &cpu->l - base;
+    this->offsetSP = (const char*) &cpu->sp - base;
+    this->offsetPC = (const char*) &cpu->pc - base;
+}
+
+Jit::~Jit() {
+    logger->log("JIT Destructor");
+
+    // The memory may be gone, the code pages are not unprotected
+    for(Block* block : this->blocks) delete block;
+    for(auto &page : this->pages) delete page.second;
+
+    if(this->code) munmap(this->code, JIT_CODE_SIZE);
+
+    delete logger;
+}
+
+bool Jit::isSupported() {
+#if defined(__x86_64__)
+    return true;
+#else
+    return false;
+#endif
+}
+
+/*
+
+    Functions
+
+*/
+
+int Jit::interpret() {
+    this->gameboy->scheduler->addCycles(this->gameboy->cpu->cycle());
+
+    return 1;
+}
+
+int Jit::run(const uint64_t &deadline) {
+    CPU* cpu = this->gameboy->cpu;
+    cpu->idleLoopStep = 0;
+
+    // HALT and interrupt entry are left to the interpreter
+    if(cpu->halted || (cpu->ime && cpu->isInterruptPending())) return this->interpret();
+
+    // Only ROM and WRAM are translated
+    const uint16_t pc = cpu->pc;
+    const uint8_t page = pc >> 8;
+    const char* host = this->gameboy->memory->getReadPages()[page];
+
+    if(!host || (page >= (VRAM_OFFSET >> 8) && page < (WRAM_FIXED_OFFSET >> 8)) || page >= (OAM_OFFSET >> 8)) return this->interpret();
+
+    Block* block = this->getPage(pc, host)->blocks[pc & 0xFF];
+    if(!block) {
+        block = this->compile(pc, host);
+
+        // The cache may have been flushed to make room
+        this->getPage(pc, host)->blocks[pc & 0xFF] = block;
+    }
+
+    // The interpreter runs the events after each instruction, the last instruction of the block has to start before the deadline
+    if(!block->function || this->gameboy->scheduler->getCycles() + block->lastStart >= deadline) return this->interpret();
+
+    this->gameboy->memory->clearSideEffect();
+    this->lastBlock = pc;
+
+    return block->function(cpu);
+}
+
+Jit::CodePage* Jit::getPage(const uint16_t &pc, const char* host) {
+    PageLookup &entry = this->lookup[pc >> 8];
+    if(entry.host == host) return entry.page;
+
+    CodePage* &page = this->pages[host];
+    if(!page) page = new CodePage();
+
+    entry.host = host;
+    entry.page = page;
+
+    return page;
+}
+
+void Jit::flush() {
+    for(Block* block : this->blocks) delete block;
+    for(auto &page : this->pages) delete page.second;
+
+    this->blocks.clear();
+    this->pages.clear();
+    memset(this->lookup, 0, sizeof(this->lookup));
+
+    this->codeUsed = 0;
+    this->gameboy->memory->unprotectCode();
+}
+
+void Jit::invalidatePage(const char* page) {
+    auto found = this->pages.find(page);
+    if(found == this->pages.end()) return;
+
+    logger->log("Code page written, dropping its blocks");
+
+    // The blocks and their code are freed with the next flush
+    delete found->second;
+    this->pages.erase(found);
+
+    for(PageLookup &entry : this->lookup) if(entry.host == page) entry = {};
+}
+
+/*
+
+    Translation
+
+*/
+
+Jit::Block* Jit::compile(const uint16_t &pc, const char* host) {
+    Block* block = new Block({ nullptr, 0, 0 });
+    this->blocks.push_back(block);
+
+    if(!isSupported()) return block;
+
+    if(!this->code) {
+        // Never writable and executable at once, writeCode opens the pages of a block while it is copied
+        void* memory = mmap(nullptr, JIT_CODE_SIZE, PROT_READ | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(memory == MAP_FAILED) {
+            logger->error("Error: Could not allocate executable memory, the interpreter runs everything");
+            return block;
+        }
+
+        this->code = (uint8_t*) memory;
+    }
+
+    this->emitter.clear();
+    this->exits.clear();
+    this->returns.clear();
+
+    this->emitPrologue();
+
+    // Instructions up to the end of the page, a control flow instruction or one that is not translated
+    const uint8_t* bytes = (const uint8_t*) host;
+    int offset = pc & 0xFF;
+    int length = 0;
+    bool terminated = false;
+
+    this->cycleEnd = 0;
+
+    while(length < JIT_MAX_BLOCK_LENGTH) {
+        const uint8_t opcode = bytes[offset];
+        const int size = CPU::instructionLength(opcode);
+        if(offset + size > JIT_PAGE_SIZE) break;
+
+        if(classify(opcode) == Translation::None) break;
+
+        const uint16_t address = (pc & 0xFF00) + offset;
+        const uint16_t next = address + size;
+
+        this->cycleStart = this->cycleEnd;
+        this->cycleEnd += CPU::instructionCycles(opcode, opcode == 0xCB ? bytes[offset + 1] : 0);
+
+        terminated = !this->emitInstruction(bytes + offset, length, address, next);
+        offset += size;
+        length ++;
+
+        if(terminated) break;
+    }
+
+    if(length == 0) return block;
+
+    // Fall through to the next instruction
+    if(!terminated) {
+        this->emitCycles(this->cycleEnd);
+        this->emitter.movImm16(this->offsetPC, (pc & 0xFF00) + offset);
+        this->emitter.movImm32(RAX, length);
+    }
+
+    this->emitEpilogue();
+
+    // Copy to executable memory, a full buffer drops the whole cache
+    if(this->codeUsed + this->emitter.size() > JIT_CODE_SIZE) {
+        logger->log("Code buffer full, flushing ", this->blocks.size(), " blocks");
+
+        // The block being translated is the last one, it survives the flush
+        this->blocks.pop_back();
+        this->flush();
+        this->blocks.push_back(block);
+
+        // WRAM stays writable while its blocks are translated again
+        if(pc >= WRAM_FIXED_OFFSET) this->gameboy->memory->protectCode(host);
+    }
+
+    uint8_t* function = this->code + this->codeUsed;
+    if(!this->writeCode(function, this->emitter.data(), this->emitter.size())) return block;
+
+    this->codeUsed += (this->emitter.size() + 15) & ~(size_t) 15;
+
+    block->function = (BlockFunction) function;
+    block->length = length;
+    block->lastStart = this->cycleStart;
+
+    // Writes to a WRAM page holding code go through the memory handler, which drops its blocks
+    if(pc >= WRAM_FIXED_OFFSET) this->gameboy->memory->protectCode(host);
+
+    logger->log("Block at ", toHex(pc), ", ", length, " instructions, ", this->emitter.size(), " bytes");
+    return block;
+}
+
+bool Jit::writeCode(uint8_t* destination, const uint8_t* source, const size_t &size) {
+    // Host pages of the block, the other blocks on them are not run while it is copied
+    const uintptr_t pageSize = sysconf(_SC_PAGESIZE);
+    uint8_t* first = (uint8_t*) ((uintptr_t) destination & ~(pageSize - 1));
+    const size_t length = destination + size - first;
+
+    if(mprotect(first, length, PROT_READ | PROT_WRITE) != 0) {
+        logger->error("Error: Could not make the code buffer writable, the interpreter runs the block");
+        return false;
+    }
+
+    memcpy(destination, source, size);
+
+    if(mprotect(first, length, PROT_READ | PROT_EXEC) != 0) {
+        logger->error("Error: Could not make the code buffer executable, the interpreter runs the block");
+        return false;
+    }
+
+    return true;
+}
+
+/*
+
+    Registers
+
+*/
+
+Operand Jit::registerOperand(const uint8_t &index) const {
+    switch(index) {
+        case 0: return reg8(HOST_B);
+        case 1: return mem8(this->offsetC);
+        case 2: return mem8(this->offsetD);
+        case 3: return mem8(this->offsetE);
+        case 4: return reg8(HOST_H);
+        case 5: return reg8(HOST_L);
+        default: return reg8(HOST_A);
+    }
+}
+
+void Jit::emitSpill() {
+    this->emitter.mov8(mem8(this->offsetA), reg8(HOST_A));
+    this->emitter.mov8(mem8(this->offsetF), reg8(HOST_F));
+    this->emitter.mov8(mem8(this->offsetB), reg8(HOST_B));
+    this->emitter.mov8(mem8(this->offsetH), reg8(HOST_H));
+    this->emitter.mov8(mem8(this->offsetL), reg8(HOST_L));
+}
+
+void Jit::emitReload() {
+    this->emitter.mov8(reg8(HOST_A), mem8(this->offsetA));
+    this->emitter.mov8(reg8(HOST_F), mem8(this->offsetF));
+    this->emitter.mov8(reg8(HOST_B), mem8(this->offsetB));
+    this->emitter.mov8(reg8(HOST_H), mem8(this->offsetH));
+    this->emitter.mov8(reg8(HOST_L), mem8(this->offsetL));
+}
+
+void Jit::emitPrologue() {
+    // Callee saved registers, the stack stays 16 bytes aligned for the calls
+    this->emitter.push(RBX);
+    this->emitter.push(RBP);
+    this->emitter.push(R12);
+    this->emitter.push(R13);
+    this->emitter.push(R14);
+    this->emitter.push(R15);
+    this->emitter.subRsp(8);
+
+    this->emitter.mov64(RBP, RDI);
+    this->emitReload();
+}
+
+void Jit::emitEpilogue() {
+    // Block end, reached with the registers in the host registers
+    const size_t spill = this->emitter.size();
+    this->emitSpill();
+
+    // Reached with the registers in the CPU object
+    for(const size_t &label : this->returns) this->emitter.bind(label);
+
+    this->emitter.addRsp(8);
+    this->emitter.pop(R15);
+    this->emitter.pop(R14);
+    this->emitter.pop(R13);
+    this->emitter.pop(R12);
+    this->emitter.pop(RBP);
+    this->emitter.pop(RBX);
+    this->emitter.ret();
+
+    // Early exits, the instruction that wrote is complete
+    for(const Exit &exit : this->exits) {
+        this->emitter.bind(exit.label);
+
+        this->emitCycles(exit.cycles);
+        this->emitter.movImm16(this->offsetPC, exit.pc);
+        this->emitter.movImm32(RAX, exit.executed);
+        this->emitter.bind(this->emitter.jmp(), spill);
+    }
+}
+
+void Jit::emitCycles(const int32_t &cycles) {
+    if(cycles == 0) return;
+
+    // RCX is free around the calls, RAX holds the value read
+    this->emitter.movImm64(RCX, (uint64_t) this->gameboy->scheduler->getClock());
+    this->emitter.addMemImm64(RCX, cycles);
+}
+
+/*
+
+    Memory access, the page table lookup is inlined and the handlers are called for the pages without a direct array
+    The master clock is brought to the instruction for the call, handlers may read it
+
+*/
+
+void Jit::emitAddress(const uint8_t &pair) {
+    this->emitter.movzx8(RSI, this->registerOperand(pair * 2));
+    this->emitter.shl32(RSI, 8);
+    this->emitter.movzx8(RAX, this->registerOperand(pair * 2 + 1));
+    this->emitter.orReg32(RSI, RAX);
+}
+
+void Jit::emitPairStep(const uint8_t &pair, const int32_t &step) {
+    this->emitter.movzx8(RAX, this->registerOperand(pair * 2));
+    this->emitter.shl32(RAX, 8);
+    this->emitter.movzx8(RCX, this->registerOperand(pair * 2 + 1));
+    this->emitter.orReg32(RAX, RCX);
+    this->emitter.addImm32(RAX, step);
+
+    this->emitter.mov8(this->registerOperand(pair * 2 + 1), reg8(RAX));
+    this->emitter.shr32(RAX, 8);
+    this->emitter.mov8(this->registerOperand(pair * 2), reg8(RAX));
+}
+
+void Jit::emitRead() {
+    Memory* memory = this->gameboy->memory;
+
+    this->emitter.mov32(RCX, RSI);
+    this->emitter.shr32(RCX, 8);
+    this->emitter.movImm64(RAX, (uint64_t) memory->getReadPages());
+    this->emitter.loadPage(RAX, RAX, RCX);
+    this->emitter.test64(RAX);
+    const size_t slow = this->emitter.jcc(Condition::Equal);
+
+    this->emitter.movzx8(RCX, reg8(RSI));
+    this->emitter.loadByte(RAX, RAX, RCX);
+    const size_t done = this->emitter.jmp();
+
+    this->emitter.bind(slow);
+    this->emitCycles(this->cycleStart);
+    this->emitter.movImm64(RDI, (uint64_t) memory);
+    this->emitter.movImm64(RAX, (uint64_t) &readMemory);
+    this->emitter.call(RAX);
+    this->emitCycles(-this->cycleStart);
+
+    this->emitter.bind(done);
+}
+
+void Jit::emitWrite(const int &index, const uint16_t &next) {
+    Memory* memory = this->gameboy->memory;
+
+    this->emitter.mov32(RCX, RSI);
+    this->emitter.shr32(RCX, 8);
+    this->emitter.movImm64(RAX, (uint64_t) memory->getWritePages());
+    this->emitter.loadPage(RAX, RAX, RCX);
+    this->emitter.test64(RAX);
+    const size_t slow = this->emitter.jcc(Condition::Equal);
+
+    this->emitter.movzx8(RCX, reg8(RSI));
+    this->emitter.storeByte(RAX, RCX, RDX);
+    const size_t done = this->emitter.jmp();
+
+    // Handlers, IOs, bank registers and code pages may end the block
+    this->emitter.bind(slow);
+    this->emitCycles(this->cycleStart);
+    this->emitter.movImm64(RDI, (uint64_t) memory);
+    this->emitter.movImm64(RAX, (uint64_t) &writeMemory);
+    this->emitter.call(RAX);
+    this->emitCycles(-this->cycleStart);
+    this->emitExitCheck(index, next);
+
+    this->emitter.bind(done);
+}
+
+void Jit::emitExitCheck(const int &index, const uint16_t &next) {
+    this->emitter.movImm64(RAX, (uint64_t) this->gameboy->memory->getSideEffectFlag());
+    this->emitter.cmpMemImm8(RAX, 0);
+    this->exits.push_back({ this->emitter.jcc(Condition::NotEqual), index + 1, this->cycleEnd, next });
+}
+
+/*
+
+    Interpreter handlers, the registers go through the CPU object
+
+*/
+
+void Jit::emitThunk(const uint8_t &opcode, const int &index, const uint16_t &pc, const uint16_t &next, const bool &terminator) {
+    this->emitSpill();
+    this->emitter.movImm16(this->offsetPC, pc);
+    this->emitCycles(this->cycleStart);
+
+    this->emitter.mov64(RDI, RBP);
+    this->emitter.movImm64(RAX, (uint64_t) CPU::thunkTable[opcode]);
+    this->emitter.call(RAX);
+
+    // Control flow, the handler set PC and the CPU object holds the registers
+    if(terminator) {
+        this->emitCycles(this->cycleEnd - this->cycleStart);
+        this->emitter.movImm32(RAX, index + 1);
+        return this->returns.push_back(this->emitter.jmp());
+    }
+
+    this->emitCycles(-this->cycleStart);
+    this->emitReload();
+    this->emitExitCheck(index, next);
+}
+
+/*
+
+    Flags, same values as the interpreter (see cpu.cpp), the low nibble of F is kept
+
+*/
+
+void Jit::emitFlags(const uint8_t &z, const uint8_t &n, const uint8_t &h, const uint8_t &c) {
+    const uint8_t values[4] = { z, n, h, c };
+
+    uint8_t keep = 0x0F;
+    uint8_t ones = 0;
+
+    for(int i = 0; i < 4; i++) {
+        if(values[i] == FLAG_KEEP) keep |= 0x80 >> i;
+        else if(values[i] == FLAG_ONE) ones |= 0x80 >> i;
+    }
+
+    this->emitter.aluImm8(Alu::And, reg8(HOST_F), keep);
+
+    for(int i = 0; i < 4; i++) {
+        if(values[i] == FLAG_KEEP || values[i] == FLAG_ZERO || values[i] == FLAG_ONE) continue;
+
+        this->emitter.shl8(reg8(values[i]), 7 - i);
+        this->emitter.alu8(Alu::Or, reg8(HOST_F), reg8(values[i]));
+    }
+
+    if(ones) this->emitter.aluImm8(Alu::Or, reg8(HOST_F), ones);
+}
+
+void Jit::emitAlu(const uint8_t &operation) {
+    Emitter &e = this->emitter;
+    const Operand a = reg8(HOST_A);
+
+    switch(operation) {
+        case 0: // ADD, ADC, H from the low nibbles and the carry in, C is the host carry
+        case 1: {
+            const Alu alu = operation == 1 ? Alu::Adc : Alu::Add;
+
+            e.mov8(reg8(RDI), a);
+            e.aluImm8(Alu::And, reg8(RDI), 0x0F);
+            e.mov8(reg8(RSI), reg8(RCX));
+            e.aluImm8(Alu::And, reg8(RSI), 0x0F);
+            if(operation == 1) e.bt32(HOST_F, 4);
+            e.alu8(alu, reg8(RDI), reg8(RSI));
+            e.testImm8(reg8(RDI), 0x10);
+            e.setcc(Condition::NotEqual, reg8(RDI));
+
+            if(operation == 1) e.bt32(HOST_F, 4);
+            e.alu8(alu, a, reg8(RCX));
+            e.setcc(Condition::Equal, reg8(RDX));
+            e.setcc(Condition::Below, reg8(RAX));
+
+            return this->emitFlags(RDX, FLAG_ZERO, RDI, RAX);
+        }
+
+        case 2: // SUB, SBC, H is the borrow of the low nibbles, C the host borrow
+        case 3: {
+            const Alu alu = operation == 3 ? Alu::Sbb : Alu::Sub;
+
+            e.mov8(reg8(RDI), a);
+            e.aluImm8(Alu::And, reg8(RDI), 0x0F);
+            e.mov8(reg8(RSI), reg8(RCX));
+            e.aluImm8(Alu::And, reg8(RSI), 0x0F);
+            if(operation == 3) e.bt32(HOST_F, 4);
+            e.alu8(alu, reg8(RDI), reg8(RSI));
+            e.setcc(Condition::Below, reg8(RDI));
+
+            if(operation == 3) e.bt32(HOST_F, 4);
+            e.alu8(alu, a, reg8(RCX));
+            e.setcc(Condition::Equal, reg8(RDX));
+            e.setcc(Condition::Below, reg8(RAX));
+
+            return this->emitFlags(RDX, FLAG_ONE, RDI, RAX);
+        }
+
+        case 4: // AND
+            e.alu8(Alu::And, a, reg8(RCX));
+            e.setcc(Condition::Equal, reg8(RDX));
+            return this->emitFlags(RDX, FLAG_ZERO, FLAG_ONE, FLAG_ZERO);
+
+        case 5: // XOR
+        case 6: // OR
+            e.alu8(operation == 5 ? Alu::Xor : Alu::Or, a, reg8(RCX));
+            e.setcc(Condition::Equal, reg8(RDX));
+            return this->emitFlags(RDX, FLAG_ZERO, FLAG_ZERO, FLAG_ZERO);
+
+        default: { // CP, H and C are the borrows of A minus the operand
+            e.alu8(Alu::Cmp, a, reg8(RCX));
+            e.setcc(Condition::Equal, reg8(RDX));
+            e.setcc(Condition::Below, reg8(RAX));
+
+            e.mov8(reg8(RDI), a);
+            e.aluImm8(Alu::And, reg8(RDI), 0x0F);
+            e.mov8(reg8(RSI), reg8(RCX));
+            e.aluImm8(Alu::And, reg8(RSI), 0x0F);
+            e.alu8(Alu::Cmp, reg8(RDI), reg8(RSI));
+            e.setcc(Condition::Below, reg8(RDI));
+
+            return this->emitFlags(RDX, FLAG_ONE, RDI, RAX);
+        }
+    }
+}
+
+/*
+
+    Instructions
+
+*/
+
+bool Jit::emitInstruction(const uint8_t* bytes, const int &index, const uint16_t &pc, const uint16_t &next) {
+    Emitter &e = this->emitter;
+
+    const uint8_t opcode = bytes[0];
+    const uint8_t high = opcode >> 4;
+    const uint8_t low = opcode & 0xF;
+    const uint8_t source = opcode & 0x7;
+    const uint8_t destination = (opcode >> 3) & 0x7;
+
+    const Translation translation = classify(opcode);
+    if(translation != Translation::Native) {
+        this->emitThunk(opcode, index, pc, next, translation == Translation::Exit);
+        return translation != Translation::Exit;
+    }
+
+    if(opcode == 0x00) return true; // NOP
+
+    if(high <= 0x3 && low == 0x1) { // LD rr, n16
+        if(high == 0x3) e.movImm16(this->offsetSP, bytes[1] | (bytes[2] << 8));
+        else {
+            e.movImm8(this->registerOperand(high * 2), bytes[2]);
+            e.movImm8(this->registerOperand(high * 2 + 1), bytes[1]);
+        }
+    } else if(high <= 0x3 && low == 0x2) { // LD [BC], A, LD [DE], A, LD [HL+], A, LD [HL-], A
+        e.movzx8(RDX, reg8(HOST_A));
+        this->emitAddress(high <= 0x1 ? high : 2);
+        if(high >= 0x2) this->emitPairStep(2, high == 0x2 ? 1 : -1);
+
+        this->emitWrite(index, next);
+    } else if(high <= 0x3 && low == 0xA) { // LD A, [BC], LD A, [DE], LD A, [HL+], LD A, [HL-]
+        this->emitAddress(high <= 0x1 ? high : 2);
+        if(high >= 0x2) this->emitPairStep(2, high == 0x2 ? 1 : -1);
+
+        this->emitRead();
+        e.mov8(reg8(HOST_A), reg8(RAX));
+    } else if(high <= 0x3 && (low == 0x3 || low == 0xB)) { // INC rr, DEC rr, no flags
+        if(high == 0x3) {
+            if(low == 0x3) e.inc16(this->offsetSP);
+            else e.dec16(this->offsetSP);
+        } else this->emitPairStep(high, low == 0x3 ? 1 : -1);
+    } else if(high <= 0x3 && (low == 0x4 || low == 0xC)) { // INC r, H if the low nibble of the result is 0, C kept
+        const Operand r = this->registerOperand(destination);
+
+        e.inc8(r);
+        e.setcc(Condition::Equal, reg8(RDX));
+        e.testImm8(r, 0x0F);
+        e.setcc(Condition::Equal, reg8(RAX));
+
+        this->emitFlags(RDX, FLAG_ZERO, RAX, FLAG_KEEP);
+    } else if(high <= 0x3 && (low == 0x5 || low == 0xD)) { // DEC r, H if the low nibble of the result is 0xF, C kept
+        const Operand r = this->registerOperand(destination);
+
+        e.dec8(r);
+        e.setcc(Condition::Equal, reg8(RDX));
+        e.mov8(reg8(RAX), r);
+        e.aluImm8(Alu::And, reg8(RAX), 0x0F);
+        e.aluImm8(Alu::Cmp, reg8(RAX), 0x0F);
+        e.setcc(Condition::Equal, reg8(RAX));
+
+        this->emitFlags(RDX, FLAG_ONE, RAX, FLAG_KEEP);
+    } else if(high <= 0x3 && (low == 0x6 || low == 0xE)) { // LD r, n8, LD [HL], n8
+        if(destination == 6) {
+            e.movImm32(RDX, bytes[1]);
+            this->emitAddress(2);
+            this->emitWrite(index, next);
+        } else e.movImm8(this->registerOperand(destination), bytes[1]);
+    } else if(opcode == 0x2F) { // CPL
+        e.not8(reg8(HOST_A));
+        e.aluImm8(Alu::Or, reg8(HOST_F), 0x60);
+    } else if(opcode == 0x37) { // SCF
+        e.aluImm8(Alu::And, reg8(HOST_F), 0x9F);
+        e.aluImm8(Alu::Or, reg8(HOST_F), 0x10);
+    } else if(high >= 0x4 && high <= 0x7) { // LD r, r, LD r, [HL], LD [HL], r
+        if(source == 6) {
+            this->emitAddress(2);
+            this->emitRead();
+            e.mov8(this->registerOperand(destination), reg8(RAX));
+        } else if(destination == 6) {
+            e.movzx8(RDX, this->registerOperand(source));
+            this->emitAddress(2);
+            this->emitWrite(index, next);
+        } else e.mov8(this->registerOperand(destination), this->registerOperand(source));
+    } else if(high >= 0x8 && high <= 0xB) { // ALU A, r, ALU A, [HL]
+        if(source == 6) {
+            this->emitAddress(2);
+            this->emitRead();
+            e.mov8(reg8(RCX), reg8(RAX));
+        } else e.mov8(reg8(RCX), this->registerOperand(source));
+
+        this->emitAlu(destination);
+    } else if((opcode & 0xC7) == 0xC6) { // ALU A, n8
+        e.movImm8(reg8(RCX), bytes[1]);
+        this->emitAlu(destination);
+    } else if(opcode == 0xE0 || opcode == 0xE2 || opcode == 0xEA) { // LD [FF00 + n8], A, LD [FF00 + C], A, LD [n16], A
+        e.movzx8(RDX, reg8(HOST_A));
+
+        if(opcode == 0xE0) e.movImm32(RSI, 0xFF00 + bytes[1]);
+        else if(opcode == 0xEA) e.movImm32(RSI, bytes[1] | (bytes[2] << 8));
+        else {
+            e.movzx8(RSI, this->registerOperand(1));
+            e.orImm32(RSI, 0xFF00);
+        }
+
+        this->emitWrite(index, next);
+    } else { // LD A, [FF00 + n8], LD A, [FF00 + C], LD A, [n16]
+        if(opcode == 0xF0) e.movImm32(RSI, 0xFF00 + bytes[1]);
+        else if(opcode == 0xFA) e.movImm32(RSI, bytes[1] | (bytes[2] << 8));
+        else {
+            e.movzx8(RSI, this->registerOperand(1));
+            e.orImm32(RSI, 0xFF00);
+        }
+
+        this->emitRead();
+        e.mov8(reg8(HOST_A), reg8(RAX));
+    }
+
+    return true;
+}
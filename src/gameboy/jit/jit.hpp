@@ -0,0 +1,151 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include <unordered_map>
+
+using namespace std;
+
+#include "../logging/log/log.hpp"
+
+#include "../gameboy.hpp"
+#include "emitter.hpp"
+
+// Forward declaration
+class Gameboy;
+class CPU;
+
+// Executable memory of the translated blocks (read and execute, W^X), the whole cache is dropped when it is full
+#define JIT_CODE_SIZE (16 * 1024 * 1024)
+
+// Code pages, same as the memory page tables
+#define JIT_PAGE_SIZE 256
+#define JIT_PAGE_COUNT 256
+
+// Longest block, in instructions
+#define JIT_MAX_BLOCK_LENGTH 64
+
+// Translated block, returns the number of instructions it ran
+typedef int (*BlockFunction)(CPU* cpu);
+
+/*
+
+    Dynamic recompiler, translates the basic blocks of ROM and WRAM to x86-64 code
+
+    Blocks are keyed by the host address of their first instruction, a bank switch maps other host pages so no block is dropped
+    A block never crosses a 256 bytes page, WRAM pages holding blocks lose their direct store and a write drops their blocks
+    The GB registers A, F, B, H and L live in host registers inside a block, loads and ALU operations are native code,
+    other instructions call the interpreter handlers and control flow instructions end the block
+    Cycles are charged once per block from the instruction totals, the block only runs when its last instruction starts before the next event so events run after the same instruction
+
+*/
+
+class Jit {
+    public:
+        Jit(Gameboy* gameboy);
+        ~Jit();
+
+        static bool isSupported(); // x86-64 host
+
+        // Run the block at PC, or one instruction with the interpreter when there is none or it would pass the deadline
+        // Returns the number of instructions run
+        int run(const uint64_t &deadline);
+
+        void flush(); // Drop every block, the memory changed behind the cache (state load)
+        void invalidatePage(const char* page); // Translated RAM page written, its blocks are dropped
+
+        /*
+
+            Getters
+
+        */
+
+        inline const uint16_t& getLastBlock() const { return this->lastBlock; } // Start of the last block run
+        inline size_t getBlockCount() const { return this->blocks.size(); }
+        inline size_t getCodeSize() const { return this->codeUsed; }
+
+    private:
+        // Gameboy ref
+        Gameboy* gameboy;
+
+        Log* logger;
+
+        struct Block {
+            BlockFunction function; // nullptr when the first instruction can not be translated, the interpreter runs it
+            int length; // Instructions
+            int lastStart; // Cycles before the last instruction
+        };
+
+        // Blocks of a 256 bytes page of host memory, by offset in the page
+        struct CodePage {
+            Block* blocks[JIT_PAGE_SIZE];
+        };
+
+        unordered_map<const char*, CodePage*> pages;
+        vector<Block*> blocks;
+
+        // Code page last seen at each page of the address space, checked against the current mapping
+        struct PageLookup {
+            const char* host;
+            CodePage* page;
+        };
+
+        PageLookup lookup[JIT_PAGE_COUNT];
+
+        // Executable memory
+        uint8_t* code;
+        size_t codeUsed;
+
+        uint16_t lastBlock;
+
+        CodePage* getPage(const uint16_t &pc, const char* host);
+        Block* compile(const uint16_t &pc, const char* host);
+        bool writeCode(uint8_t* destination, const uint8_t* source, const size_t &size); // Copy to the code buffer, writable only during the copy
+        int interpret(); // One instruction with the interpreter
+
+        /*
+
+            Code generation
+
+        */
+
+        Emitter emitter;
+
+        // Early exits of the block being translated, taken after a write with side effects
+        struct Exit {
+            size_t label;
+            int executed; // Instructions run when leaving
+            int32_t cycles; // Cycles of those instructions
+            uint16_t pc;
+        };
+
+        vector<Exit> exits;
+        vector<size_t> returns; // Jumps to the epilogue
+
+        // Cycles of the block before and after the instruction being translated
+        int32_t cycleStart, cycleEnd;
+
+        // Register displacements in the CPU object, addressed from RBP
+        int32_t offsetA, offsetF, offsetB, offsetC, offsetD, offsetE, offsetH, offsetL;
+        int32_t offsetSP, offsetPC;
+
+        Operand registerOperand(const uint8_t &index) const; // B, C, D, E, H, L, -, A
+
+        void emitPrologue();
+        void emitEpilogue();
+        void emitSpill(); // Host registers to the CPU object
+        void emitReload(); // CPU object to the host registers
+        void emitCycles(const int32_t &cycles); // Add to the master clock
+
+        bool emitInstruction(const uint8_t* bytes, const int &index, const uint16_t &pc, const uint16_t &next); // False if the instruction ends the block
+        void emitThunk(const uint8_t &opcode, const int &index, const uint16_t &pc, const uint16_t &next, const bool &terminator);
+
+        void emitAddress(const uint8_t &pair); // Address in ESI: BC, DE, HL
+        void emitPairStep(const uint8_t &pair, const int32_t &step); // BC, DE, HL += step
+        void emitRead(); // ESI address, value in EAX
+        void emitWrite(const int &index, const uint16_t &next); // ESI address, EDX value
+        void emitExitCheck(const int &index, const uint16_t &next);
+
+        void emitAlu(const uint8_t &operation); // ALU A, CL, operation from the opcode bits
+        void emitFlags(const uint8_t &z, const uint8_t &n, const uint8_t &h, const uint8_t &c); // Host register with 0 / 1, or FLAG_*
+};
@@ -0,0 +1,171 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <stdint.h>
+
+using namespace std;
+
+#include "../utils/utils.hpp"
+#include "../logging/logger/logger.hpp"
+
+#include "joypad.hpp"
+#include "../savestate/savestate.hpp"
+
+/*
+
+    Constructors and Destructors
+
+*/
+
+Joypad::Joypad(Gameboy* gameboy) : gameboy(gameboy), buttons(0), lines(0), frame(0), script(), scriptPosition(0) {
+    logger = gameboy->getMasterLogger()->getLogger("Joypad");
+    logger->log("Joypad Constructor");
+
+    // First latch one frame after power on
+    this->gameboy->scheduler->schedule(Event::Joypad, DOTS_PER_LINE * LINES_PER_FRAME);
+}
+
+Joypad::~Joypad() {
+    logger->log("Joypad Destructor");
+
+    delete logger;
+}
+
+/*
+
+    Functions
+
+*/
+
+void Joypad::onLatchEvent(const uint64_t &timestamp) {
+    this->latch();
+
+    this->gameboy->scheduler->schedule(Event::Joypad, timestamp + DOTS_PER_LINE * LINES_PER_FRAME);
+}
+
+void Joypad::latch() {
+    // Script, the last entry reached holds
+    if(!this->script.empty()) {
+        while(this->scriptPosition < this->script.size() && this->script[this->scriptPosition].first <= this->frame) {
+            this->buttons = this->script[this->scriptPosition].second;
+            this->scriptPosition ++;
+        }
+    }
+
+    else this->buttons = this->gameboy->sink->getButtons();
+
+    this->frame ++;
+    this->update(this->gameboy->memory->getIO(JOYPAD_REGISTER));
+}
+
+uint8_t Joypad::read(const uint8_t &select) const {
+    // Bits 6 and 7 are not used and read as 1, pressed buttons read as 0
+    return 0xC0 | (select & (JOYPAD_SELECT_DIRECTIONS | JOYPAD_SELECT_ACTIONS)) | (~this->getLines(select) & 0x0F);
+}
+
+void Joypad::onSelectWrite(const uint8_t &select) {
+    this->update(select);
+}
+
+bool Joypad::loadScript(const string &path) {
+    ifstream file(path);
+    if(!file) {
+        logger->error("Error: Could not open input script ", path);
+        return false;
+    }
+
+    vector<pair<uint64_t, uint8_t>> script;
+
+    string line;
+    for(int number = 1; getline(file, line); number++) {
+        // Comment
+        const size_t comment = line.find('#');
+        if(comment != string::npos) line.erase(comment);
+
+        istringstream words(line);
+
+        uint64_t frame;
+        if(!(words >> frame)) continue;
+
+        uint8_t buttons = 0;
+        string name;
+        while(words >> name) {
+            if(name == "right") buttons |= (uint8_t) Button::Right;
+            else if(name == "left") buttons |= (uint8_t) Button::Left;
+            else if(name == "up") buttons |= (uint8_t) Button::Up;
+            else if(name == "down") buttons |= (uint8_t) Button::Down;
+            else if(name == "a") buttons |= (uint8_t) Button::A;
+            else if(name == "b") buttons |= (uint8_t) Button::B;
+            else if(name == "select") buttons |= (uint8_t) Button::Select;
+            else if(name == "start") buttons |= (uint8_t) Button::Start;
+            else if(name != "-") {
+                logger->error("Error: Unknown button ", name, " at line ", number, " of ", path);
+                return false;
+            }
+        }
+
+        if(!script.empty() && frame < script.back().first) {
+            logger->error("Error: Frame ", frame, " before the previous one at line ", number, " of ", path);
+            return false;
+        }
+
+        script.push_back({ frame, buttons });
+    }
+
+    this->script = script;
+    this->seekScript();
+
+    return true;
+}
+
+/*
+
+    Save states
+
+*/
+
+void Joypad::saveState(JoypadState &state) const {
+    state.frame = this->frame;
+    state.buttons = this->buttons;
+    state.lines = this->lines;
+}
+
+void Joypad::loadState(const JoypadState &state) {
+    this->frame = state.frame;
+    this->buttons = state.buttons;
+    this->lines = state.lines;
+
+    this->seekScript();
+}
+
+/*
+
+    Internal methods
+
+*/
+
+void Joypad::seekScript() {
+    this->scriptPosition = 0;
+
+    // Entries already passed apply at the next latch
+    while(this->scriptPosition + 1 < this->script.size() && this->script[this->scriptPosition + 1].first <= this->frame) this->scriptPosition ++;
+}
+
+uint8_t Joypad::getLines(const uint8_t &select) const {
+    uint8_t lines = 0;
+
+    // Both groups selected, their buttons are on the same lines
+    if(!(select & JOYPAD_SELECT_DIRECTIONS)) lines |= this->buttons & 0x0F;
+    if(!(select & JOYPAD_SELECT_ACTIONS)) lines |= this->buttons >> 4;
+
+    return lines;
+}
+
+void Joypad::update(const uint8_t &select) {
+    const uint8_t lines = this->getLines(select);
+
+    // High to low
+    if(lines & ~this->lines) this->gameboy->cpu->triggerInterrupt(Interrupt::Joypad);
+
+    this->lines = lines;
+}
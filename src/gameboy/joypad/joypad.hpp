@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#include "../logging/log/log.hpp"
+
+#include "../gameboy.hpp"
+
+// Forward declaration
+class Gameboy;
+struct JoypadState;
+
+// Joypad register select bits, a group is selected when its bit is 0
+#define JOYPAD_SELECT_DIRECTIONS 0x10
+#define JOYPAD_SELECT_ACTIONS 0x20
+
+/*
+
+    Joypad, the buttons are latched once per frame by a scheduled event instead of being asked to the frontend on each read
+    FF00 is computed from the select bits and the latched buttons, a line that falls (a button pressed in a selected group,
+    or a group selected with a button held) requests the Joypad interrupt
+
+    The buttons come from the sink, or from an input script: each line is a frame and the buttons held from it,
+    "120 start", "130 a right", "140 -" (all released), # starts a comment, frames count the latches since power on
+
+*/
+
+class Joypad {
+    public:
+        Joypad(Gameboy* gameboy);
+        ~Joypad();
+
+        // Scheduled event, once per frame
+        void onLatchEvent(const uint64_t &timestamp);
+
+        // Read the input now, the event does it every frame
+        void latch();
+
+        // FF00 from the select bits written by the game
+        uint8_t read(const uint8_t &select) const;
+
+        // The select bits changed, a newly selected group can make a line fall
+        void onSelectWrite(const uint8_t &select);
+
+        // Input script instead of the sink, false if the file cannot be read or has an unknown button
+        bool loadScript(const string &path);
+
+        // Save states, the script is not saved, its position follows the restored frame
+        void saveState(JoypadState &state) const;
+        void loadState(const JoypadState &state);
+
+        /*
+
+            Getters
+
+        */
+
+        inline uint8_t getButtons() const { return this->buttons; } // Latched, see Button
+        inline uint64_t getFrame() const { return this->frame; }
+
+    private:
+        Gameboy* gameboy;
+
+        Log* logger;
+
+        uint8_t buttons;
+        uint8_t lines; // Lines P10 - P13 low (bit set) as of the last update, for the falling edges
+        uint64_t frame; // Latches since power on
+
+        // Script, frame and buttons held from it, in frame order
+        vector<pair<uint64_t, uint8_t>> script;
+        size_t scriptPosition;
+
+        void seekScript(); // Script position of the current frame, the last entry reached applies at the next latch
+        uint8_t getLines(const uint8_t &select) const; // Pressed buttons of the selected groups
+        void update(const uint8_t &select); // Request the interrupt on a falling line
+};
@@ -10,7 +10,7 @@ using namespace std;
 
 */
 
-Log::Log(const string &domain) : domain(domain), logger(Logger::getInstance()) {
+Log::Log(Logger* logger, const string &domain) : domain(domain), logger(logger) {
     logger->log(LOG_LOG, domain, "Log Constructor");
 }
 
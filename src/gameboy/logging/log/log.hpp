@@ -1,9 +1,13 @@
 #pragma once
 
 #include <string>
+#include <sstream>
+#include <type_traits>
 
 using namespace std;
 
+#include "../../../constants/constants.hpp"
+
 #include "../logger/logger.hpp"
 
 class Log {
@@ -14,25 +18,47 @@ class Log {
         // Reference to the Logger class
         Logger* logger;
 
+        // Format the message only if the level and domain are enabled, the word filter is checked on the formatted message
+        template<typename... Args>
+        inline void write(const char &level, const Args&... args) {
+            if constexpr(ENABLE_LOGGING) {
+                if(!this->logger->isEnabled(level, this->domain)) return;
+
+                ostringstream stream;
+                (Log::format(stream, args), ...);
+
+                this->logger->log(level, this->domain, stream.str());
+            }
+        }
+
+        // Callables are evaluated when formatting, for messages that are expensive to build
+        template<typename T>
+        static inline void format(ostringstream &stream, const T &arg) {
+            if constexpr(is_invocable_v<const T&>) stream << arg();
+            else stream << arg;
+        }
+
     public:
         // Constructor
-        Log(const string &domain);
+        Log(Logger* logger, const string &domain);
 
         // Destructor
         ~Log();
 
-        // Functions
-        inline void log(const string &message) { this->logger->log(LOG_LOG, domain, message); }
-        inline void error(const string &message) { this->logger->log(LOG_ERROR, domain, message); }
-        inline void warning(const string &message) { this->logger->log(LOG_WARNING, domain, message); }
+        // Functions, the arguments are streamed one after the other (use toHex for hexadecimal values)
+        template<typename... Args> inline void log(const Args&... args) { this->write(LOG_LOG, args...); }
+        template<typename... Args> inline void error(const Args&... args) { this->write(LOG_ERROR, args...); }
+        template<typename... Args> inline void warning(const Args&... args) { this->write(LOG_WARNING, args...); }
 
         // Operator overloads for normal
-        inline Log& operator << (const string &message) {
+        template<typename T>
+        inline Log& operator << (const T &message) {
             this->log(message);
             return *this;
         }
 
-        inline Log& operator >> (const string &message) {
+        template<typename T>
+        inline Log& operator >> (const T &message) {
             this->error(message);
             return *this;
         }
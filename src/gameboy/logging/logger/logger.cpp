@@ -8,19 +8,6 @@ using namespace std;
 
 #include "logger.hpp"
 
-/*
-
-    Get instance
-
-*/
-
-Logger* Logger::getInstance() {
-    if(!instance) instance = new Logger();
-    return instance;
-}
-
-Logger* Logger::instance = nullptr;
-
 /*
 
     Constructors and Destructors
@@ -32,9 +19,11 @@ Logger::Logger() {
 }
 
 Logger::~Logger() {
-    instance = nullptr;
+    
 }
 
+mutex Logger::outputMutex;
+
 /*
 
     Functions
@@ -42,18 +31,15 @@ Logger::~Logger() {
 */
 
 Log* Logger::getLogger(const string &domain) {
-    return new Log(domain);
+    return new Log(this, domain);
 }
 
 void Logger::log(const char &level, const string &domain, const string &message) {
     // Check if logging is enabled
     if(!ENABLE_LOGGING) return;
     else {
-        // Check if level is enabled
-        if(find(enabledLevels.begin(), enabledLevels.end(), level) == enabledLevels.end()) return;
-
-        // Check if domain is enabled
-        if(find(enabledDomains.begin(), enabledDomains.end(), domain) == enabledDomains.end()) return;
+        // Check if level and domain are enabled
+        if(!this->isEnabled(level, domain)) return;
 
         // Check if message contains any word from the word filter
         for(const auto &word : wordFilter) {
@@ -61,12 +47,24 @@ void Logger::log(const char &level, const string &domain, const string &message)
         }
 
         // Log, if domain is error then print in red
+        const lock_guard<mutex> lock(Logger::outputMutex);
+
         if(level == LOG_ERROR) cout << "\033[1;31mError: " << domain << ": " << message << "\033[0m" << endl;
         else if(level == LOG_WARNING) cout << "\033[1;33mWarning: " << domain << ": " << message << "\033[0m" << endl;
         else cout << "[" + domain + "] " << message << endl;
     }
 }
 
+bool Logger::isEnabled(const char &level, const string &domain) const {
+    if(!ENABLE_LOGGING) return false;
+
+    // Check if level is enabled
+    if(find(enabledLevels.begin(), enabledLevels.end(), level) == enabledLevels.end()) return false;
+
+    // Check if domain is enabled
+    return find(enabledDomains.begin(), enabledDomains.end(), domain) != enabledDomains.end();
+}
+
 void Logger::setConfig(const vector<char> &enabledLevels, const vector<string> &enabledDomains, const vector<string> &wordFilter) {
     this->enabledLevels = enabledLevels;
     this->enabledDomains = enabledDomains;
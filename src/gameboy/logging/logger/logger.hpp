@@ -2,6 +2,7 @@
 
 #include <string>
 #include <vector>
+#include <mutex>
 
 using namespace std;
 
@@ -13,10 +14,8 @@ class Log;
 
 class Logger {
     public:
-        // Get instance
-        static Logger* getInstance();
-
-        // Destructor
+        // Constructors, a logger context holds the configuration shared by the logs created from it
+        Logger();
         ~Logger();
 
         // Functions
@@ -24,15 +23,12 @@ class Logger {
 
         void log(const char &level, const string &domain, const string &message);
 
+        // Level and domain check, done before formatting a message
+        bool isEnabled(const char &level, const string &domain) const;
+
         void setConfig(const vector<char> &enabledLevels, const vector<string> &enabledDomains, const vector<string> &wordFilter);
 
     private:
-        // Instance
-        static Logger* instance;
-
-        // Constructors
-        Logger();
-
         // Vars
         bool enableLogging = false;
 
@@ -40,6 +36,9 @@ class Logger {
         vector<string> enabledDomains;
         vector<string> wordFilter;
 
+        // Output is shared by the machines running on other threads
+        static mutex outputMutex;
+
     protected:
 
 };
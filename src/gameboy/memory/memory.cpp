@@ -1,6 +1,7 @@
 #include <iostream>
 #include <string>
 #include <fstream>
+#include <cstring>
 #include <filesystem>
 #include <stdint.h>
 
@@ -11,6 +12,20 @@ using namespace std;
 #include "../utils/utils.hpp"
 
 #include "memory.hpp"
+#include "../savestate/savestate.hpp"
+
+// Bits of the IO registers that read as 1 on the DMG, unused and CGB-only registers read 0xFF
+// Joypad, timer and sound registers are masked by their components
+static const uint8_t readMasks[IO_SIZE] = {
+    0x00, 0x00, 0x7E, 0xFF, 0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xE0, // FF00 - FF0F
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // FF10 - FF1F
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // FF20 - FF2F
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // FF30 - FF3F
+    0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF, // FF40 - FF4F
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, // FF50 - FF5F
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, // FF60 - FF6F
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF  // FF70 - FF7F
+};
 
 /*
 
@@ -18,19 +33,132 @@ using namespace std;
 
 */
 
-Memory::Memory(Gameboy* gameboy) : gameboy(gameboy), bootrom(), romFixed(), romBanked(), vram(), extram(), wramFixed(), wramBanked(), oam(), noRam(), io(), hram(), interruptEnable(0) {
-    logger = Logger::getInstance()->getLogger("Memory");
+Memory::Memory(Gameboy* gameboy) : gameboy(gameboy), bootrom(), romFixed(nullptr), romBanked(nullptr), extram(nullptr), vram(), wramFixed(), wramBanked(), oam(), io(), hram(), interruptEnable(0), readPages(), writePages(), writeHandlers(), codeStores(), hramCode(false), sideEffect(false), dmaActive(false), dmaSource(0) {
+    logger = gameboy->getMasterLogger()->getLogger("Memory");
     logger->log("Memory Constructor");
 
+    this->buildPageTable();
     this->preloadValues();
 }
 
+void Memory::buildPageTable() {
+    // Fixed and banked ROM are mapped by the cartridge, writes go to the bank registers
+    this->mapHandler(ROM_FIXED_OFFSET, ROM_FIXED_SIZE + ROM_BANKED_SIZE, &Memory::writeRom);
+
+    // VRAM, writes go through a handler
+    this->mapPages(VRAM_OFFSET, VRAM_SIZE, this->vram, nullptr);
+    this->mapHandler(VRAM_OFFSET, VRAM_SIZE, &Memory::writeVram);
+
+    // EXTRAM is mapped by the cartridge when enabled
+    this->mapHandler(EXTRAM_OFFSET, EXTRAM_SIZE, &Memory::writeExtram);
+
+    // WRAM, direct store
+    this->mapPages(WRAM_FIXED_OFFSET, WRAM_FIXED_SIZE, this->wramFixed, this->wramFixed);
+    this->mapPages(WRAM_BANKED_OFFSET, WRAM_BANKED_SIZE, this->wramBanked, this->wramBanked);
+
+    // Echo RAM mirrors WRAM, map it to the same arrays so it costs nothing
+    this->mapPages(ECHO_RAM_OFFSET, WRAM_FIXED_SIZE, this->wramFixed, this->wramFixed);
+    this->mapPages(ECHO_RAM_OFFSET + WRAM_FIXED_SIZE, ECHO_RAM_SIZE - WRAM_FIXED_SIZE, this->wramBanked, this->wramBanked);
+
+    // OAM, unusable memory, IOs, HRAM and IE are left unmapped (0xFE00 - 0xFFFF)
+    this->mapHandler(OAM_OFFSET, PAGE_SIZE * 2, &Memory::writeHigh);
+}
+
+void Memory::mapPages(const uint16_t &offset, const int &size, const char* block, char* writableBlock) {
+    for(int i = 0; i < size / PAGE_SIZE; i++) {
+        this->readPages[(offset >> 8) + i] = block ? block + i * PAGE_SIZE : nullptr;
+        this->writePages[(offset >> 8) + i] = writableBlock ? writableBlock + i * PAGE_SIZE : nullptr;
+    }
+
+    // The pre-decoded instructions of these pages come from other memory now
+    this->gameboy->cpu->unmapDecoded(offset >> 8, size / PAGE_SIZE);
+}
+
+void Memory::mapHandler(const uint16_t &offset, const int &size, const WriteHandler &handler) {
+    for(int i = 0; i < size / PAGE_SIZE; i++) this->writeHandlers[(offset >> 8) + i] = handler;
+}
+
 void Memory::preloadValues() {
 
 }
 
 Memory::~Memory() {
     logger->log("Memory Destructor");
+
+    delete logger;
+}
+
+/*
+
+    Cartridge mapping
+
+*/
+
+void Memory::mapRom(const char* fixedBank, const char* switchableBank) {
+    if(fixedBank != this->romFixed) {
+        this->romFixed = fixedBank;
+        this->mapPages(ROM_FIXED_OFFSET, ROM_FIXED_SIZE, fixedBank, nullptr);
+
+        // The first page stays unmapped while the boot ROM overlays it
+        if(ENABLE_BOOT_ROM && this->io[BOOTROM_DISABLE - IO_OFFSET] == 0) this->readPages[BOOTROM_OFFSET >> 8] = nullptr;
+    }
+
+    if(switchableBank != this->romBanked) {
+        this->romBanked = switchableBank;
+        this->mapPages(ROM_BANKED_OFFSET, ROM_BANKED_SIZE, switchableBank, nullptr);
+    }
+}
+
+void Memory::mapExtram(char* bank) {
+    if(bank == this->extram) return;
+
+    this->extram = bank;
+    this->mapPages(EXTRAM_OFFSET, EXTRAM_SIZE, bank, bank);
+}
+
+/*
+
+    Code pages
+
+*/
+
+const char* Memory::getUnmappedCodePage(const uint16_t &address) const {
+    // The boot ROM overlay leaves the first page unmapped
+    if(address < BOOTROM_SIZE && ENABLE_BOOT_ROM && this->io[BOOTROM_DISABLE - IO_OFFSET] == 0) return this->bootrom;
+
+    // IE is not part of the page
+    if(address >= HRAM_OFFSET && address < HRAM_OFFSET + HRAM_SIZE) return this->hram;
+
+    return nullptr;
+}
+
+void Memory::protectCode(const char* page) {
+    // HRAM is written through its handler
+    if(page == this->hram) {
+        this->hramCode = true;
+        return;
+    }
+
+    // Echo RAM maps the same page twice
+    for(int i = 0; i < PAGE_COUNT; i++) {
+        if(this->readPages[i] != page || !this->writePages[i]) continue;
+
+        this->codeStores[i] = this->writePages[i];
+        this->writePages[i] = nullptr;
+        this->writeHandlers[i] = &Memory::writeCode;
+    }
+}
+
+void Memory::unprotectCode() {
+    this->hramCode = false;
+
+    for(int i = 0; i < PAGE_COUNT; i++) {
+        if(!this->codeStores[i]) continue;
+
+        this->writePages[i] = this->codeStores[i];
+        this->writeHandlers[i] = nullptr;
+        this->codeStores[i] = nullptr;
+    }
 }
 
 /*
@@ -45,25 +173,23 @@ void Memory::loadRom(const int &memoryBlock, const string &romPath, const int re
 
     // Check if the file was opened successfully
     if(!romFile.is_open()) {
-        logger->error("Error: Could not open ROM file : " + romPath); 
+        logger->error("Error: Could not open ROM file : ", romPath); 
         exit(1);
-    } else logger->log("ROM at path " + romPath + " opened successfully");
+    } else logger->log("ROM at path ", romPath, " opened successfully");
 
     // Determine size
     auto fileSize = std::filesystem::file_size(romPath);
 
     // Log
-    logger->log("Loading ROM at address " + to_string(readOffset) + " with size " + to_string(fileSize));
+    logger->log("Loading ROM at address ", (int) readOffset, " with size ", (int) fileSize);
 
     // Move file cursor to the read offset
     romFile.seekg(readOffset);
 
-    // Read ROM file
+    // Read ROM file, game ROMs are loaded by the cartridge
     if(memoryBlock == BOOTROM) romFile.read(this->bootrom, memorySize);
-    else if(memoryBlock == ROM_FIXED) romFile.read(this->romFixed, memorySize);
-    else if(memoryBlock == ROM_BANKED) romFile.read(this->romBanked, memorySize);
     else {
-        logger->error("Error: Invalid memory block, loading ROM at address " + to_string(memoryBlock));
+        logger->error("Error: Invalid memory block, loading ROM at address ", (int) memoryBlock);
         exit(1);
     }
 
@@ -73,209 +199,338 @@ void Memory::loadRom(const int &memoryBlock, const string &romPath, const int re
     logger->log("ROM loaded successfully");
 }
 
-void Memory::cycle() {
-    // Check if DMA source adress register has changed
-    if(this->io[0xFF46 - IO_OFFSET] != this->dmaLastValue) {
-        // Get the source address
-        const uint16_t sourceAddress = ((uint16_t) this->io[0xFF46 - IO_OFFSET]) << 8;
+/*
 
-        // Printf that DMA is starting
-        printf("DMA transfer started from address %04X\n", sourceAddress);
+    OAM DMA
 
-        // Copy the data from the source to the destination
-        for(int i = 0; i < 0xA0; i++) {
-            this->oam[i] = this->fetch8(sourceAddress + i);
-        }
+*/
 
-        // Set the last value to the current value
-        this->dmaLastValue = this->io[0xFF46 - IO_OFFSET];
-    }
+void Memory::startDma(const uint8_t &source) {
+    // Sources from 0xE000 read WRAM, a new transfer restarts the current one
+    this->dmaSource = source >= (ECHO_RAM_OFFSET >> 8) ? source - ((ECHO_RAM_OFFSET - WRAM_FIXED_OFFSET) >> 8) : source;
+    this->dmaActive = true;
+
+    logger->log("DMA transfer started from address ", toHex((uint16_t) (this->dmaSource << 8)));
+
+    Scheduler* scheduler = this->gameboy->scheduler;
+    scheduler->schedule(Event::DMA, scheduler->getCycles() + DMA_CYCLES);
 }
 
-char& Memory::fetch8(const uint16_t &address) {
-    // Check if the address is in the boot ROM
-    if(ENABLE_BOOT_ROM && address < BOOTROM_OFFSET + BOOTROM_SIZE) {
-        // Read at address 0xFF50 to check if the boot ROM is disabled
-        const char& bootRomEnabled = this->fetch8(0xFF50);
-        if(bootRomEnabled == 0) return this->bootrom[address];
+void Memory::onDmaEvent(const uint64_t &timestamp) {
+    logger->log("DMA transfer done at ", timestamp);
+
+    this->dmaActive = false;
+
+    // The CPU could not write the source during the transfer, it is copied at once
+    const char* page = this->readPages[this->dmaSource];
+    if(page) memcpy(this->oam, page, OAM_SIZE);
+    else {
+        // Boot ROM overlay or external RAM behind the cartridge
+        for(int i = 0; i < OAM_SIZE; i++) this->oam[i] = this->read8((this->dmaSource << 8) + i);
     }
+}
 
-    // Check if the address is in the fixed ROM
-    if(address < ROM_FIXED_OFFSET + ROM_FIXED_SIZE) return this->romFixed[address - ROM_FIXED_OFFSET];
+/*
 
-    // Check if the address is in the banked ROM
-    else if(address >= ROM_BANKED_OFFSET && address < ROM_BANKED_OFFSET + ROM_BANKED_SIZE) return this->romBanked[address - ROM_BANKED_OFFSET];
+    Serial port
 
-    // Check if the address is in the VRAM
-    else if(address >= VRAM_OFFSET && address < VRAM_OFFSET + VRAM_SIZE) return this->vram[address - VRAM_OFFSET];
+*/
 
-    // Check if the address is in the EXTRAM
-    else if(address >= EXTRAM_OFFSET && address < EXTRAM_OFFSET + EXTRAM_SIZE) return this->extram[address - EXTRAM_OFFSET];
+void Memory::onSerialEvent(const uint64_t &timestamp) {
+    const uint8_t data = this->io[SERIAL_DATA - IO_OFFSET];
+    logger->log("Serial byte ", toHex(data), " sent at ", timestamp);
 
-    // Check if the address is in the fixed WRAM
-    else if(address >= WRAM_FIXED_OFFSET && address < WRAM_FIXED_OFFSET + WRAM_FIXED_SIZE) return this->wramFixed[address - WRAM_FIXED_OFFSET];
+    this->gameboy->sink->serial(data);
 
-    // Check if the address is in the banked WRAM
-    else if(address >= WRAM_BANKED_OFFSET && address < WRAM_BANKED_OFFSET + WRAM_BANKED_SIZE) return this->wramBanked[address - WRAM_BANKED_OFFSET];
+    // Nothing is connected, the line reads 1s
+    this->io[SERIAL_DATA - IO_OFFSET] = (char) 0xFF;
+    this->io[SERIAL_CONTROL - IO_OFFSET] &= 0x7F;
 
-    else if(address >= ECHO_RAM_OFFSET && address < ECHO_RAM_OFFSET + ECHO_RAM_SIZE) return this->fetch8(address - ECHO_RAM_OFFSET + WRAM_FIXED_OFFSET);
+    this->gameboy->cpu->triggerInterrupt(Interrupt::Serial);
+}
 
-    // Check if the address is in the OAM
-    else if(address >= OAM_OFFSET && address < OAM_OFFSET + OAM_SIZE) return this->oam[address - OAM_OFFSET];
+bool Memory::isDmaConflict(const uint16_t &address) const {
+    if(address >= IO_OFFSET) return false;
+    if(address >= OAM_OFFSET) return true;
 
-    // Check if the address is in the IO
-    else if(address >= IO_OFFSET && address < IO_OFFSET + IO_SIZE) return this->fetchIOs(address);
+    // VRAM is on its own bus, the ROM, external RAM and WRAM share the other one
+    const bool videoSource = this->dmaSource >= (VRAM_OFFSET >> 8) && this->dmaSource < (EXTRAM_OFFSET >> 8);
+    const bool videoAddress = address >= VRAM_OFFSET && address < EXTRAM_OFFSET;
 
-    else if(address >= NO_RAM_OFFSET && address < NO_RAM_OFFSET + NO_RAM_SIZE) {
-        // Log warning if reading unusable memory
-        logger->warning("Warning: Reading unusable memory at address " + intToHex(address));
+    return videoSource == videoAddress;
+}
 
-        // Write 0xF to the address
-        this->noRam[address - NO_RAM_OFFSET] = (char) 0xFF;
+/*
 
-        // Return ref to adress, match expected behavior of this unmapped memory section
-        return this->noRam[address - NO_RAM_OFFSET];
-    }
+    Read functions
+
+*/
+
+uint8_t Memory::readUnmapped(const uint16_t &address) {
+    // Check if the address is in the boot ROM, the page is only unmapped until the boot ROM is disabled
+    if(address < BOOTROM_OFFSET + BOOTROM_SIZE) return this->bootrom[address];
+
+    // Check if the address is in the external RAM, disabled or replaced by the cartridge registers
+    if(address >= EXTRAM_OFFSET && address < EXTRAM_OFFSET + EXTRAM_SIZE) return this->gameboy->cartridge->readRam(address);
+
+    // Check if the address is in the IO
+    if(address >= IO_OFFSET && address < IO_OFFSET + IO_SIZE) return this->readIO(address);
 
     // Check if the address is in the HRAM
     else if(address >= HRAM_OFFSET && address < HRAM_OFFSET + HRAM_SIZE) return this->hram[address - HRAM_OFFSET];
 
-    // Log warning if reading interrupts infos
-    if(address == 0xFFFF) {
-        //logger->warning("Warning: Reading interrupts infos at address " + intToHex(address));
-        return this->interruptEnable;
+    // Check if the address is in the OAM
+    else if(address >= OAM_OFFSET && address < OAM_OFFSET + OAM_SIZE) return this->oam[address - OAM_OFFSET];
+
+    else if(address >= NO_RAM_OFFSET && address < NO_RAM_OFFSET + NO_RAM_SIZE) {
+        // Log warning if reading unusable memory
+        logger->warning("Warning: Reading unusable memory at address ", toHex(address));
+
+        // Match expected behavior of this unmapped memory section
+        return 0xFF;
     }
 
+    // Interrupt enable register
+    if(address == INTERRUPT_ENABLE) return this->interruptEnable;
+
     // Out of bounds
     else {
         // If the address is not in any of the memory blocks, throw an error
-        logger->error("Error: Invalid memory address, reading at address " + intToHex(address));
+        logger->error("Error: Invalid memory address, reading at address ", toHex(address));
         exit(123);
     }
 }
 
-char& Memory::fetchIOs(const uint16_t &address) {
-    // Log reading joypad
-    if(address == 0xFF00) {
-        logger->log("Warning: Reading joypad at address " + intToHex(address));
-
-        // Reset registrer to FF
-        // this->io[0xFF00 - IO_OFFSET] = (char) 0xFF;
-
-        // Key mapping:
-        // up -> up arrow on qwerty
-        // down -> down arrow on qwerty
-        // left -> left arrow on qwerty
-        // right -> right arrow on qwerty
-
-        // a -> z on qwerty
-        // b -> x on qwerty
-        // start -> enter on qwerty
-        // select -> s on qwerty
-
-        // Check if bits 4 and 5 are set
-        if((this->io[0xFF00 - IO_OFFSET] & 0x30) == 0x30) {
-            // Set bits 0-3 to 1
-            this->io[0xFF00 - IO_OFFSET] |= 0x0F;
-        } else {
-            const Uint8* keyStates = this->gameboy->renderer->getKeyStates();
-
-            // If select buttons enable
-            if((this->io[0xFF00 - IO_OFFSET] & 0x20) == 0) {
-                // Set bits 0-3 to 1
-                this->io[0xFF00 - IO_OFFSET] |= 0x0F;
-
-                // Fill the register with the key states
-                if(keyStates[SDL_SCANCODE_RETURN]) this->io[0xFF00 - IO_OFFSET] &= ~0x08; // Start
-                if(keyStates[SDL_SCANCODE_S]) this->io[0xFF00 - IO_OFFSET] &= ~0x04; // Select
-                if(keyStates[SDL_SCANCODE_X]) this->io[0xFF00 - IO_OFFSET] &= ~0x02; // B
-                if(keyStates[SDL_SCANCODE_Z]) this->io[0xFF00 - IO_OFFSET] &= ~0x01; // A
-            } else {
-                // Set bits 0-3 to 1
-                this->io[0xFF00 - IO_OFFSET] |= 0x0F;
-
-                // Fill the register with the key states
-                if(keyStates[SDL_SCANCODE_UP]) this->io[0xFF00 - IO_OFFSET] &= ~0x08; // Up
-                if(keyStates[SDL_SCANCODE_DOWN]) this->io[0xFF00 - IO_OFFSET] &= ~0x04; // Down
-                if(keyStates[SDL_SCANCODE_LEFT]) this->io[0xFF00 - IO_OFFSET] &= ~0x02; // Left
-                if(keyStates[SDL_SCANCODE_RIGHT]) this->io[0xFF00 - IO_OFFSET] &= ~0x01; // Right
-            }
-        }
-    }
+uint8_t Memory::readIO(const uint16_t &address) {
+    // Joypad, from the select bits and the buttons latched this frame
+    if(address == JOYPAD_REGISTER) return this->gameboy->joypad->read(this->io[JOYPAD_REGISTER - IO_OFFSET]);
 
-    // just logging timer reg access and freq values
+    // Timer registers, DIV and TIMA are computed from the master clock
     else if(address - IO_OFFSET == DIVIDER_REGISTER) {
-        logger->log("Reading divider register at addr " + intToHex(address));
-        // logger->log("Divider Register Value: " + to_string(timer->getDividerRegister()));
-
-        // TODO return ref to memory adress
-        // Note: timer class should not hold the values of it's registers but rather read the memory adress asign to it each time it needs to use it.
+        logger->log("Reading divider register at addr ", toHex(address));
+        return this->gameboy->timer->getDividerRegister();
     }
 
     else if(address - IO_OFFSET == TIMER_COUNTER) {
-        logger->log("Reading timer counter at addr " + intToHex(address));
-        // logger->log("Timer Counter Value: " + to_string(timer->getTimerCounter()));
-
-        // TODO return ref to memory adress
+        logger->log("Reading timer counter at addr ", toHex(address));
+        return this->gameboy->timer->getTimerCounter();
     }
 
     else if(address - IO_OFFSET == TIMER_MODULO) {
-        logger->log("Reading timer modulo at addr " + intToHex(address));
-        // logger->log("Timer Modulo Value: " + to_string(timer->getTimerModulo()));
-
-        // TODO return ref to memory adress
+        logger->log("Reading timer modulo at addr ", toHex(address));
+        return this->gameboy->timer->getTimerModulo();
     }
 
     else if(address - IO_OFFSET == TIMER_CONTROL) {
-        logger->log("Reading timer control at addr " + intToHex(address));
-        // logger->log("Timer Control Value: " + to_string(timer->getTimerControl()));
-
-        // TODO return ref to memory adress
+        logger->log("Reading timer control at addr ", toHex(address));
+        return this->gameboy->timer->getTimerControl();
     }
 
     // Log reading serial
-    else if(address == 0xFF01 || address == 0xFF02) logger->log("Warning: Reading serial at address " + intToHex(address));
-
-    // Log reading timer
-    else if(address >= 0xFF04 && address <= 0xFF07) {
-        logger->log("Warning: Reading timer at address " + intToHex(address));
-        // this->gameboy->stop();
-    }
+    else if(address == 0xFF01 || address == 0xFF02) logger->log("Warning: Reading serial at address ", toHex(address));
 
     // Log warning if reading interrupts infos
-    //else if(address == 0xFF0F) logger->warning("Warning: Reading interrupts infos at address " + intToHex(address));
+    //else if(address == 0xFF0F) logger->warning("Warning: Reading interrupts infos at address ", toHex(address));
 
-    // Log reading sound
-    else if(address >= 0xFF10 && address <= 0xFF3F) logger->log("Warning: Reading sound at address " + intToHex(address));
+    // Sound registers and wave RAM
+    else if(address >= SOUND_OFFSET && address < SOUND_OFFSET + SOUND_REGISTERS) return this->gameboy->apu->read(address);
 
     // Log if reading LCD status
-    else if(address >= 0xFF40 && address <= 0xFF4B) logger->log("Warning: Reading LCD status at address " + intToHex(address));
-
-    // If reading DMA transfer
-    else if(address == 0xFF46) {
-        logger->log("Warning: Reading DMA transfer at address " + intToHex(address));
-
-        // Save the DMA current value
-        this->dmaLastValue = this->io[0xFF46 - IO_OFFSET];
-    }
+    else if(address >= 0xFF40 && address <= 0xFF4B) logger->log("Warning: Reading LCD status at address ", toHex(address));
 
     // Log if reading to select VRAM bank
-    else if(address == 0xFF4F) logger->log("Warning: Writing to select VRAM bank at address " + intToHex(address));
+    else if(address == 0xFF4F) logger->log("Warning: Writing to select VRAM bank at address ", toHex(address));
 
     // Log if reading to boot ROM enable
-    else if(address == 0xFF50) logger->log("Warning: Writing to boot ROM enable at address " + intToHex(address));
+    else if(address == 0xFF50) logger->log("Warning: Writing to boot ROM enable at address ", toHex(address));
 
     // Log if reading to VRAM DMA
-    else if(address >= 0xFF51 && address <= 0xFF55) logger->log("Warning: Writing to VRAM DMA at address " + intToHex(address));
+    else if(address >= 0xFF51 && address <= 0xFF55) logger->log("Warning: Writing to VRAM DMA at address ", toHex(address));
 
     // Log if reading to BG / OBJ palette
-    else if(address >= 0xFF68 && address <= 0xFF6B) logger->log("Warning: Writing to BG / OBJ palette at address " + intToHex(address));    
+    else if(address >= 0xFF68 && address <= 0xFF6B) logger->log("Warning: Writing to BG / OBJ palette at address ", toHex(address));    
 
     // Log if reading to WRAM bank select
-    else if(address == 0xFF70) logger->log("Warning: Writing to WRAM bank select at address " + intToHex(address));
+    else if(address == 0xFF70) logger->log("Warning: Writing to WRAM bank select at address ", toHex(address));
     
     // Log warning if accessing other IOs
-    // else logger->warning("Warning: Accessing IO at address " + intToHex(address));
+    // else logger->warning("Warning: Accessing IO at address ", toHex(address));
+
+    return this->io[address - IO_OFFSET] | readMasks[address - IO_OFFSET];
+}
+
+/*
+
+    Write handlers
+
+*/
+
+void Memory::writeRom(const uint16_t &address, const uint8_t &value) {
+    // ROM is read only, writes target the cartridge bank registers
+    logger->log("Writing to ROM bank register at address ", toHex(address), " with value ", toHex(value));
+    this->gameboy->cartridge->writeRegister(address, value);
+
+    this->sideEffect = true;
+}
+
+void Memory::writeExtram(const uint16_t &address, const uint8_t &value) {
+    this->gameboy->cartridge->writeRam(address, value);
+}
+
+void Memory::writeVram(const uint16_t &address, const uint8_t &value) {
+    this->vram[address - VRAM_OFFSET] = value;
+
+    // Tile data changed, the PPU decodes the tile again on its next use
+    if(address < TILE_DATA_END) this->gameboy->ppu->invalidateTile(address);
+}
+
+void Memory::writeHigh(const uint16_t &address, const uint8_t &value) {
+    // Check if the address is in the IO
+    if(address >= IO_OFFSET && address < IO_OFFSET + IO_SIZE) this->writeIO(address, value);
+
+    // Check if the address is in the HRAM
+    else if(address >= HRAM_OFFSET && address < HRAM_OFFSET + HRAM_SIZE) {
+        this->hram[address - HRAM_OFFSET] = value;
+        if(this->hramCode) this->codeWritten(this->hram);
+    }
+
+    // Check if the address is in the OAM
+    else if(address >= OAM_OFFSET && address < OAM_OFFSET + OAM_SIZE) this->oam[address - OAM_OFFSET] = value;
+
+    // Writes to unusable memory are ignored
+    else if(address >= NO_RAM_OFFSET && address < NO_RAM_OFFSET + NO_RAM_SIZE) logger->warning("Warning: Writing unusable memory at address ", toHex(address));
+
+    // Interrupt enable register
+    else if(address == INTERRUPT_ENABLE) {
+        this->interruptEnable = value;
+        this->sideEffect = true;
+    }
+}
+
+void Memory::writeCode(const uint16_t &address, const uint8_t &value) {
+    char* store = this->codeStores[address >> 8];
+    const char* page = this->readPages[address >> 8];
+
+    // Direct store again for every mirror of the page, until blocks are translated from it again
+    for(int i = 0; i < PAGE_COUNT; i++) {
+        if(this->codeStores[i] != store) continue;
+
+        this->writePages[i] = store;
+        this->writeHandlers[i] = nullptr;
+        this->codeStores[i] = nullptr;
+    }
+
+    this->codeWritten(page);
+    store[address & 0xFF] = value;
+}
+
+void Memory::codeWritten(const char* page) {
+    if(page == this->hram) this->hramCode = false;
+
+    this->gameboy->jit->invalidatePage(page);
+    this->gameboy->cpu->invalidateDecoded(page);
 
-    return this->io[address - IO_OFFSET];
-}
\ No newline at end of file
+    this->sideEffect = true;
+}
+
+void Memory::writeIO(const uint16_t &address, const uint8_t &value) {
+    // Interrupts, LCD and DMA changes, a JIT block ends after the write
+    this->sideEffect = true;
+
+    switch(address) {
+        // Joypad, only the select bits are writable
+        case JOYPAD_REGISTER: {
+            this->io[address - IO_OFFSET] = (this->io[address - IO_OFFSET] & 0xCF) | (value & 0x30);
+            this->gameboy->joypad->onSelectWrite(value);
+        } break;
+
+        // Serial control, a transfer with the internal clock ends with an event, the external clock never comes
+        case SERIAL_CONTROL: {
+            this->io[address - IO_OFFSET] = value | 0x7E;
+
+            if((value & 0x81) == 0x81) this->gameboy->scheduler->schedule(Event::Serial, this->gameboy->scheduler->getCycles() + SERIAL_TRANSFER_CYCLES);
+            else this->gameboy->scheduler->cancel(Event::Serial);
+        } break;
+
+        // Timer registers
+        case IO_OFFSET + DIVIDER_REGISTER: this->gameboy->timer->setDividerRegister(value); break;
+        case IO_OFFSET + TIMER_COUNTER: this->gameboy->timer->setTimerCounter(value); break;
+        case IO_OFFSET + TIMER_MODULO: this->gameboy->timer->setTimerModulo(value); break;
+        case IO_OFFSET + TIMER_CONTROL: this->gameboy->timer->setTimerControl(value); break;
+
+        // LCDC, bit 7 turns the LCD on and off
+        case LCDC: {
+            const uint8_t previous = this->io[address - IO_OFFSET];
+            this->io[address - IO_OFFSET] = value;
+
+            if((previous ^ value) & 0x80) {
+                if(value & 0x80) this->gameboy->ppu->enable();
+                else this->gameboy->ppu->disable();
+            }
+        } break;
+
+        // STAT, the mode and coincidence bits are read only
+        case STAT: {
+            this->io[address - IO_OFFSET] = (value & 0x78) | (this->io[address - IO_OFFSET] & 0x07);
+        } break;
+
+        // LY, read only
+        case LY: break;
+
+        // DMA transfer
+        case DMA_REGISTER: {
+            this->io[address - IO_OFFSET] = value;
+            this->startDma(value);
+        } break;
+
+        // Boot ROM disable, it can not be enabled again so the fixed ROM page can be mapped
+        case BOOTROM_DISABLE: {
+            this->io[address - IO_OFFSET] = value;
+            if(value != 0) {
+                this->readPages[BOOTROM_OFFSET >> 8] = this->romFixed;
+                this->gameboy->cpu->unmapDecoded(BOOTROM_OFFSET >> 8, 1);
+            }
+        } break;
+
+        default: {
+            // Sound registers and wave RAM
+            if(address >= SOUND_OFFSET && address < SOUND_OFFSET + SOUND_REGISTERS) this->gameboy->apu->write(address, value);
+            else this->io[address - IO_OFFSET] = value;
+        } break;
+    }
+}
+
+/*
+
+    Save states
+
+*/
+
+void Memory::saveState(MemoryState &state) const {
+    memcpy(state.vram, this->vram, VRAM_SIZE);
+    memcpy(state.wramFixed, this->wramFixed, WRAM_FIXED_SIZE);
+    memcpy(state.wramBanked, this->wramBanked, WRAM_BANKED_SIZE);
+    memcpy(state.oam, this->oam, OAM_SIZE);
+    memcpy(state.io, this->io, IO_SIZE);
+    memcpy(state.hram, this->hram, HRAM_SIZE);
+
+    state.interruptEnable = this->interruptEnable;
+    state.dmaActive = this->dmaActive;
+    state.dmaSource = this->dmaSource;
+}
+
+void Memory::loadState(const MemoryState &state) {
+    memcpy(this->vram, state.vram, VRAM_SIZE);
+    memcpy(this->wramFixed, state.wramFixed, WRAM_FIXED_SIZE);
+    memcpy(this->wramBanked, state.wramBanked, WRAM_BANKED_SIZE);
+    memcpy(this->oam, state.oam, OAM_SIZE);
+    memcpy(this->io, state.io, IO_SIZE);
+    memcpy(this->hram, state.hram, HRAM_SIZE);
+
+    this->interruptEnable = state.interruptEnable;
+    this->dmaActive = state.dmaActive;
+    this->dmaSource = state.dmaSource;
+
+    // The boot ROM overlay depends on the restored disable register
+    if(ENABLE_BOOT_ROM) this->readPages[BOOTROM_OFFSET >> 8] = this->io[BOOTROM_DISABLE - IO_OFFSET] == 0 ? nullptr : this->romFixed;
+}
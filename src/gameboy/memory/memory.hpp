@@ -11,6 +11,7 @@ using namespace std;
 
 // Forward declaration
 class Gameboy;
+struct MemoryState;
 
 // Memory block
 #define BOOTROM 0
@@ -84,20 +85,107 @@ class Gameboy;
 
 #define HRAM_OFFSET 0xFF80
 
+// Page table, the memory map is split in 256 pages of 256 bytes indexed by the address high byte
+#define PAGE_COUNT 256
+#define PAGE_SIZE 256
+
+// IO registers with side effects
+#define JOYPAD_REGISTER 0xFF00
+#define SERIAL_DATA 0xFF01
+#define SERIAL_CONTROL 0xFF02
+#define INTERRUPT_FLAG 0xFF0F
+#define DMA_REGISTER 0xFF46
+#define BOOTROM_DISABLE 0xFF50
+#define INTERRUPT_ENABLE 0xFFFF
+
+// OAM DMA transfer, 160 M cycles
+#define DMA_CYCLES (OAM_SIZE * 4)
+
+// Serial transfer with the internal clock, 8 bits at 8192 Hz
+#define SERIAL_TRANSFER_CYCLES (8 * 512)
+
+class Memory;
+
+// Write handler, called for pages without direct store
+typedef void (Memory::*WriteHandler)(const uint16_t &address, const uint8_t &value);
+
 class Memory {
     public:
         Memory(Gameboy* gameboy);
         ~Memory();
 
-        // Memory read function, fetch 8-bit value from memory
-        char& fetch8(const uint16_t &address);
+        // Memory read function, read 8-bit value from memory
+        inline uint8_t read8(const uint16_t &address) {
+            // Fast path, the page is directly backed by an array
+            const char* page = this->readPages[address >> 8];
+            if(page) return page[address & 0xFF];
+
+            // Slow path, boot ROM overlay, OAM / unusable memory, IOs, HRAM and IE
+            return this->readUnmapped(address);
+        }
+
+        // Memory write function, write 8-bit value to memory
+        inline void write8(const uint16_t &address, const uint8_t &value) {
+            // Fast path, RAM pages are stored directly
+            char* page = this->writePages[address >> 8];
+            if(page) {
+                page[address & 0xFF] = value;
+                return;
+            }
+
+            // Slow path, region write handler
+            (this->*writeHandlers[address >> 8])(address, value);
+        }
+
+        // Hardware access to IO registers, bypasses the side effects of CPU writes (used by PPU, Timer, interrupts)
+        inline uint8_t getIO(const uint16_t &address) const { return this->io[address - IO_OFFSET]; }
+        inline void setIO(const uint16_t &address, const uint8_t &value) { this->io[address - IO_OFFSET] = value; }
 
         // ROM load functions
         void loadRom(const int &memoryBlock, const string &bootromPath, const int readOffset, const int &size);
 
-        void cycle();
+        // Cartridge mapping, swaps the page pointers of the ROM banks and of the external RAM (nullptr if not directly accessible)
+        void mapRom(const char* fixedBank, const char* switchableBank);
+        void mapExtram(char* bank);
+
+        // Host memory of the code at an address, the key of the JIT and pre-decoded caches (ROM bank, boot ROM, WRAM, HRAM), nullptr if not cached
+        inline const char* getCodePage(const uint16_t &address) const {
+            const char* page = this->readPages[address >> 8];
+            if(page && (address < VRAM_OFFSET || address >= WRAM_FIXED_OFFSET)) return page;
+
+            return this->getUnmappedCodePage(address);
+        }
+
+        // Code pages, writes to a protected RAM page go through a handler that drops its translated and decoded instructions
+        void protectCode(const char* page);
+        void unprotectCode();
+
+        // OAM DMA, started by a write to DMA_REGISTER, OAM is copied at the end of the transfer
+        void onDmaEvent(const uint64_t &timestamp);
+
+        // During the transfer the CPU only reaches HRAM, IOs and the bus the source is not on (external or VRAM), OAM is never reachable
+        inline bool isDmaActive() const { return this->dmaActive; }
+        bool isDmaConflict(const uint16_t &address) const;
+
+        // Serial transfer started with the internal clock, the byte goes to the sink and 0xFF comes back (no link partner)
+        void onSerialEvent(const uint64_t &timestamp);
+
+        // Save states, RAM blocks and IO registers (the ROMs are not part of the state)
+        void saveState(MemoryState &state) const;
+        void loadState(const MemoryState &state);
+
+        /*
+
+            Getters
 
-        char dmaLastValue = 0;
+        */
+
+        inline const char* const* getReadPages() const { return this->readPages; }
+        inline char* const* getWritePages() const { return this->writePages; }
+
+        // Set by the writes that can change the mapping, the interrupts, the events or the code, the JIT ends the block
+        inline void clearSideEffect() { this->sideEffect = false; }
+        inline const bool* getSideEffectFlag() const { return &this->sideEffect; }
 
     private:
         // Gameboy ref
@@ -107,27 +195,62 @@ class Memory {
 
         char bootrom[BOOTROM_SIZE]; // 256B
 
-        char romFixed[ROM_FIXED_SIZE]; // 16KB
-        char romBanked[ROM_BANKED_SIZE]; // 16KB
+        // Cartridge ROM banks and external RAM, owned by the cartridge
+        const char* romFixed; // 16KB
+        const char* romBanked; // 16KB
+        char* extram; // 8KB
 
         char vram[VRAM_SIZE]; // 8KB
 
-        char extram[EXTRAM_SIZE]; // 8KB
-
         char wramFixed[WRAM_FIXED_SIZE]; // 4KB
         char wramBanked[WRAM_BANKED_SIZE]; // 4KB
 
         char oam[OAM_SIZE]; // 160B
 
-        char noRam[NO_RAM_SIZE]; // 96B
-
         char io[IO_SIZE]; // 128B
 
         char hram[HRAM_SIZE]; // 127B
 
         char interruptEnable; // Interrupt enable register
 
+        // Page tables, point to the start of the backing array of each page, nullptr if the page needs special handling
+        const char* readPages[PAGE_COUNT];
+        char* writePages[PAGE_COUNT];
+
+        // Write handlers, used when the page has no direct store
+        WriteHandler writeHandlers[PAGE_COUNT];
+
+        // Direct store of the pages protected for the JIT, nullptr if not protected
+        char* codeStores[PAGE_COUNT];
+
+        bool hramCode; // HRAM holds decoded instructions (OAM DMA routine)
+
+        bool sideEffect;
+
+        bool dmaActive;
+        uint8_t dmaSource; // Page of the source, echo RAM and above already mapped to WRAM
+
+        const char* getUnmappedCodePage(const uint16_t &address) const; // Boot ROM overlay and HRAM
+        void codeWritten(const char* page); // Drop the translated and decoded instructions of the page
+
+        void mapPages(const uint16_t &offset, const int &size, const char* block, char* writableBlock); // Map a memory block in the page tables
+        void mapHandler(const uint16_t &offset, const int &size, const WriteHandler &handler); // Set the write handler of a memory region
+        void buildPageTable(); // Build the page tables from the memory blocks
+
         void preloadValues(); // Preload values in memory
 
-        char& fetchIOs(const uint16_t &address); // Fetch 8-bit value from IO memory
+        // Read functions for unmapped pages
+        uint8_t readUnmapped(const uint16_t &address); // Read 8-bit value from a page not in the page table
+        uint8_t readIO(const uint16_t &address); // Read 8-bit value from IO memory
+
+        // Write handlers
+        void writeRom(const uint16_t &address, const uint8_t &value); // ROM, bank registers
+        void writeExtram(const uint16_t &address, const uint8_t &value); // External RAM not directly accessible
+        void writeVram(const uint16_t &address, const uint8_t &value); // VRAM
+        void writeHigh(const uint16_t &address, const uint8_t &value); // OAM, unusable memory, IOs, HRAM and IE
+        void writeIO(const uint16_t &address, const uint8_t &value); // IO registers side effects
+        void writeCode(const uint16_t &address, const uint8_t &value); // WRAM page holding translated or decoded instructions
+
+        // OAM DMA transfer
+        void startDma(const uint8_t &source);
 };
\ No newline at end of file
@@ -0,0 +1,125 @@
+#include <iostream>
+#include <stdint.h>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+
+using namespace std;
+
+#include "../utils/utils.hpp"
+#include "../logging/logger/logger.hpp"
+
+#include "pacer.hpp"
+
+/*
+
+    Constructors and Destructors
+
+*/
+
+Pacer::Pacer(Gameboy* gameboy) : gameboy(gameboy), mode(Pacing::None), startTime(), startCycles(0), averageFill(PACING_TARGET_FILL), rateRatio(1), lateFrames(0) {
+    logger = gameboy->getMasterLogger()->getLogger("Pacer");
+    logger->log("Pacer Constructor");
+}
+
+Pacer::~Pacer() {
+    logger->log("Pacer Destructor");
+
+    delete logger;
+}
+
+/*
+
+    Functions
+
+*/
+
+void Pacer::setMode(const Pacing &mode) {
+    this->mode = mode;
+    this->start();
+
+    // Unpaced, the samples are made at the output rate
+    if(mode == Pacing::None && this->rateRatio != 1) {
+        this->rateRatio = 1;
+        this->gameboy->apu->setRateRatio(1);
+    }
+}
+
+void Pacer::start() {
+    this->startTime = chrono::steady_clock::now();
+    this->startCycles = this->gameboy->getTcycles();
+    this->averageFill = this->gameboy->apu->getRing()->size();
+
+    // With audio output the clock starts ahead by the target latency, the ring fills at once instead of underrunning
+    const int sampleRate = this->gameboy->apu->getSampleRate();
+    if(sampleRate) this->startTime -= chrono::microseconds(PACING_TARGET_FILL * 1000000ull / sampleRate);
+}
+
+void Pacer::wait() {
+    if(this->mode == Pacing::None) return;
+
+    const int sampleRate = this->gameboy->apu->getSampleRate();
+
+    if(this->mode == Pacing::Audio && sampleRate) this->waitAudio(sampleRate);
+    else this->waitClock();
+
+    if(sampleRate) this->adjustRate();
+}
+
+/*
+
+    Internal methods
+
+*/
+
+void Pacer::waitClock() {
+    const uint64_t cycles = this->gameboy->getTcycles();
+
+    // The master clock went back without a state load, the run starts again from it
+    if(cycles < this->startCycles) {
+        this->start();
+        return;
+    }
+
+    // Wall clock of the master clock, in two parts so the nanoseconds do not overflow on long runs
+    const uint64_t elapsed = cycles - this->startCycles;
+    const chrono::nanoseconds emulated((elapsed / CLOCK_RATE) * 1000000000ull + (elapsed % CLOCK_RATE) * 1000000000ull / CLOCK_RATE);
+
+    const chrono::steady_clock::time_point due = this->startTime + emulated;
+    const chrono::steady_clock::time_point now = chrono::steady_clock::now();
+
+    // Far ahead, the anchor is stale (the clock jumped forward), sleeping it off would run in slow motion
+    if(due - now > PACING_MAX_LAG) this->start();
+
+    // Ahead, the thread sleeps instead of spinning
+    else if(due > now) this_thread::sleep_until(min(due, now + chrono::duration_cast<chrono::steady_clock::duration>(PACING_MAX_SLEEP)));
+
+    // Too far behind (slow host, the run was paused), running at full speed to catch up would be heard and seen
+    else if(now - due > PACING_MAX_LAG) {
+        this->lateFrames ++;
+        this->start();
+    }
+}
+
+void Pacer::waitAudio(const int &sampleRate) {
+    const size_t fill = this->gameboy->apu->getRing()->size();
+    if(fill <= PACING_TARGET_FILL) return;
+
+    // Time the audio device takes to drain the ring down to the target
+    const chrono::microseconds drain((fill - PACING_TARGET_FILL) * 1000000ull / sampleRate);
+    this_thread::sleep_for(min(drain, chrono::duration_cast<chrono::microseconds>(PACING_MAX_SLEEP)));
+}
+
+void Pacer::adjustRate() {
+    const size_t fill = this->gameboy->apu->getRing()->size();
+    this->averageFill += ((double) fill - this->averageFill) / PACING_FILL_SMOOTHING;
+
+    // Under the target, more samples per emulated second, over it fewer, proportional to the distance
+    const double distance = clamp(1 - this->averageFill / PACING_TARGET_FILL, -1.0, 1.0);
+    const double ratio = 1 + PACING_MAX_RATE_DELTA * distance;
+
+    if(ratio == this->rateRatio) return;
+
+    this->rateRatio = ratio;
+    this->gameboy->apu->setRateRatio(ratio);
+}
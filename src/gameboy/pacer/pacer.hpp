@@ -0,0 +1,89 @@
+#pragma once
+
+#include <stdint.h>
+#include <chrono>
+
+using namespace std;
+
+#include "../../constants/constants.hpp"
+
+#include "../logging/log/log.hpp"
+
+#include "../gameboy.hpp"
+
+// Forward declaration
+class Gameboy;
+
+// Pacing source, the emulation runs unbounded without one
+enum class Pacing : uint8_t {
+    None,
+    Clock, // High resolution host clock, one emulated second per second (59.73 frames)
+    Audio // Fill level of the audio ring, the audio device clock sets the speed, the clock without audio output
+};
+
+// Behind the clock by more than this, the lost time is dropped instead of being caught up at full speed
+#define PACING_MAX_LAG chrono::milliseconds(100)
+
+// Longest sleep after one frame, the audio output may be paused and stop draining the ring
+#define PACING_MAX_SLEEP chrono::milliseconds(50)
+
+// Audio latency kept in the ring, stereo frames (about 43 ms at 48 kHz)
+#define PACING_TARGET_FILL (2 * AUDIO_BUFFER_FRAMES)
+
+// Frames over which the fill is averaged, the audio device drains the ring one buffer at a time
+#define PACING_FILL_SMOOTHING 16
+
+// Largest change of the resampling ratio, 0.5% is not heard as a pitch change
+#define PACING_MAX_RATE_DELTA 0.005
+
+/*
+
+    Pacer, throttles the emulation to real time between two frames
+    The host sleeps while the machine is ahead, the resampling ratio is moved by a small amount every frame
+    so the ring stays at its target fill: the audio device and the host clock drift, without it the ring underruns or fills up
+
+*/
+
+class Pacer {
+    public:
+        Pacer(Gameboy* gameboy);
+        ~Pacer();
+
+        void setMode(const Pacing &mode);
+        inline const Pacing& getMode() const { return this->mode; }
+
+        // The wall clock starts again at the master clock, the mode is set or the machine jumped in time
+        void start();
+
+        // Sleep until the master clock is due, after each frame
+        void wait();
+
+        /*
+
+            Getters
+
+        */
+
+        inline double getRateRatio() const { return this->rateRatio; } // Resampling ratio set to the APU
+        inline uint64_t getLateFrames() const { return this->lateFrames; } // Frames behind the clock by more than the lag allowed
+
+    private:
+        // Gameboy ref
+        Gameboy* gameboy;
+
+        Log* logger;
+
+        Pacing mode;
+
+        // Anchor, the wall clock at which the master clock was at startCycles
+        chrono::steady_clock::time_point startTime;
+        uint64_t startCycles;
+
+        double averageFill; // Ring fill averaged over a few frames, stereo frames
+        double rateRatio;
+        uint64_t lateFrames;
+
+        void waitClock();
+        void waitAudio(const int &sampleRate);
+        void adjustRate(); // Dynamic rate control from the ring fill
+};
@@ -0,0 +1,178 @@
+#include <cstdint>
+
+using namespace std;
+
+#if defined(__x86_64__) || defined(__i386__)
+#define COMPOSITOR_X86 true
+#include <immintrin.h>
+#else
+#define COMPOSITOR_X86 false
+#endif
+
+#include "compositor.hpp"
+
+/*
+
+    Scalar, any CPU
+
+*/
+
+static void applyPaletteScalar(const uint8_t* indexes, const uint8_t &palette, uint8_t* out, const int &count) {
+    for(int i = 0; i < count; i++) out[i] = (palette >> (indexes[i] * 2)) & 0x03;
+}
+
+static void blendSpriteScalar(const uint8_t* indexes, const uint8_t &palette, const bool &behindBackground, const uint8_t* background, uint8_t* out, const int &count) {
+    for(int i = 0; i < count; i++) {
+        // Transparent
+        if(indexes[i] == 0) continue;
+
+        // Behind the background, only drawn over background color 0
+        if(behindBackground && background[i] != 0) continue;
+
+        out[i] = (palette >> (indexes[i] * 2)) & 0x03;
+    }
+}
+
+#if COMPOSITOR_X86
+
+/*
+
+    SSE2, 16 pixels at a time, part of the x86-64 baseline
+
+*/
+
+// Palette lookup without shuffle (SSSE3), each color index selects its color with a compare mask
+static inline __m128i lookupSSE2(const __m128i &indexes, const uint8_t &palette) {
+    __m128i colors = _mm_setzero_si128();
+
+    for(int i = 1; i < 4; i++) {
+        const __m128i color = _mm_set1_epi8((palette >> (i * 2)) & 0x03);
+        colors = _mm_or_si128(colors, _mm_and_si128(_mm_cmpeq_epi8(indexes, _mm_set1_epi8(i)), color));
+    }
+
+    // Color index 0
+    const __m128i color = _mm_set1_epi8(palette & 0x03);
+    return _mm_or_si128(colors, _mm_and_si128(_mm_cmpeq_epi8(indexes, _mm_setzero_si128()), color));
+}
+
+static void applyPaletteSSE2(const uint8_t* indexes, const uint8_t &palette, uint8_t* out, const int &count) {
+    int i = 0;
+
+    for(; i + 16 <= count; i += 16) {
+        const __m128i colors = lookupSSE2(_mm_loadu_si128((const __m128i*) (indexes + i)), palette);
+        _mm_storeu_si128((__m128i*) (out + i), colors);
+    }
+
+    applyPaletteScalar(indexes + i, palette, out + i, count - i);
+}
+
+static void blendSpriteSSE2(const uint8_t* indexes, const uint8_t &palette, const bool &behindBackground, const uint8_t* background, uint8_t* out, const int &count) {
+    // Sprites cut by the right edge of the screen
+    if(count != 8) {
+        blendSpriteScalar(indexes, palette, behindBackground, background, out, count);
+        return;
+    }
+
+    const __m128i zero = _mm_setzero_si128();
+
+    const __m128i spriteIndexes = _mm_loadl_epi64((const __m128i*) indexes);
+    const __m128i colors = lookupSSE2(spriteIndexes, palette);
+    const __m128i previous = _mm_loadl_epi64((const __m128i*) out);
+
+    // Opaque pixels, over background color 0 only if the sprite is behind the background
+    __m128i mask = _mm_andnot_si128(_mm_cmpeq_epi8(spriteIndexes, zero), _mm_set1_epi8(-1));
+    if(behindBackground) mask = _mm_and_si128(mask, _mm_cmpeq_epi8(_mm_loadl_epi64((const __m128i*) background), zero));
+
+    _mm_storel_epi64((__m128i*) out, _mm_or_si128(_mm_and_si128(mask, colors), _mm_andnot_si128(mask, previous)));
+}
+
+/*
+
+    AVX2, 32 pixels at a time with a shuffle palette lookup
+
+*/
+
+__attribute__((target("avx2")))
+static void applyPaletteAVX2(const uint8_t* indexes, const uint8_t &palette, uint8_t* out, const int &count) {
+    const char c0 = palette & 0x03, c1 = (palette >> 2) & 0x03, c2 = (palette >> 4) & 0x03, c3 = (palette >> 6) & 0x03;
+
+    // The shuffle looks up each lane separately, the 4 colors are repeated in both lanes
+    const __m256i lut = _mm256_setr_epi8(c0, c1, c2, c3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, c0, c1, c2, c3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+
+    int i = 0;
+
+    for(; i + 32 <= count; i += 32) {
+        const __m256i colors = _mm256_shuffle_epi8(lut, _mm256_loadu_si256((const __m256i*) (indexes + i)));
+        _mm256_storeu_si256((__m256i*) (out + i), colors);
+    }
+
+    // Tail in the same function, calling the SSE2 path with the upper halves of the registers dirty would stall on the transition
+    for(; i + 16 <= count; i += 16) {
+        const __m128i colors = _mm_shuffle_epi8(_mm256_castsi256_si128(lut), _mm_loadu_si128((const __m128i*) (indexes + i)));
+        _mm_storeu_si128((__m128i*) (out + i), colors);
+    }
+
+    for(; i < count; i++) out[i] = (palette >> (indexes[i] * 2)) & 0x03;
+}
+
+#endif
+
+/*
+
+    Constructors and Destructors
+
+*/
+
+Compositor::Compositor() {
+    this->setLevel(getSupportedLevel());
+}
+
+/*
+
+    Getters and Setters
+
+*/
+
+bool Compositor::setLevel(const SimdLevel &level) {
+    if(level > getSupportedLevel()) return false;
+
+    this->level = level;
+
+    switch(level) {
+#if COMPOSITOR_X86
+        case SimdLevel::AVX2: {
+            this->paletteFunction = &applyPaletteAVX2;
+            this->spriteFunction = &blendSpriteSSE2; // A sprite row is 8 pixels, wider registers do not help
+        } break;
+
+        case SimdLevel::SSE2: {
+            this->paletteFunction = &applyPaletteSSE2;
+            this->spriteFunction = &blendSpriteSSE2;
+        } break;
+#endif
+
+        default: {
+            this->paletteFunction = &applyPaletteScalar;
+            this->spriteFunction = &blendSpriteScalar;
+        } break;
+    }
+
+    return true;
+}
+
+SimdLevel Compositor::getSupportedLevel() {
+#if COMPOSITOR_X86
+    if(__builtin_cpu_supports("avx2")) return SimdLevel::AVX2;
+    if(__builtin_cpu_supports("sse2")) return SimdLevel::SSE2;
+#endif
+
+    return SimdLevel::Scalar;
+}
+
+const char* Compositor::getLevelName(const SimdLevel &level) {
+    switch(level) {
+        case SimdLevel::AVX2: return "AVX2";
+        case SimdLevel::SSE2: return "SSE2";
+        default: return "Scalar";
+    }
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+
+using namespace std;
+
+// Instruction set used by the compositor, the best one supported by the CPU is selected at runtime
+enum class SimdLevel : uint8_t {
+    Scalar = 0,
+    SSE2 = 1,
+    AVX2 = 2
+};
+
+// Palette lookup of a run of color indexes
+typedef void (*PaletteFunction)(const uint8_t* indexes, const uint8_t &palette, uint8_t* out, const int &count);
+
+// Sprite row over the background, the 8 pixels are opaque when their color index is not 0
+typedef void (*SpriteFunction)(const uint8_t* indexes, const uint8_t &palette, const bool &behindBackground, const uint8_t* background, uint8_t* out, const int &count);
+
+class Compositor {
+public:
+    Compositor();
+
+    // Scanline operations, dispatched to the selected instruction set
+    inline void applyPalette(const uint8_t* indexes, const uint8_t &palette, uint8_t* out, const int &count) const { (*this->paletteFunction)(indexes, palette, out, count); }
+    inline void blendSprite(const uint8_t* indexes, const uint8_t &palette, const bool &behindBackground, const uint8_t* background, uint8_t* out, const int &count) const { (*this->spriteFunction)(indexes, palette, behindBackground, background, out, count); }
+
+    /*
+
+        Getters and Setters
+
+    */
+
+    inline const SimdLevel& getLevel() const { return this->level; }
+    bool setLevel(const SimdLevel &level); // False if the CPU does not support it
+
+    static SimdLevel getSupportedLevel(); // Best instruction set of this CPU
+    static const char* getLevelName(const SimdLevel &level);
+
+private:
+    SimdLevel level;
+
+    PaletteFunction paletteFunction;
+    SpriteFunction spriteFunction;
+};
@@ -1,118 +1,143 @@
 #include <iostream>
+#include <cstring>
 
 using namespace std;
 
 #include "../../constants/constants.hpp"
 
 #include "ppu.hpp"
+#include "../savestate/savestate.hpp"
 
-PPU::PPU(Gameboy* gameboy) : gameboy(gameboy), logger(Logger::getInstance()->getLogger("PPU")), currentLY(0), currentMode(Mode::OAMSearch) {
+PPU::PPU(Gameboy* gameboy) : gameboy(gameboy), logger(gameboy->getMasterLogger()->getLogger("PPU")), currentLY(0), currentMode(Mode::OAMSearch), lineStart(0) {
     // Initialize framebuffer
     for (auto& row : framebuffer) {
         row.fill(0);
     }
+
+    // Nothing decoded yet
+    invalidateTiles();
 }
 
 PPU::~PPU() {
     // Destructor
+
+    delete logger;
 }
 
-void PPU::step() {
-    //handle mode transitions based on current T-cycle
-    switch (currentMode) {
-        case Mode::OAMSearch:
-            if (this->gameboy->getTcycles() == 0) {
-                // OAM Search mode
-                checkSTATInterrupts(); 
-            }
-            
-            if (this->gameboy->getTcycles() >= 80) {
-                currentMode = Mode::Drawing;
-            }
-            break;
-            
-        case Mode::Drawing:
-            if (this->gameboy->getTcycles() >= 252) {
-                currentMode = Mode::HBlank;
-                renderScanline(); 
-                
-                uint8_t& stat = (uint8_t&) this->gameboy->memory->fetch8(STAT);
-                stat = (stat & 0xFC) | static_cast<uint8_t>(currentMode);
-                
-                checkSTATInterrupts();
-            }
-            break;
-            
-        case Mode::HBlank:
-            // changes handled at T-cycle 456/0
-            break;
-            
-        case Mode::VBlank:
-            if(this->gameboy->getTcycles() == 0 && currentLY == 144) {
-                //entered VBlank
-                this->gameboy->cpu->triggerInterrupt(Interrupt::VBlank);
-                checkSTATInterrupts();
-            }
-            break;
+/*
+
+    LCD enable and disable, called on LCDC bit 7 writes
+
+*/
+
+void PPU::enable() {
+    // Start a frame on line 0
+    this->currentLY = 0;
+    this->gameboy->memory->setIO(LY, this->currentLY);
+
+    checkLYCInterrupt();
+    startLine(this->gameboy->scheduler->getCycles());
+}
+
+void PPU::disable() {
+    // Stop the line events
+    this->gameboy->scheduler->cancel(Event::PPUMode);
+    this->gameboy->scheduler->cancel(Event::PPULine);
+
+    this->currentLY = 0;
+    this->gameboy->memory->setIO(LY, this->currentLY);
+
+    setMode(Mode::HBlank);
+}
+
+/*
+
+    Scheduled events
+
+*/
+
+void PPU::startLine(const uint64_t &timestamp) {
+    this->lineStart = timestamp;
+
+    if (currentLY < SCREEN_HEIGHT) {
+        // OAM Search mode, drawing starts after the search
+        setMode(Mode::OAMSearch);
+        checkSTATInterrupts();
+
+        this->gameboy->scheduler->schedule(Event::PPUMode, this->lineStart + OAM_SEARCH_DOTS);
+    } else if (currentLY == SCREEN_HEIGHT) {
+        //entered VBlank
+        setMode(Mode::VBlank);
+
+        this->gameboy->cpu->triggerInterrupt(Interrupt::VBlank);
+        checkSTATInterrupts();
     }
-    
-    if (this->gameboy->getTcycles() == 455) {
-        currentLY++;
-        uint8_t& nLY = (uint8_t&) this->gameboy->memory->fetch8(LY);
-        nLY = currentLY;
-        
-        checkLYCInterrupt();
-        
-        if (currentLY == 144) {
-            // Prepare for VBlank
-        } else if (currentLY > 153) {
-            currentLY = 0;
-            nLY = currentLY;
-        }
-    } else if (this->gameboy->getTcycles() == 0) {
-        if (currentLY == 144) {
-            currentMode = Mode::VBlank;
-
-            this->gameboy->cpu->triggerInterrupt(Interrupt::VBlank);
-        } else if (currentLY == 0 || currentLY < 144) {
-            currentMode = Mode::OAMSearch;
-            checkSTATInterrupts(); 
-        }
-    
-        if(ENABLE_LOGGING) {
-            // Copy framebuffer into another var
-            FrameBuffer copyFramebuffer;
-
-            for (int i = 0; i < SCREEN_HEIGHT; i++) {
-                for (int j = 0; j < SCREEN_WIDTH; j++) {
-                    copyFramebuffer[i][j] = framebuffer[i][j];
-                }
-            }
 
-            // Add a colored pixel to where the LY is
-            if(currentLY < SCREEN_HEIGHT) {
-                for (int i = 0; i < SCREEN_WIDTH; i++) {
-                    copyFramebuffer[currentLY][i] = 0xFF;
-                }
+    if(ENABLE_LOGGING) {
+        // Copy framebuffer into another var
+        FrameBuffer copyFramebuffer;
+
+        for (int i = 0; i < SCREEN_HEIGHT; i++) {
+            for (int j = 0; j < SCREEN_WIDTH; j++) {
+                copyFramebuffer[i][j] = framebuffer[i][j];
             }
+        }
 
-            // Render the framebuffer
-            this->gameboy->renderer->render(copyFramebuffer);
-        } else {
-           if (currentLY == 0) {
-                this->gameboy->renderer->render(framebuffer);
+        // Add a colored pixel to where the LY is
+        if(currentLY < SCREEN_HEIGHT) {
+            for (int i = 0; i < SCREEN_WIDTH; i++) {
+                copyFramebuffer[currentLY][i] = 0xFF;
             }
         }
+
+        // Render the framebuffer
+        this->gameboy->sink->render(copyFramebuffer);
+    } else {
+        if (currentLY == 0) {
+            this->gameboy->sink->render(framebuffer);
+        }
     }
-    
+
+    // End of line
+    this->gameboy->scheduler->schedule(Event::PPULine, this->lineStart + DOTS_PER_LINE);
+}
+
+void PPU::onModeEvent(const uint64_t &) {
+    if (currentMode == Mode::OAMSearch) {
+        setMode(Mode::Drawing);
+
+        this->gameboy->scheduler->schedule(Event::PPUMode, this->lineStart + DRAWING_END_DOT);
+    } else if (currentMode == Mode::Drawing) {
+        setMode(Mode::HBlank);
+        renderScanline();
+
+        checkSTATInterrupts();
+    }
+}
+
+void PPU::onLineEvent(const uint64_t &timestamp) {
+    currentLY++;
+    if (currentLY >= LINES_PER_FRAME) {
+        currentLY = 0;
+    }
+
+    this->gameboy->memory->setIO(LY, currentLY);
+    checkLYCInterrupt();
+
+    startLine(timestamp);
+}
+
+void PPU::setMode(const Mode &mode) {
+    currentMode = mode;
+
     //update STAT register in mem
-    uint8_t& stat = (uint8_t&) this->gameboy->memory->fetch8(STAT);
-    stat = (stat & 0xFC) | static_cast<uint8_t>(currentMode);
+    uint8_t stat = this->gameboy->memory->getIO(STAT);
+    this->gameboy->memory->setIO(STAT, (stat & 0xFC) | static_cast<uint8_t>(currentMode));
 }
 
 void PPU::checkLYCInterrupt() {
-    uint8_t& stat = (uint8_t&) this->gameboy->memory->fetch8(STAT);
-    uint8_t& lyc = (uint8_t&) this->gameboy->memory->fetch8(LYC);
+    uint8_t stat = this->gameboy->memory->getIO(STAT);
+    uint8_t lyc = this->gameboy->memory->getIO(LYC);
 
     if (lyc == currentLY){
         stat |= 0x04;
@@ -123,13 +148,12 @@ void PPU::checkLYCInterrupt() {
         stat &= 0xFB;
     }
     //update STAT register in mem
-    uint8_t& nSTAT = (uint8_t&) this->gameboy->memory->fetch8(STAT);
-    nSTAT = stat;
+    this->gameboy->memory->setIO(STAT, stat);
 }
 
 
 void PPU::checkSTATInterrupts() {
-    uint8_t stat = this->gameboy->memory->fetch8(STAT);
+    uint8_t stat = this->gameboy->memory->getIO(STAT);
     bool interruptTriggered = false;
     
     if ((stat & 0x08) && currentMode == Mode::HBlank) {
@@ -155,19 +179,19 @@ void PPU::checkSTATInterrupts() {
 
 //check bit 0 of LCDC to know if the background is enabled
 inline bool PPU::isBGEnabled() const {
-    uint8_t lcdc = this->gameboy->memory->fetch8(LCDC);
+    uint8_t lcdc = this->gameboy->memory->getIO(LCDC);
     return lcdc & 0x01;
 }
 
 //check bit 5 of LCDC to know if window is enbled
 inline bool PPU::isWDEnabled() const {
-    uint8_t lcdc = this->gameboy->memory->fetch8(LCDC);
+    uint8_t lcdc = this->gameboy->memory->getIO(LCDC);
     return lcdc & 0x20;
 }
 
 //check bit 1 of LCDC to know if sprites are enabled
 inline bool PPU::areSpritesEnabled() const {
-    uint8_t lcdc = this->gameboy->memory->fetch8(LCDC);
+    uint8_t lcdc = this->gameboy->memory->getIO(LCDC);
     return lcdc & 0x02;
 }
 
@@ -188,6 +212,15 @@ void PPU::renderScanline(){
 
 
 
+void PPU::renderLine(const int &line) {
+    const int ly = this->currentLY;
+
+    this->currentLY = line;
+    renderScanline();
+
+    this->currentLY = ly;
+}
+
 void PPU::drawBackground() {
     // Draw the background layer for the current scanline
     fetchBackgroundTileData();
@@ -203,11 +236,57 @@ void PPU::drawSprites() {
     fetchSpriteData();
 }
 
+/*
+
+    Tile cache
+
+*/
+
+void PPU::invalidateTiles() {
+    for (int i = 0; i < TILE_COUNT; i++) {
+        tileDirty[i] = true;
+    }
+}
+
+void PPU::decodeTile(const int &tile) {
+    const uint16_t tileDataAddress = TILE_DATA_OFFSET + tile * TILE_BYTES;
+
+    for (int y = 0; y < TILE_SIZE; y++) {
+        // Two bitplanes per row, pixels are stored in MSB order
+        uint8_t lowByte = this->gameboy->memory->read8(tileDataAddress + y * 2);
+        uint8_t highByte = this->gameboy->memory->read8(tileDataAddress + y * 2 + 1);
+
+        for (int x = 0; x < TILE_SIZE; x++) {
+            int bit = 7 - x;
+            tileCache[tile][y][x] = ((highByte >> bit) & 0x01) << 1 | ((lowByte >> bit) & 0x01);
+        }
+    }
+
+    tileDirty[tile] = false;
+}
+
+const uint8_t* PPU::getTileRow(const uint8_t &tileIndex, const bool &unsignedMode, const int &row) {
+    // "$8000 method" uses unsigned indexes from 0x8000, "$8800 method" signed indexes from 0x9000 (tile 256)
+    int tile = unsignedMode ? tileIndex : 256 + static_cast<int8_t>(tileIndex);
+
+    if (tileDirty[tile]) {
+        decodeTile(tile);
+    }
+
+    return tileCache[tile][row];
+}
+
+/*
+
+    Background and window
+
+*/
+
 void PPU::fetchBackgroundTileData() {
-    uint8_t lcdc = this->gameboy->memory->fetch8(LCDC); // LCDC register
-    uint8_t scx = this->gameboy->memory->fetch8(SCX);  // Scroll X
-    uint8_t scy = this->gameboy->memory->fetch8(SCY);  // Scroll Y
-    uint8_t bgp = this->gameboy->memory->fetch8(BGP);  // Background palette
+    uint8_t lcdc = this->gameboy->memory->getIO(LCDC); // LCDC register
+    uint8_t scx = this->gameboy->memory->getIO(SCX);  // Scroll X
+    uint8_t scy = this->gameboy->memory->getIO(SCY);  // Scroll Y
+    uint8_t bgp = this->gameboy->memory->getIO(BGP);  // Background palette
 
     // determine quel bg tile map to use (bit 3 of lcdc)    
     uint16_t tileMapBase = (lcdc & 0x08) ? 0x9C00 : 0x9800;
@@ -218,58 +297,35 @@ void PPU::fetchBackgroundTileData() {
     // calculate the starting Y position in the background
     int tileRow = (((currentLY + scy) & 0xFF) / TILE_SIZE) & 0x1F;// &x1F it's like doing mod 32 (pour rester dasn la bonne plage 0-31)
 
+    // determiner la ligne dans la tile to render
+    int tileY = (currentLY + scy) & 7; // c'est comme faire mod 8
 
-    for (int x = 0; x < SCREEN_WIDTH; x++) {
-        //calculer la starting x position in the background
-        int tileCol = ((x + scx) / TILE_SIZE) & 0x1F;
+    // Color indexes of the 21 tiles covering the line, the first pixel is at SCX mod 8
+    uint8_t indexes[SCREEN_WIDTH + TILE_SIZE];
+    int firstCol = scx / TILE_SIZE;
 
+    for (int i = 0; i <= SCREEN_WIDTH / TILE_SIZE; i++) {
+        //calculer la x position in the background
+        int tileCol = (firstCol + i) & 0x1F;
 
         //ici on trouve le tile index dans le background tile map
-        uint16_t tileAddress = tileMapBase + (tileRow * 32) + tileCol;
-        uint8_t tileIndex = this->gameboy->memory->fetch8(tileAddress);
-
-        // calculer l'address du tile data
-        uint16_t tileDataAddress;
-        if (tileDataMode) {
-            tileDataAddress = 0x8000 + (tileIndex * 16); //“$8000 method” uses $8000 as its base pointer and uses an unsigned addressing
-        } else {
-            int8_t signedTileIndex = static_cast<int8_t>(tileIndex);
-            tileDataAddress = 0x9000 + (signedTileIndex * 16); //“$8800 method” uses $9000 as its base pointer and uses a signed addressing
-        }
-
-        // determiner la ligne dans la tile to render
-        int tileY = 2*(((currentLY + scy) & 7)); // c'est comme faire mod 8
-
-        uint16_t rowAddress = tileDataAddress + tileY;
-
-        // Fetch the two bytes representing the pixel row
-        uint8_t lowByte = this->gameboy->memory->fetch8(rowAddress);
-        uint8_t highByte = this->gameboy->memory->fetch8(rowAddress + 1);
-
-        // Compute the pixel's color for the current screen X
-        int tileX = (x + scx) & 7;
-        int bit = 7 - tileX; // Pixels are stored in MSB order
-        uint8_t colorIndex = ((highByte >> bit) & 0x01) << 1 | ((lowByte >> bit) & 0x01);
-
-        // Apply the BGP palette
-        uint8_t color = (bgp >> (colorIndex * 2)) & 0x03;
+        uint8_t tileIndex = this->gameboy->memory->read8(tileMapBase + (tileRow * 32) + tileCol);
+        memcpy(indexes + i * TILE_SIZE, getTileRow(tileIndex, tileDataMode, tileY), TILE_SIZE);
+    }
 
-        // Store the pixel in the framebuffer
-        bgBuffer[currentLY][x] = color;
-        framebuffer[currentLY][x] = color;
+    // Apply the BGP palette, the sprites check their priority against the background colors
+    compositor.applyPalette(indexes + (scx & 7), bgp, bgBuffer[currentLY], SCREEN_WIDTH);
+    memcpy(framebuffer[currentLY].data(), bgBuffer[currentLY], SCREEN_WIDTH);
 
-        if(color != 0) {
-            *logger << "Background color: " + to_string(color) + ", X: " + to_string(x) + ", Y: " + to_string(currentLY);
-        }
-    }
+    logger->log("Background line ", currentLY, ", SCX: ", (int) scx, ", SCY: ", (int) scy);
 }
 
 
 void PPU::fetchWindowTileData() {
-    uint8_t lcdc = this->gameboy->memory->fetch8(LCDC);
-    uint8_t wx = this->gameboy->memory->fetch8(WX);
-    uint8_t wy = this->gameboy->memory->fetch8(WY);
-    uint8_t bgp = this->gameboy->memory->fetch8(BGP);
+    uint8_t lcdc = this->gameboy->memory->getIO(LCDC);
+    uint8_t wx = this->gameboy->memory->getIO(WX);
+    uint8_t wy = this->gameboy->memory->getIO(WY);
+    uint8_t bgp = this->gameboy->memory->getIO(BGP);
 
     if (!(lcdc & 0x20) || currentLY < wy || wy>143 || wx < 7 || wx > 166) return;
 
@@ -279,49 +335,28 @@ void PPU::fetchWindowTileData() {
 
     int tileRow = (((currentLY - wy) / TILE_SIZE) & 0x1F);
 
-    for (int x = 0; x < SCREEN_WIDTH; x++){
-        int windowX = x - wx + 7;
-        if (windowX < 0 ) continue;
-
-        int tileCol = (windowX / TILE_SIZE) & 0x1F;
-
-        uint16_t tileAddress = tileMapBase + (tileRow * 32) + tileCol;
-        uint8_t tileIndex = this->gameboy->memory->fetch8(tileAddress);
-
-        uint16_t tileDataAddress;
-        if (tileDataMode) {
-            tileDataAddress = 0x8000 + (tileIndex * 16);
-        } else {
-            int8_t signedTileIndex = static_cast<int8_t>(tileIndex);
-            tileDataAddress = 0x9000 + (signedTileIndex * 16);
-        }
+    int tileY = (currentLY - wy) & 7;
 
-        int tileY = 2 * ((currentLY - wy) & 7);
+    // The window starts on a tile boundary at screen X wx - 7
+    int start = wx - 7;
+    int count = SCREEN_WIDTH - start;
 
-        uint16_t rowAddress = tileDataAddress + tileY;
+    uint8_t indexes[SCREEN_WIDTH + TILE_SIZE];
 
-        uint8_t lowByte = this->gameboy->memory->fetch8(rowAddress);
-        uint8_t highByte = this->gameboy->memory->fetch8(rowAddress + 1);
-
-        int tileX = windowX & 7;
-        int bit = 7 - tileX;
-        uint8_t colorIndex = ((highByte >> bit) & 0x01) << 1 | ((lowByte >> bit) & 0x01);
-
-        uint8_t color = (bgp >> (colorIndex * 2)) & 0x03;
-
-        framebuffer[currentLY][x] = color;
-
-        if(color != 0) {
-            *logger << "Background color: " + to_string(color) + ", X: " + to_string(x) + ", Y: " + to_string(currentLY);
-        }
+    for (int i = 0; i * TILE_SIZE < count; i++) {
+        uint8_t tileIndex = this->gameboy->memory->read8(tileMapBase + (tileRow * 32) + (i & 0x1F));
+        memcpy(indexes + i * TILE_SIZE, getTileRow(tileIndex, tileDataMode, tileY), TILE_SIZE);
     }
 
+    compositor.applyPalette(indexes, bgp, framebuffer[currentLY].data() + start, count);
+
+    logger->log("Window line ", currentLY, ", WX: ", (int) wx, ", WY: ", (int) wy);
 }
 
 
 
 void PPU::fetchSpriteData() {
-    uint8_t lcdc = this->gameboy->memory->fetch8(LCDC); 
+    uint8_t lcdc = this->gameboy->memory->getIO(LCDC); 
     // check the bit 2 of lcdc to know sprite size
     bool spriteSize = lcdc & 0x04; // sprite size can be 8x8 or 8x16
     int spriteHeight = spriteSize ? 16 : 8;
@@ -339,12 +374,12 @@ void PPU::fetchSpriteData() {
 
     //Sprite data is stored in the OAM section of memory which can fit up to 40 sprites.
     for (int i = 0; i < 40 ; i++) {
-        uint8_t yPos = this->gameboy->memory->fetch8(OAM_OFFSET + i * 4) - 16;
+        uint8_t yPos = this->gameboy->memory->read8(OAM_OFFSET + i * 4) - 16;
         
         if (yPos > 144 || currentLY < yPos || currentLY >= yPos + spriteHeight) 
         continue;
         
-        uint8_t xPos = this->gameboy->memory->fetch8(OAM_OFFSET + i * 4 + 1) - 8;
+        uint8_t xPos = this->gameboy->memory->read8(OAM_OFFSET + i * 4 + 1) - 8;
 
         if (visibleSpriteCount < 40) {
             visibleSprites[visibleSpriteCount].index = i;
@@ -368,10 +403,10 @@ void PPU::fetchSpriteData() {
     // pour que les sprites avec le plus grand x ecrasent les autres
     for (int i = spritesToRender - 1; i >= 0; i--) {
         int spriteIndex = visibleSprites[i].index;
-        uint8_t yPos = this->gameboy->memory->fetch8(OAM_OFFSET + spriteIndex * 4) - 16;
-        uint8_t xPos = this->gameboy->memory->fetch8(OAM_OFFSET + spriteIndex * 4 + 1) - 8;
-        uint8_t tileIndex = this->gameboy->memory->fetch8(OAM_OFFSET + i * 4 + 2);
-        uint8_t attributes = this->gameboy->memory->fetch8(OAM_OFFSET + i * 4 + 3);
+        uint8_t yPos = this->gameboy->memory->read8(OAM_OFFSET + spriteIndex * 4) - 16;
+        uint8_t xPos = this->gameboy->memory->read8(OAM_OFFSET + spriteIndex * 4 + 1) - 8;
+        uint8_t tileIndex = this->gameboy->memory->read8(OAM_OFFSET + i * 4 + 2);
+        uint8_t attributes = this->gameboy->memory->read8(OAM_OFFSET + i * 4 + 3);
 
         int tileY = currentLY - yPos;
 
@@ -388,40 +423,55 @@ void PPU::fetchSpriteData() {
             }
         }
 
-        uint16_t tileDataAddress = 0x8000 + (tileIndex * 16) + (tileY * 2);
-        uint8_t lowByte = this->gameboy->memory->fetch8(tileDataAddress);
-        uint8_t highByte = this->gameboy->memory->fetch8(tileDataAddress + 1);
+        // Sprites always use the "$8000 method"
+        const uint8_t* row = getTileRow(tileIndex, true, tileY);
 
-        uint8_t palette = (attributes & 0x10) ? this->gameboy->memory->fetch8(OBP1) : this->gameboy->memory->fetch8(OBP0);
+        uint8_t pixels[TILE_SIZE];
+        for (int x = 0; x < TILE_SIZE; x++) {
+            pixels[x] = attributes & 0x20 ? row[7 - x] : row[x]; // Horizontal flip
+        }
 
+        uint8_t palette = (attributes & 0x10) ? this->gameboy->memory->getIO(OBP1) : this->gameboy->memory->getIO(OBP0);
 
-        for (int x = 0; x < 8; x++) {
-            if (xPos + x < 0 || xPos + x >= SCREEN_WIDTH) continue;
+        // Pixels past the right edge of the screen are not drawn
+        if (xPos >= SCREEN_WIDTH) continue;
+        int count = xPos + TILE_SIZE > SCREEN_WIDTH ? SCREEN_WIDTH - xPos : TILE_SIZE;
 
-            int bit = attributes & 0x20 ? x : 7 - x; // Horizontal flip
+        // Transparent pixels and pixels behind a background color other than 0 are masked out
+        compositor.blendSprite(pixels, palette, attributes & 0x80, bgBuffer[currentLY] + xPos, framebuffer[currentLY].data() + xPos, count);
 
-            uint8_t colorIndex = ((highByte >> bit) & 0x01) << 1 | ((lowByte >> bit) & 0x01);
-            if (colorIndex == 0) continue; // Transparent
+        logger->log("Sprite ", spriteIndex, ", X: ", (int) xPos, ", Y: ", (int) currentLY);
+    }
+}
 
-            uint8_t color = (palette >> (colorIndex * 2)) & 0x03;
 
-            int pixelX = xPos + x;
-            uint8_t bgPixel = bgBuffer[currentLY][pixelX];
+/*
 
-            bool drawSprite = true;
+    Save states
 
-            if (attributes & 0x80) {
-                drawSprite = (bgPixel == 0);
-            }
+*/
 
-            if (drawSprite) {
-                framebuffer[currentLY][pixelX] = color;
-                if (logger != nullptr && color != 0) {
-                    *logger << "Sprite color: " + std::to_string(color) + 
-                                ", X: " + std::to_string(pixelX) + 
-                                ", Y: " + std::to_string(currentLY);
-                }
-            }
-        }
+void PPU::saveState(PPUState &state) const {
+    state.lineStart = lineStart;
+    state.currentLY = currentLY;
+    state.currentMode = static_cast<uint8_t>(currentMode);
+
+    for (int y = 0; y < SCREEN_HEIGHT; y++) {
+        memcpy(state.framebuffer[y], framebuffer[y].data(), SCREEN_WIDTH);
+        memcpy(state.bgBuffer[y], bgBuffer[y], SCREEN_WIDTH);
     }
-}
\ No newline at end of file
+}
+
+void PPU::loadState(const PPUState &state) {
+    lineStart = state.lineStart;
+    currentLY = state.currentLY;
+    currentMode = static_cast<Mode>(state.currentMode);
+
+    for (int y = 0; y < SCREEN_HEIGHT; y++) {
+        memcpy(framebuffer[y].data(), state.framebuffer[y], SCREEN_WIDTH);
+        memcpy(bgBuffer[y], state.bgBuffer[y], SCREEN_WIDTH);
+    }
+
+    // VRAM was replaced
+    invalidateTiles();
+}
@@ -6,6 +6,9 @@
 using namespace std;
 
 #include "../gameboy.hpp"
+#include "../sink/sink.hpp"
+
+#include "compositor.hpp"
 
 #define TILE_SIZE 8
 #define SCREEN_WIDTH 160
@@ -28,7 +31,22 @@ using namespace std;
 #define LY 0xFF44
 #define LYC 0xFF45
 
-typedef array<array<uint8_t, SCREEN_WIDTH>, SCREEN_HEIGHT> FrameBuffer; // Define a type for the framebuffer
+// Line timings, in dots (T-cycles)
+#define DOTS_PER_LINE 456
+#define OAM_SEARCH_DOTS 80
+#define DRAWING_END_DOT 252
+
+#define LINES_PER_FRAME 154
+
+// Tile data, 384 tiles of 16 bytes at 0x8000 - 0x97FF
+#define TILE_DATA_OFFSET 0x8000
+#define TILE_DATA_END 0x9800
+#define TILE_BYTES 16
+#define TILE_COUNT 384
+
+// Decoded tile, 2-bit color index of each pixel
+typedef uint8_t DecodedTile[TILE_SIZE][TILE_SIZE];
+
 
 // PPU Modes
 enum class Mode : uint8_t {
@@ -39,21 +57,36 @@ enum class Mode : uint8_t {
 };
 
 class Gameboy; // Forward declaration
-class SDLRenderer; // Forward declaration
+struct PPUState;
 
 class PPU {
 public:
     PPU(Gameboy* gameboy);
     ~PPU();
 
-    //// Advances the PPU by one cycle
-    void step(); 
+    // LCD enable / disable, called on LCDC writes
+    void enable();
+    void disable();
+
+    // Scheduled events
+    void onModeEvent(const uint64_t &timestamp); // OAM search -> Drawing -> HBlank
+    void onLineEvent(const uint64_t &timestamp); // End of line, LY increment
 
     void renderScanline(); // Renders a single scanline
     void drawBackground(); // Draws the background layer
     void drawWindow(); // Draws the window layer
     void drawSprites(); // Draws sprites
 
+    void renderLine(const int &line); // Renders a line with the current registers without changing LY, for benchmarks
+
+    // Save states, the tile cache is decoded again after a load
+    void saveState(PPUState &state) const;
+    void loadState(const PPUState &state);
+
+    // Tile cache invalidation, called on writes to the tile data
+    inline void invalidateTile(const uint16_t &address) { this->tileDirty[(address - TILE_DATA_OFFSET) / TILE_BYTES] = true; }
+    void invalidateTiles(); // Whole tile data changed
+
     /*
     
         Getters and Setters
@@ -65,6 +98,8 @@ public:
 
     inline const int& getCurrentLY() const { return this->currentLY; }
 
+    inline Compositor& getCompositor() { return this->compositor; }
+
 private:
     Gameboy* gameboy;
 
@@ -77,12 +112,26 @@ private:
     // PPU internal state
     int currentLY; // current scanline
     Mode currentMode; // Current PPU mode
+    uint64_t lineStart; // Master clock timestamp of the start of the current line
+
+    // Decoded tile cache, a tile is decoded again on its first use after a write
+    DecodedTile tileCache[TILE_COUNT];
+    bool tileDirty[TILE_COUNT];
+
+    // Vectorized palette lookups and sprite blending
+    Compositor compositor;
+
+    void startLine(const uint64_t &timestamp); // Start the current line and schedule its events
+    void setMode(const Mode &mode); // Set the mode and update STAT
 
     //Internal methods tbd
     void fetchBackgroundTileData();
     void fetchWindowTileData();
     void fetchSpriteData();
 
+    const uint8_t* getTileRow(const uint8_t &tileIndex, const bool &unsignedMode, const int &row); // Decoded row of a tile from the BG / window tile map
+    void decodeTile(const int &tile); // Decode a tile from VRAM into the cache
+
     
 
     void checkLYCInterrupt();
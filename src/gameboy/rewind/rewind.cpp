@@ -0,0 +1,244 @@
+#include <iostream>
+#include <stdint.h>
+#include <cstring>
+#include <vector>
+
+using namespace std;
+
+#include "../utils/utils.hpp"
+#include "../logging/logger/logger.hpp"
+
+#include "rewind.hpp"
+#include "../savestate/savestate.hpp"
+
+/*
+
+    Constructors and Destructors
+
+*/
+
+Rewind::Rewind(Gameboy* gameboy) : gameboy(gameboy), enabled(false), newest(nullptr), scratch(nullptr), hasNewest(false), deltas(), capacity(0), head(0), count(0), historyBytes(0) {
+    logger = gameboy->getMasterLogger()->getLogger("Rewind");
+    logger->log("Rewind Constructor");
+}
+
+Rewind::~Rewind() {
+    logger->log("Rewind Destructor");
+
+    delete this->newest;
+    delete this->scratch;
+
+    delete logger;
+}
+
+/*
+
+    Functions
+
+*/
+
+void Rewind::enable(const int &frames) {
+    this->capacity = frames > 0 ? frames : 1;
+    this->deltas.assign(this->capacity, vector<uint8_t>());
+
+    if(!this->newest) this->newest = new SaveState();
+    if(!this->scratch) this->scratch = new SaveState();
+
+    this->enabled = true;
+    this->reset();
+}
+
+void Rewind::disable() {
+    this->enabled = false;
+    this->gameboy->scheduler->cancel(Event::Rewind);
+
+    // Free the history
+    vector<vector<uint8_t>>().swap(this->deltas);
+    delete this->newest;
+    delete this->scratch;
+
+    this->newest = nullptr;
+    this->scratch = nullptr;
+    this->hasNewest = false;
+
+    this->capacity = 0;
+    this->head = 0;
+    this->count = 0;
+    this->historyBytes = 0;
+}
+
+void Rewind::reset() {
+    for(vector<uint8_t> &delta : this->deltas) vector<uint8_t>().swap(delta);
+
+    this->hasNewest = false;
+    this->head = 0;
+    this->count = 0;
+    this->historyBytes = 0;
+
+    // Capture from the next frame
+    if(this->enabled) this->scheduleFrame(this->gameboy->scheduler->getCycles());
+}
+
+void Rewind::scheduleFrame(const uint64_t &timestamp) {
+    this->gameboy->scheduler->schedule(Event::Rewind, timestamp + DOTS_PER_LINE * LINES_PER_FRAME);
+}
+
+void Rewind::onFrameEvent(const uint64_t &timestamp) {
+    // Event from a state loaded while not recording
+    if(!this->enabled) return;
+
+    // Accurate timing runs the events inside the instructions, the snapshot waits for the end of the instruction
+    if(this->gameboy->cpu->isInInstruction()) {
+        this->gameboy->scheduler->schedule(Event::Rewind, this->gameboy->scheduler->getCycles() + 4);
+        return;
+    }
+
+    // Next capture first, the snapshot holds the pending event
+    this->scheduleFrame(timestamp);
+
+    this->gameboy->saveState(*this->scratch);
+
+    if(this->hasNewest) {
+        // The slot after head receives the delta, the oldest frame is overwritten when the ring is full
+        if(this->count == this->capacity) this->dropOldest();
+
+        this->head = (this->head + 1) % this->capacity;
+        vector<uint8_t> &delta = this->deltas[this->head];
+
+        encodeDelta((const uint8_t*) this->scratch, (const uint8_t*) this->newest, sizeof(SaveState), delta);
+
+        this->count ++;
+        this->historyBytes += delta.capacity();
+
+        while(this->historyBytes > REWIND_MAX_BYTES && this->count > 1) this->dropOldest();
+    }
+
+    // The captured frame becomes the newest snapshot
+    SaveState* previous = this->newest;
+    this->newest = this->scratch;
+    this->scratch = previous;
+    this->hasNewest = true;
+}
+
+void Rewind::dropOldest() {
+    const int oldest = (this->head - this->count + 1 + this->capacity) % this->capacity;
+
+    this->historyBytes -= this->deltas[oldest].capacity();
+    vector<uint8_t>().swap(this->deltas[oldest]);
+
+    this->count --;
+}
+
+int Rewind::stepBack(const int &frames) {
+    if(!this->enabled || !this->hasNewest) return 0;
+
+    const int steps = frames < this->count ? frames : this->count;
+
+    // Undo the newest deltas, the frames after the restored one are dropped
+    for(int i = 0; i < steps; i++) {
+        vector<uint8_t> &delta = this->deltas[this->head];
+        applyDelta(delta, (uint8_t*) this->newest);
+
+        this->historyBytes -= delta.capacity();
+        vector<uint8_t>().swap(delta);
+
+        this->head = (this->head - 1 + this->capacity) % this->capacity;
+        this->count --;
+    }
+
+    this->gameboy->loadState(*this->newest, true);
+
+    logger->log("Rewound ", steps, " frames, ", this->count, " frames left");
+    return steps;
+}
+
+/*
+
+    Delta coding
+
+    A delta is a list of records: bytes to skip, run length, run bytes XORed with the other state
+    Both lengths are LEB128 varints, a frame usually changes a few hundred bytes out of the whole state
+
+*/
+
+static inline void writeVarint(vector<uint8_t> &out, size_t value) {
+    while(value >= 0x80) {
+        out.push_back((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+
+    out.push_back(value);
+}
+
+static inline size_t readVarint(const uint8_t* &in) {
+    size_t value = 0;
+    int shift = 0;
+
+    while(*in & 0x80) {
+        value |= (size_t) (*in++ & 0x7F) << shift;
+        shift += 7;
+    }
+
+    return value | ((size_t) *in++ << shift);
+}
+
+static inline bool equal8(const uint8_t* a, const uint8_t* b) {
+    uint64_t x, y;
+    memcpy(&x, a, 8);
+    memcpy(&y, b, 8);
+
+    return x == y;
+}
+
+void Rewind::encodeDelta(const uint8_t* from, const uint8_t* to, const size_t &size, vector<uint8_t> &out) {
+    out.clear();
+
+    size_t i = 0;
+    size_t last = 0;
+
+    while(i < size) {
+        // Skip the unchanged bytes, 8 at a time
+        while(i + 8 <= size && equal8(from + i, to + i)) i += 8;
+        while(i < size && from[i] == to[i]) i++;
+
+        if(i >= size) break;
+
+        // Changed run, ends on 8 unchanged bytes
+        const size_t start = i;
+        while(i < size && !(i + 8 <= size && equal8(from + i, to + i))) i++;
+
+        writeVarint(out, start - last);
+        writeVarint(out, i - start);
+        for(size_t j = start; j < i; j++) out.push_back(from[j] ^ to[j]);
+
+        last = i;
+    }
+
+    out.shrink_to_fit();
+}
+
+void Rewind::applyDelta(const vector<uint8_t> &delta, uint8_t* state) {
+    const uint8_t* in = delta.data();
+    const uint8_t* end = in + delta.size();
+
+    while(in < end) {
+        state += readVarint(in);
+
+        const size_t length = readVarint(in);
+        for(size_t i = 0; i < length; i++) state[i] ^= in[i];
+
+        state += length;
+        in += length;
+    }
+}
+
+/*
+
+    Getters
+
+*/
+
+size_t Rewind::getMemoryUsage() const {
+    const size_t snapshots = (this->newest ? sizeof(SaveState) : 0) + (this->scratch ? sizeof(SaveState) : 0);
+    return snapshots + this->historyBytes + this->deltas.capacity() * sizeof(vector<uint8_t>);
+}
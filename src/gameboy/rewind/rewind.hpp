@@ -0,0 +1,84 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+using namespace std;
+
+#include "../logging/log/log.hpp"
+
+#include "../gameboy.hpp"
+
+// Forward declaration
+class Gameboy;
+struct SaveState;
+
+// Default history, 60 seconds of frames
+#define REWIND_DEFAULT_FRAMES 3600
+
+// Memory budget of the compressed history, the oldest frames are dropped past it
+#define REWIND_MAX_BYTES (64 * 1024 * 1024)
+
+/*
+
+    Rewind, one snapshot per frame kept as the XOR delta to the next frame, run-length encoded
+    Only the newest snapshot is stored whole, stepping back applies the deltas to it newest first
+
+*/
+
+class Rewind {
+    public:
+        Rewind(Gameboy* gameboy);
+        ~Rewind();
+
+        // Start and stop recording, the history is dropped
+        void enable(const int &frames = REWIND_DEFAULT_FRAMES);
+        void disable();
+
+        // Drop the history, the machine state changed outside of the recording
+        void reset();
+
+        // Scheduled event, capture the frame
+        void onFrameEvent(const uint64_t &timestamp);
+
+        // Restore the state of frames ago, returns the number of frames actually rewound
+        int stepBack(const int &frames);
+
+        /*
+
+            Getters
+
+        */
+
+        inline bool isEnabled() const { return this->enabled; }
+        inline int getFrameCount() const { return this->count; } // Frames that can be rewound
+        inline int getCapacity() const { return this->capacity; }
+        size_t getMemoryUsage() const; // Bytes used by the snapshots and the history
+
+    private:
+        // Gameboy ref
+        Gameboy* gameboy;
+
+        Log* logger;
+
+        bool enabled;
+
+        // Snapshots, newest is the last captured frame, scratch receives the next one
+        SaveState* newest;
+        SaveState* scratch;
+        bool hasNewest;
+
+        // Ring of deltas, deltas[head] turns the newest snapshot into the previous frame
+        vector<vector<uint8_t>> deltas;
+        int capacity;
+        int head;
+        int count;
+        size_t historyBytes;
+
+        void scheduleFrame(const uint64_t &timestamp); // Next capture, one frame later
+        void dropOldest();
+
+        // Delta coding, runs of equal bytes are skipped, the others are stored XORed
+        static void encodeDelta(const uint8_t* from, const uint8_t* to, const size_t &size, vector<uint8_t> &out);
+        static void applyDelta(const vector<uint8_t> &delta, uint8_t* state);
+};
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <stdint.h>
+#include <type_traits>
+
+using namespace std;
+
+#include "../memory/memory.hpp"
+#include "../ppu/ppu.hpp"
+#include "../scheduler/scheduler.hpp"
+#include "../cartridge/cartridge.hpp"
+#include "../apu/apu.hpp"
+
+/*
+
+    Save states, the whole machine in one fixed layout structure
+    A file is the structure as is (host byte order), it is written and read with a single call, no per field parsing
+
+    Any change to the structures below must increase SAVE_STATE_VERSION
+
+*/
+
+#define SAVE_STATE_MAGIC 0x54534247 // "GBST"
+#define SAVE_STATE_VERSION 9
+
+// Largest cartridge RAM, 16 banks (MBC5)
+#define SAVE_STATE_RAM_SIZE (16 * RAM_BANK_SIZE)
+
+struct SaveStateHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t size; // sizeof(SaveState), catches a layout change without a version change
+    uint16_t romChecksum; // Global checksum of the cartridge header, states only load on the same ROM
+    uint8_t padding[6];
+};
+
+struct SchedulerState {
+    uint64_t cycles; // Master clock
+    uint64_t timestamps[EVENT_COUNT]; // Pending timestamp of each event, NO_EVENT if not scheduled
+};
+
+struct CPUState {
+    uint16_t sp, pc;
+    uint8_t a, f, b, c, d, e, h, l;
+    uint8_t ime;
+    uint8_t halted;
+    uint8_t padding[2];
+};
+
+struct TimerState {
+    uint64_t divStart; // Master clock when the divider counter was 0
+    uint64_t timerSync; // Master clock of the TIMA value
+    uint8_t timerCounter;
+    uint8_t timerModulo;
+    uint8_t timerControl;
+    uint8_t padding[5];
+};
+
+struct JoypadState {
+    uint64_t frame; // Latches since power on, the position in the input script
+    uint8_t buttons; // Latched
+    uint8_t lines; // Low lines as of the last update
+    uint8_t padding[6];
+};
+
+struct APUChannelState {
+    uint64_t next; // Master clock of the next waveform step
+    uint32_t period;
+    uint16_t length;
+    uint8_t enabled;
+    uint8_t position;
+    uint8_t volume;
+    uint8_t envelopeTimer;
+    uint8_t output;
+    uint8_t padding[5];
+};
+
+struct APUState {
+    APUChannelState channels[SOUND_CHANNELS];
+    uint64_t lastSync; // Master clock the channels are at
+    uint8_t registers[SOUND_REGISTERS]; // NR10 - NR52 and the wave RAM
+    uint16_t sweepShadow;
+    uint16_t lfsr;
+    uint8_t frameStep;
+    uint8_t sweepTimer;
+    uint8_t sweepEnabled;
+    uint8_t padding[1];
+};
+
+struct PPUState {
+    uint64_t lineStart;
+    int32_t currentLY;
+    uint8_t currentMode;
+    uint8_t padding[3];
+
+    uint8_t framebuffer[SCREEN_HEIGHT][SCREEN_WIDTH];
+    uint8_t bgBuffer[SCREEN_HEIGHT][SCREEN_WIDTH];
+};
+
+struct MemoryState {
+    uint8_t vram[VRAM_SIZE];
+    uint8_t wramFixed[WRAM_FIXED_SIZE];
+    uint8_t wramBanked[WRAM_BANKED_SIZE];
+    uint8_t oam[OAM_SIZE];
+    uint8_t io[IO_SIZE];
+    uint8_t hram[HRAM_SIZE];
+    uint8_t interruptEnable;
+    uint8_t dmaActive;
+    uint8_t dmaSource; // OAM DMA source page, the end of the transfer is a scheduler event
+};
+
+struct CartridgeState {
+    int64_t rtcLastTime;
+
+    uint16_t bankLow;
+    uint8_t bankHigh;
+    uint8_t ramEnabled;
+    uint8_t bankingMode;
+    uint8_t rtcLatch;
+    uint8_t rtc[5];
+    uint8_t rtcLatched[5];
+    uint8_t padding[8];
+
+    uint8_t ram[SAVE_STATE_RAM_SIZE]; // Only the banks of the cartridge are used
+};
+
+struct SaveState {
+    SaveStateHeader header;
+
+    SchedulerState scheduler;
+    CPUState cpu;
+    TimerState timer;
+    JoypadState joypad;
+    APUState apu;
+    PPUState ppu;
+    MemoryState memory;
+    CartridgeState cartridge;
+};
+
+static_assert(is_trivially_copyable<SaveState>::value, "Save states are copied as raw bytes");
+static_assert(sizeof(SaveState) == 194320, "Save state layout changed, increase SAVE_STATE_VERSION and update the size");
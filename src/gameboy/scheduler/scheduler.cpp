@@ -0,0 +1,119 @@
+#include <iostream>
+#include <stdint.h>
+#include <string>
+
+using namespace std;
+
+#include "../utils/utils.hpp"
+#include "../logging/logger/logger.hpp"
+
+#include "scheduler.hpp"
+#include "../savestate/savestate.hpp"
+
+/*
+
+    Constructors and Destructors
+
+*/
+
+Scheduler::Scheduler(Gameboy* gameboy) : gameboy(gameboy), cycles(0), events(), count(0), nextTimestamp(NO_EVENT) {
+    logger = gameboy->getMasterLogger()->getLogger("Scheduler");
+    logger->log("Scheduler Constructor");
+
+    for(int i = 0; i < EVENT_COUNT; i++) this->timestamps[i] = NO_EVENT;
+}
+
+Scheduler::~Scheduler() {
+    logger->log("Scheduler Destructor");
+
+    delete logger;
+}
+
+/*
+
+    Functions
+
+*/
+
+void Scheduler::schedule(const Event &event, const uint64_t &timestamp) {
+    this->cancel(event);
+
+    // Insert, keeping the events sorted by descending timestamp
+    int i = this->count;
+    while(i > 0 && this->events[i - 1].timestamp < timestamp) {
+        this->events[i] = this->events[i - 1];
+        i--;
+    }
+
+    this->events[i] = { timestamp, event };
+    this->count ++;
+
+    this->timestamps[(int) event] = timestamp;
+    this->nextTimestamp = this->events[this->count - 1].timestamp;
+}
+
+void Scheduler::cancel(const Event &event) {
+    if(this->timestamps[(int) event] == NO_EVENT) return;
+
+    // Remove the event
+    int i = 0;
+    while(this->events[i].event != event) i++;
+
+    for(; i < this->count - 1; i++) this->events[i] = this->events[i + 1];
+    this->count --;
+
+    this->timestamps[(int) event] = NO_EVENT;
+    this->nextTimestamp = this->count > 0 ? this->events[this->count - 1].timestamp : NO_EVENT;
+}
+
+void Scheduler::runEvents() {
+    while(this->count > 0 && this->events[this->count - 1].timestamp <= this->cycles) {
+        // Pop the next event, the handler may schedule it again
+        const ScheduledEvent next = this->events[this->count - 1];
+        this->count --;
+
+        this->timestamps[(int) next.event] = NO_EVENT;
+        this->nextTimestamp = this->count > 0 ? this->events[this->count - 1].timestamp : NO_EVENT;
+
+        this->dispatch(next.event, next.timestamp);
+    }
+}
+
+void Scheduler::dispatch(const Event &event, const uint64_t &timestamp) {
+    switch(event) {
+        case Event::PPUMode: this->gameboy->ppu->onModeEvent(timestamp); break;
+        case Event::PPULine: this->gameboy->ppu->onLineEvent(timestamp); break;
+        case Event::Rewind: this->gameboy->rewind->onFrameEvent(timestamp); break;
+        case Event::Timer: this->gameboy->timer->onOverflowEvent(timestamp); break;
+        case Event::DMA: this->gameboy->memory->onDmaEvent(timestamp); break;
+        case Event::Serial: this->gameboy->memory->onSerialEvent(timestamp); break;
+        case Event::APUFrame: this->gameboy->apu->onFrameEvent(timestamp); break;
+        case Event::Joypad: this->gameboy->joypad->onLatchEvent(timestamp); break;
+
+        default: logger->error("Unknown event ", (int) event); break;
+    }
+}
+
+/*
+
+    Save states
+
+*/
+
+void Scheduler::saveState(SchedulerState &state) const {
+    state.cycles = this->cycles;
+    for(int i = 0; i < EVENT_COUNT; i++) state.timestamps[i] = this->timestamps[i];
+}
+
+void Scheduler::loadState(const SchedulerState &state) {
+    this->cycles = state.cycles;
+
+    // Empty the queue, then post the pending events again
+    this->count = 0;
+    this->nextTimestamp = NO_EVENT;
+    for(int i = 0; i < EVENT_COUNT; i++) this->timestamps[i] = NO_EVENT;
+
+    for(int i = 0; i < EVENT_COUNT; i++) {
+        if(state.timestamps[i] != NO_EVENT) this->schedule((Event) i, state.timestamps[i]);
+    }
+}
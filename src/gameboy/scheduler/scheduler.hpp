@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "../logging/log/log.hpp"
+
+#include "../gameboy.hpp"
+
+// Forward declaration
+class Gameboy;
+struct SchedulerState;
+
+// Scheduled events, at most one pending occurrence per event
+enum class Event : uint8_t {
+    PPUMode, // OAM search -> Drawing -> HBlank transitions
+    PPULine, // End of line, LY increment, VBlank
+    Rewind, // Rewind snapshot, once per frame while recording
+    Timer, // TIMA overflow
+    DMA, // End of the OAM DMA transfer
+    Serial, // End of a serial transfer
+    APUFrame, // Frame sequencer tick, sound length, sweep and envelope
+    Joypad, // Buttons latched, once per frame
+
+    Count
+};
+
+#define EVENT_COUNT ((int) Event::Count)
+
+// No pending event
+#define NO_EVENT UINT64_MAX
+
+class Scheduler {
+    public:
+        Scheduler(Gameboy* gameboy);
+        ~Scheduler();
+
+        // Post an event at the given master clock timestamp (T-cycles), replaces the pending occurrence of the same event
+        void schedule(const Event &event, const uint64_t &timestamp);
+        void cancel(const Event &event);
+
+        // Run all the events whose deadline has been reached
+        void runEvents();
+
+        // Save states, the master clock and the pending events
+        void saveState(SchedulerState &state) const;
+        void loadState(const SchedulerState &state);
+
+        // Advance the master clock
+        inline void addCycles(const uint64_t &cycles) { this->cycles += cycles; }
+
+        /*
+
+            Getters
+
+        */
+
+        inline const uint64_t& getCycles() const { return this->cycles; }
+        inline const uint64_t& getNextTimestamp() const { return this->nextTimestamp; }
+        inline uint64_t* getClock() { return &this->cycles; } // Master clock updated in place by the JIT blocks
+
+        inline bool isScheduled(const Event &event) const { return this->timestamps[(int) event] != NO_EVENT; }
+        inline const uint64_t& getTimestamp(const Event &event) const { return this->timestamps[(int) event]; }
+
+    private:
+        // Gameboy ref
+        Gameboy* gameboy;
+
+        Log* logger;
+
+        // Master clock, T-cycles since power on
+        uint64_t cycles;
+
+        // Pending events sorted by descending timestamp, the next event is the last one
+        struct ScheduledEvent {
+            uint64_t timestamp;
+            Event event;
+        };
+
+        ScheduledEvent events[EVENT_COUNT];
+        int count;
+
+        uint64_t timestamps[EVENT_COUNT]; // Pending timestamp of each event, NO_EVENT if not scheduled
+        uint64_t nextTimestamp; // Deadline of the next event, NO_EVENT if none
+
+        void dispatch(const Event &event, const uint64_t &timestamp); // Call the event handler
+};
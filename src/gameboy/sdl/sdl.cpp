@@ -1,14 +1,20 @@
 #include <iostream>
+#include <cstring>
+#include <cmath>
 
 #include "../ppu/ppu.hpp"
 
+#include "sdl.hpp"
+
 #include <string>
 #include <filesystem>
 
-extern bool runMinishell;
+SDLRenderer::SDLRenderer(Gameboy* gameboy) : gameboy(gameboy), window(nullptr), keyStates(nullptr), refreshRate(DEFAULT_REFRESH_RATE), renderer(nullptr), texture(nullptr), audioDevice(0), closing(false), quitRequested(false), buttons(0), presentedFrames(0), droppedFrames(0), duplicatedFrames(0) {
+    // Texture colors (RGB888, 0x00RRGGBB) of the 4 shades
+    uint32_t colors[4];
+    for(int i = 0; i < 4; i++) colors[i] = (this->palette[i][0] << 16) | (this->palette[i][1] << 8) | this->palette[i][2];
 
-SDLRenderer::SDLRenderer() : window(nullptr), renderer(nullptr), texture(nullptr) {
-    this->gameboy = Gameboy::getInstance();
+    this->converter.setPalette(colors);
 }
 
 SDLRenderer::~SDLRenderer() {
@@ -18,50 +24,47 @@ SDLRenderer::~SDLRenderer() {
 bool SDLRenderer::initialize() {
     if(!ENABLE_RENDERING) return true;
     else {
-        // Inti sdl
-        if(SDL_Init(SDL_INIT_VIDEO | SDL_INIT_EVENTS) < 0) {
+        // Inti sdl, on the main thread with the window and the events
+        if(SDL_Init(SDL_INIT_VIDEO | SDL_INIT_EVENTS | (ENABLE_AUDIO ? SDL_INIT_AUDIO : 0)) < 0) {
             std::cerr << "SDL could not initialize! SDL_Error: " << SDL_GetError() << std::endl;
             return false;
         }
 
-        // Create window
-        int flags = SDL_WINDOW_BORDERLESS | SDL_WINDOW_HIDDEN;
-        this->window = SDL_CreateWindow("GameBoy", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, SCREEN_WIDTH * SCREEN_SCALE, SCREEN_HEIGHT * SCREEN_SCALE, flags);
-        if(!this->window) {
-            std::cerr << "Window could not be created! SDL_Error: " << SDL_GetError() << std::endl;
-            
+        if(!this->createWindow()) {
             cleanup();
             return false;
         }
 
-        // Create renderer
-        this->renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
-        if(!this->renderer) {
-            std::cerr << "Renderer could not be created! SDL_Error: " << SDL_GetError() << std::endl;
+        // Renderer on the presentation thread, the window is shown once it is cleared
+        future<bool> ready = this->presenterReady.get_future();
+        this->presenter = thread(&SDLRenderer::present, this);
 
+        if(!ready.get()) {
             cleanup();
             return false;
         }
 
-        // Rendering scale quality
-        SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "nearest");  // Use nearest neighbor scaling for pixelated look
+        SDL_ShowWindow(this->window);
+        this->lastEvents = chrono::steady_clock::now();
 
-        // texture that will be used to update the screen
-        this->texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGB888, SDL_TEXTUREACCESS_STREAMING, SCREEN_WIDTH, SCREEN_HEIGHT);
-        if(!this->texture) {
-            std::cerr << "Texture could not be created! SDL_Error: " << SDL_GetError() << std::endl;
+        // Audio output, stereo 16-bit, the emulation runs without sound if there is no device
+        if(ENABLE_AUDIO) {
+            SDL_AudioSpec desired = {}, obtained = {};
+            desired.freq = AUDIO_SAMPLE_RATE;
+            desired.format = AUDIO_S16SYS;
+            desired.channels = 2;
+            desired.samples = AUDIO_BUFFER_FRAMES;
+            desired.callback = SDLRenderer::audioCallback;
+            desired.userdata = this->gameboy->apu->getRing();
 
-            cleanup();
-            return false;
+            this->audioDevice = SDL_OpenAudioDevice(NULL, 0, &desired, &obtained, SDL_AUDIO_ALLOW_FREQUENCY_CHANGE);
+            if(!this->audioDevice) std::cerr << "Audio device could not be opened, no sound! SDL_Error: " << SDL_GetError() << std::endl;
+            else {
+                this->gameboy->apu->setSampleRate(obtained.freq);
+                SDL_PauseAudioDevice(this->audioDevice, 0);
+            }
         }
 
-        // Get key states
-        this->keyStates = SDL_GetKeyboardState(NULL);
-
-        // Pre render empty
-        SDL_RenderClear(this->renderer);
-        SDL_RenderPresent(this->renderer);
-
         return true;
     }
 }
@@ -69,42 +72,171 @@ bool SDLRenderer::initialize() {
 void SDLRenderer::render(const FrameBuffer &framebuffer) {
     if(!ENABLE_RENDERING) return;
     else {
-        // Update key states
-        SDL_PumpEvents();
-
-        // Temporary buffer
-        uint32_t pixelData[SCREEN_WIDTH * SCREEN_HEIGHT];
-        
-        // Convert 2-bit color indices 
-        for(uint8_t y = 0; y < SCREEN_HEIGHT; y++) {
-            for(uint8_t x = 0; x < SCREEN_WIDTH; x++) {
-                uint8_t* color = this->palette[framebuffer[y][x]];
-                pixelData[y * SCREEN_WIDTH + x] = (color[0] << 16) | (color[1] << 8) | color[2];
-            }
+        // Newest frame, replaces the one published before if the presentation thread did not take it
+        this->frames.getBack() = framebuffer;
+        if(!this->frames.publish()) this->droppedFrames.fetch_add(1, memory_order_relaxed);
+
+        // Without the lock, a wake up missed in between is caught by the timeout of the presentation thread
+        this->frameReady.notify_one();
+
+        // Events on this thread, at most every interval when the emulation runs faster than real time
+        const chrono::steady_clock::time_point now = chrono::steady_clock::now();
+        if(now - this->lastEvents >= PRESENT_EVENT_INTERVAL) {
+            this->lastEvents = now;
+            this->handleEvents();
         }
+    }
+}
 
-        // Update texture 
-        SDL_UpdateTexture(this->texture, NULL, pixelData, SCREEN_WIDTH * sizeof(uint32_t));
-        
-        // Clear screen
-        SDL_RenderClear(this->renderer);
-        
-        // Render texture
-        SDL_RenderCopy(this->renderer, this->texture, NULL, NULL);
+uint8_t SDLRenderer::getButtons() {
+    if(!ENABLE_RENDERING) return 0;
 
-        // Show window
-        SDL_ShowWindow(this->window);
-        
-        // Update screen
-        SDL_RenderPresent(this->renderer);
+    // Read from the keyboard state each time the events are handled
+    return this->buttons;
+}
+
+/*
+
+    Window
+
+*/
 
-        // Handle SDL events
-        this->handleEvents();
+bool SDLRenderer::createWindow() {
+    // Create window, shown once the presentation thread cleared it
+    int flags = SDL_WINDOW_BORDERLESS | SDL_WINDOW_HIDDEN;
+    this->window = SDL_CreateWindow("GameBoy", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, SCREEN_WIDTH * SCREEN_SCALE, SCREEN_HEIGHT * SCREEN_SCALE, flags);
+    if(!this->window) {
+        std::cerr << "Window could not be created! SDL_Error: " << SDL_GetError() << std::endl;
+        return false;
     }
+
+    // Display refresh, for the duplicated frames of the presentation thread
+    SDL_DisplayMode mode;
+    if(SDL_GetCurrentDisplayMode(SDL_GetWindowDisplayIndex(this->window), &mode) == 0 && mode.refresh_rate > 0) this->refreshRate = mode.refresh_rate;
+
+    // Get key states
+    this->keyStates = SDL_GetKeyboardState(NULL);
+
+    return true;
 }
 
-void SDLRenderer::handleEvents() {
-    SDL_Event e;
+void SDLRenderer::destroyWindow() {
+    if (window) {
+        SDL_DestroyWindow(window);
+        window = nullptr;
+    }
+}
+
+/*
+
+    Presentation thread
+
+*/
+
+void SDLRenderer::present() {
+    const bool created = this->createRenderer();
+    this->presenterReady.set_value(created);
+
+    if(!created) {
+        this->destroyRenderer();
+        return;
+    }
+
+    // A frame that stays on screen longer than a display refresh is shown again
+    const chrono::duration<double> refreshPeriod(1.0 / this->refreshRate);
+
+    chrono::steady_clock::time_point lastFrame;
+    bool hasLastFrame = false;
+
+    while(!this->closing.load(memory_order_acquire)) {
+        // Next frame
+        {
+            unique_lock<mutex> lock(this->frameMutex);
+            this->frameReady.wait_for(lock, PRESENT_WAKE_INTERVAL, [this] { return this->frames.hasNew() || this->closing.load(memory_order_relaxed); });
+        }
+
+        if(!this->frames.acquire()) continue;
+
+        // Refreshes since the last frame, all but one showed it again
+        const chrono::steady_clock::time_point now = chrono::steady_clock::now();
+        if(hasLastFrame && now - lastFrame < PRESENT_PAUSE_GAP) {
+            const long refreshes = lround((now - lastFrame) / refreshPeriod);
+            if(refreshes > 1) this->duplicatedFrames.fetch_add(refreshes - 1, memory_order_relaxed);
+        }
+
+        lastFrame = now;
+        hasLastFrame = true;
+
+        this->draw(this->frames.getFront());
+        this->presentedFrames.fetch_add(1, memory_order_relaxed);
+    }
+
+    this->destroyRenderer();
+}
+
+bool SDLRenderer::createRenderer() {
+    // Create renderer, a vsynced present only blocks this thread
+    this->renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | (ENABLE_VSYNC ? SDL_RENDERER_PRESENTVSYNC : 0));
+    if(!this->renderer) {
+        std::cerr << "Renderer could not be created! SDL_Error: " << SDL_GetError() << std::endl;
+        return false;
+    }
+
+    // Rendering scale quality
+    SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "nearest");  // Use nearest neighbor scaling for pixelated look
+
+    // texture that will be used to update the screen
+    this->texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGB888, SDL_TEXTUREACCESS_STREAMING, SCREEN_WIDTH, SCREEN_HEIGHT);
+    if(!this->texture) {
+        std::cerr << "Texture could not be created! SDL_Error: " << SDL_GetError() << std::endl;
+        return false;
+    }
+
+    // Pre render empty
+    SDL_RenderClear(this->renderer);
+    SDL_RenderPresent(this->renderer);
+
+    return true;
+}
+
+void SDLRenderer::destroyRenderer() {
+    if (texture) {
+        SDL_DestroyTexture(texture);
+        texture = nullptr;
+    }
+    
+    if (renderer) {
+        SDL_DestroyRenderer(renderer);
+        renderer = nullptr;
+    }
+}
+
+void SDLRenderer::draw(const FrameBuffer &framebuffer) {
+    // Written straight into the texture, only the rows that changed since the last frame (none for a still frame)
+    int first, last;
+    if(this->converter.findChangedRows(framebuffer, first, last)) {
+        const SDL_Rect rect = { 0, first, SCREEN_WIDTH, last - first + 1 };
+
+        void* pixels;
+        int pitch;
+        if(SDL_LockTexture(this->texture, &rect, &pixels, &pitch) == 0) {
+            this->converter.convert(framebuffer, first, last, (uint8_t*) pixels, pitch);
+            SDL_UnlockTexture(this->texture);
+        }
+    }
+
+    // Clear screen
+    SDL_RenderClear(this->renderer);
+    
+    // Render texture
+    SDL_RenderCopy(this->renderer, this->texture, NULL, NULL);
+
+    // Update screen
+    SDL_RenderPresent(this->renderer);
+}
+
+uint8_t SDLRenderer::readButtons() const {
+    // Key mapping:
     // up -> up arrow on qwerty
     // down -> down arrow on qwerty
     // left -> left arrow on qwerty
@@ -114,113 +246,74 @@ void SDLRenderer::handleEvents() {
     // b -> x on qwerty
     // start -> enter on qwerty
     // select -> s on qwerty
-    while(SDL_PollEvent(&e)) {
-        // Joypad input handling
-        // uint8_t& joypadRegister = (uint8_t&)this->gameboy->memory->fetch8(0xFF00);
 
+    uint8_t buttons = 0;
+
+    if(this->keyStates[SDL_SCANCODE_RIGHT]) buttons |= (uint8_t) Button::Right;
+    if(this->keyStates[SDL_SCANCODE_LEFT]) buttons |= (uint8_t) Button::Left;
+    if(this->keyStates[SDL_SCANCODE_UP]) buttons |= (uint8_t) Button::Up;
+    if(this->keyStates[SDL_SCANCODE_DOWN]) buttons |= (uint8_t) Button::Down;
+
+    if(this->keyStates[SDL_SCANCODE_Z]) buttons |= (uint8_t) Button::A;
+    if(this->keyStates[SDL_SCANCODE_X]) buttons |= (uint8_t) Button::B;
+    if(this->keyStates[SDL_SCANCODE_S]) buttons |= (uint8_t) Button::Select;
+    if(this->keyStates[SDL_SCANCODE_RETURN]) buttons |= (uint8_t) Button::Start;
+
+    return buttons;
+}
+
+void SDLRenderer::handleEvents() {
+    SDL_Event e;
+
+    while(SDL_PollEvent(&e)) {
         // Key down events
         if (e.type == SDL_KEYDOWN) {
             switch (e.key.keysym.sym) {
                 //esc key
                 case SDLK_ESCAPE:
-                    runMinishell = false;
+                    this->quitRequested = true;
                     this->gameboy->stop();
                     break;
                 //space bar
                 case SDLK_SPACE:
                     this->gameboy->stop();
                     break;
-                    
-                // // Direction keys
-                // case SDLK_DOWN:    // DOWN
-                //     if (!(joypadRegister & 0x10)) joypadRegister &= ~0x08;
-                //     this->gameboy->cpu->triggerInterrupt(Interrupt::Joypad);
-                //     break;
-                // case SDLK_UP:  // UP
-                //     if (!(joypadRegister & 0x10)) joypadRegister &= ~0x04; 
-                //     this->gameboy->cpu->triggerInterrupt(Interrupt::Joypad);
-                //     break;
-                // case SDLK_LEFT:  // Left
-                //     if (!(joypadRegister & 0x10)) joypadRegister &= ~0x02; 
-                //     this->gameboy->cpu->triggerInterrupt(Interrupt::Joypad);
-                //     break;
-                // case SDLK_RIGHT: // Right
-                //     if (!(joypadRegister & 0x10)) joypadRegister &= ~0x01; 
-                //     this->gameboy->cpu->triggerInterrupt(Interrupt::Joypad);
-                //     break;
-
-                // // Action keys
-                // case SDLK_RETURN: // Start button
-                //     if (!(joypadRegister & 0x20)) joypadRegister &= ~0x08; 
-                //     this->gameboy->cpu->triggerInterrupt(Interrupt::Joypad);
-                //     break;
-                // case SDLK_s:     // Select button
-                //     if (!(joypadRegister & 0x20)) joypadRegister &= ~0x04; 
-                //     this->gameboy->cpu->triggerInterrupt(Interrupt::Joypad);
-                //     break;
-                // case SDLK_x:     // B button
-                //     if (!(joypadRegister & 0x20)) joypadRegister &= ~0x02; 
-                //     this->gameboy->cpu->triggerInterrupt(Interrupt::Joypad);
-                //     break;    
-                // case SDLK_z:     // A button
-                //     if (!(joypadRegister & 0x20)) joypadRegister &= ~0x01; 
-                //     this->gameboy->cpu->triggerInterrupt(Interrupt::Joypad);
-                //     break;
             }
         }
-        
-        // // Key up events
-        // if (e.type == SDL_KEYUP) {
-        //     switch (e.key.keysym.sym) {
-        //         // Direction keys
-        //         case SDLK_DOWN:
-        //             if (!(joypadRegister & 0x10)) joypadRegister |= 0x08;
-        //             break;
-        //         case SDLK_UP:
-        //             if (!(joypadRegister & 0x10)) joypadRegister |= 0x04;
-        //             break;
-        //         case SDLK_LEFT:
-        //             if (!(joypadRegister & 0x10)) joypadRegister |= 0x02;
-        //             break;
-        //         case SDLK_RIGHT:
-        //             if (!(joypadRegister & 0x10)) joypadRegister |= 0x01;
-        //             break;
-
-        //         // Action keys
-        //         case SDLK_RETURN: // Start button
-        //             if (!(joypadRegister & 0x20)) joypadRegister |= 0x08;
-        //             break;
-        //         case SDLK_s:     // Select button
-        //             if (!(joypadRegister & 0x20)) joypadRegister |= 0x04;
-        //             break;
-        //         case SDLK_x:     // B button
-        //             if (!(joypadRegister & 0x20)) joypadRegister |= 0x02;
-        //             break;
-        //         case SDLK_z:     // A button
-        //             if (!(joypadRegister & 0x20)) joypadRegister |= 0x01;
-        //         break;
-        //     }
-        // }
     }
+
+    // Keyboard state of the events handled, the joypad latches it once per frame
+    this->buttons = this->readButtons();
 }
 
 
 
+void SDLRenderer::audioCallback(void* userdata, Uint8* stream, int length) {
+    AudioRing* ring = (AudioRing*) userdata;
+
+    AudioFrame* frames = (AudioFrame*) stream;
+    const size_t count = length / sizeof(AudioFrame);
+
+    // Audio thread, the emulation thread is never waited for, what is missing is silence
+    const size_t read = ring->pop(frames, count);
+    memset(frames + read, 0, (count - read) * sizeof(AudioFrame));
+}
+
 void SDLRenderer::cleanup() {
-    if (texture) {
-        SDL_DestroyTexture(texture);
-        texture = nullptr;
+    if(audioDevice) {
+        SDL_CloseAudioDevice(audioDevice);
+        audioDevice = 0;
     }
-    
-    if (renderer) {
-        SDL_DestroyRenderer(renderer);
-        renderer = nullptr;
-    }
-    
-    if (window) {
-        SDL_DestroyWindow(window);
-        window = nullptr;
+
+    // The presentation thread destroys the renderer it created, then the window goes
+    if(this->presenter.joinable()) {
+        this->closing.store(true, memory_order_release);
+        this->frameReady.notify_one();
+
+        this->presenter.join();
     }
+
+    this->destroyWindow();
     
     SDL_Quit();
 }
\ No newline at end of file
@@ -2,51 +2,127 @@
 
 #include <array>
 #include <cstdint>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <chrono>
 
 #include "SDL2/SDL.h"
 
 #include "../gameboy.hpp"
+#include "../sink/sink.hpp"
+#include "../sink/triple.hpp"
+#include "../sink/converter.hpp"
 
 #include "../../constants/constants.hpp"
 
-typedef array<array<uint8_t, SCREEN_WIDTH>, SCREEN_HEIGHT> FrameBuffer; // Define a type for the framebuffer
+// Shortest time between two event pumps of the emulation thread, the events are handled while it runs
+#define PRESENT_EVENT_INTERVAL chrono::milliseconds(10)
 
-class SDLRenderer {
+// Longest wait of the presentation thread, a frame published between its check and its wait is caught after it
+#define PRESENT_WAKE_INTERVAL chrono::milliseconds(10)
+
+// Longer gap between two frames, the emulation was stopped and the frame shown again is not counted as duplicated
+#define PRESENT_PAUSE_GAP chrono::milliseconds(250)
+
+// Refresh rate when the display does not tell it, Hz
+#define DEFAULT_REFRESH_RATE 60
+
+/*
+
+    SDL frontend, the window and the events stay on the main thread (the emulation thread), SDL requires it for video and events
+    The PPU publishes each finished frame through a triple buffer and goes on, a presentation thread owns the renderer and converts,
+    uploads and presents the newest one: a slow or vsynced present never stalls the emulation
+    The renderer is used from the thread that created it, this works with the OpenGL and Direct3D backends but not on macOS,
+    where rendering is only allowed on the main thread
+
+*/
+
+class SDLRenderer : public Sink {
     public:
-        SDLRenderer();
+        SDLRenderer(Gameboy* gameboy);
         ~SDLRenderer();
 
-        // Initialize SDL
+        // Initialize SDL and the window, starts the presentation thread and waits for its renderer
         bool initialize();
 
-        // Render framebuffer (from ppu)
-        void render(const FrameBuffer &framebuffer);
+        // Publish the framebuffer (from ppu) and handle the events, emulation thread
+        void render(const FrameBuffer &framebuffer) override;
 
-        // SDL events
-        void handleEvents();
+        // Joypad buttons from the keyboard, as of the last events handled
+        uint8_t getButtons() override;
 
-        // Clean up
+        // Clean up, stops the presentation thread, main thread
         void cleanup();
 
-        // Key states
-        const Uint8* keyStates;
+        // Audio device callback, pops the samples of the APU ring, silence when it runs out
+        static void audioCallback(void* userdata, Uint8* stream, int length);
+
+        // Escape pressed, the frontend should exit
+        inline bool isQuitRequested() const { return this->quitRequested; }
+        inline bool hasAudio() const { return this->audioDevice != 0; }
+
+        /*
+
+            Frame counters
+
+        */
 
-        // Getter
-        const Uint8* getKeyStates() { 
-            // Update key states
-            SDL_PumpEvents();
-            return this->keyStates; 
-        }
+        inline uint64_t getPresentedFrames() const { return this->presentedFrames.load(memory_order_relaxed); }
+        inline uint64_t getDroppedFrames() const { return this->droppedFrames.load(memory_order_relaxed); } // Published and replaced before being presented
+        inline uint64_t getDuplicatedFrames() const { return this->duplicatedFrames.load(memory_order_relaxed); } // Display refreshes that showed the same frame again
 
     private:
         // Gameboy instance
         Gameboy* gameboy;
         
-        // Window and renderer
+        // Window and key states, main thread
         SDL_Window* window;
+        const Uint8* keyStates;
+        int refreshRate;
+
+        // Renderer, only used by the presentation thread
         SDL_Renderer* renderer;
         SDL_Texture* texture;
 
+        // Audio output, 0 if none
+        SDL_AudioDeviceID audioDevice;
+
+        // Presentation thread, it is woken up by each frame
+        thread presenter;
+        promise<bool> presenterReady; // Renderer created or not
+        atomic<bool> closing;
+
+        TripleBuffer<FrameBuffer> frames;
+        FrameConverter converter; // Presentation thread
+        mutex frameMutex;
+        condition_variable frameReady;
+
+        // Events, main thread
+        chrono::steady_clock::time_point lastEvents;
+        bool quitRequested;
+        uint8_t buttons;
+
+        atomic<uint64_t> presentedFrames;
+        atomic<uint64_t> droppedFrames;
+        atomic<uint64_t> duplicatedFrames;
+
+        // Window, main thread
+        bool createWindow();
+        void destroyWindow();
+
+        // Presentation thread
+        void present();
+        bool createRenderer();
+        void destroyRenderer();
+        void draw(const FrameBuffer &framebuffer); // Convert the changed rows into the texture and present
+
+        // SDL events and keyboard, main thread
+        void handleEvents();
+        uint8_t readButtons() const;
+
         // Color palette 
         // 0: white
         // 1: light
@@ -0,0 +1,159 @@
+#include <cstdint>
+#include <cstring>
+
+using namespace std;
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CONVERTER_X86 true
+#include <immintrin.h>
+#else
+#define CONVERTER_X86 false
+#endif
+
+#include "converter.hpp"
+
+/*
+
+    Scalar, any CPU
+
+*/
+
+static void expandScalar(const uint8_t* indexes, const uint32_t* colors, uint32_t* out, const int &count) {
+    for(int i = 0; i < count; i++) out[i] = colors[indexes[i] & 0x03];
+}
+
+#if CONVERTER_X86
+
+/*
+
+    SSE2, 16 pixels at a time, part of the x86-64 baseline
+
+*/
+
+// Table lookup without shuffle, each color index selects its color with a compare mask
+static inline __m128i lookupSSE2(const __m128i &indexes, const __m128i* colors) {
+    __m128i pixels = _mm_setzero_si128();
+
+    for(int i = 0; i < 4; i++) pixels = _mm_or_si128(pixels, _mm_and_si128(_mm_cmpeq_epi32(indexes, _mm_set1_epi32(i)), colors[i]));
+
+    return pixels;
+}
+
+static void expandSSE2(const uint8_t* indexes, const uint32_t* colors, uint32_t* out, const int &count) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i mask = _mm_set1_epi8(0x03);
+
+    const __m128i table[4] = { _mm_set1_epi32(colors[0]), _mm_set1_epi32(colors[1]), _mm_set1_epi32(colors[2]), _mm_set1_epi32(colors[3]) };
+
+    int i = 0;
+
+    for(; i + 16 <= count; i += 16) {
+        const __m128i bytes = _mm_and_si128(_mm_loadu_si128((const __m128i*) (indexes + i)), mask);
+
+        // Bytes to 32-bit lanes, 4 pixels per register
+        const __m128i low = _mm_unpacklo_epi8(bytes, zero);
+        const __m128i high = _mm_unpackhi_epi8(bytes, zero);
+
+        _mm_storeu_si128((__m128i*) (out + i), lookupSSE2(_mm_unpacklo_epi16(low, zero), table));
+        _mm_storeu_si128((__m128i*) (out + i + 4), lookupSSE2(_mm_unpackhi_epi16(low, zero), table));
+        _mm_storeu_si128((__m128i*) (out + i + 8), lookupSSE2(_mm_unpacklo_epi16(high, zero), table));
+        _mm_storeu_si128((__m128i*) (out + i + 12), lookupSSE2(_mm_unpackhi_epi16(high, zero), table));
+    }
+
+    expandScalar(indexes + i, colors, out + i, count - i);
+}
+
+/*
+
+    AVX2, 8 pixels per permute, the 4 colors are the table of a cross-lane permute
+
+*/
+
+__attribute__((target("avx2")))
+static void expandAVX2(const uint8_t* indexes, const uint32_t* colors, uint32_t* out, const int &count) {
+    // Indexes 4 - 7 are not used, the color indexes are masked
+    const __m256i table = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i*) colors));
+    const __m256i mask = _mm256_set1_epi32(0x03);
+
+    int i = 0;
+
+    for(; i + 8 <= count; i += 8) {
+        const __m256i lanes = _mm256_and_si256(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*) (indexes + i))), mask);
+        _mm256_storeu_si256((__m256i*) (out + i), _mm256_permutevar8x32_epi32(table, lanes));
+    }
+
+    for(; i < count; i++) out[i] = colors[indexes[i] & 0x03];
+}
+
+#endif
+
+/*
+
+    Constructors and Destructors
+
+*/
+
+FrameConverter::FrameConverter() : colors(), lastFrame(), hasLastFrame(false) {
+    this->setLevel(Compositor::getSupportedLevel());
+}
+
+/*
+
+    Functions
+
+*/
+
+void FrameConverter::setPalette(const uint32_t colors[4]) {
+    memcpy(this->colors, colors, sizeof(this->colors));
+    this->hasLastFrame = false;
+}
+
+bool FrameConverter::findChangedRows(const FrameBuffer &frame, int &first, int &last) const {
+    if(!this->hasLastFrame) {
+        first = 0;
+        last = SCREEN_HEIGHT - 1;
+        return true;
+    }
+
+    first = 0;
+    while(first < SCREEN_HEIGHT && memcmp(frame[first].data(), this->lastFrame[first].data(), SCREEN_WIDTH) == 0) first ++;
+    if(first == SCREEN_HEIGHT) return false;
+
+    last = SCREEN_HEIGHT - 1;
+    while(last > first && memcmp(frame[last].data(), this->lastFrame[last].data(), SCREEN_WIDTH) == 0) last --;
+
+    return true;
+}
+
+void FrameConverter::convert(const FrameBuffer &frame, const int &first, const int &last, uint8_t* pixels, const int &pitch) {
+    for(int y = first; y <= last; y++) {
+        (*this->expandFunction)(frame[y].data(), this->colors, (uint32_t*) (pixels + (y - first) * pitch), SCREEN_WIDTH);
+        this->lastFrame[y] = frame[y];
+    }
+
+    // Rows out of the range are the same as the last frame
+    this->hasLastFrame = true;
+}
+
+/*
+
+    Getters and Setters
+
+*/
+
+bool FrameConverter::setLevel(const SimdLevel &level) {
+    if(level > Compositor::getSupportedLevel()) return false;
+
+    this->level = level;
+
+    switch(level) {
+#if CONVERTER_X86
+        case SimdLevel::AVX2: this->expandFunction = &expandAVX2; break;
+        case SimdLevel::SSE2: this->expandFunction = &expandSSE2; break;
+#endif
+
+        default: this->expandFunction = &expandScalar; break;
+    }
+
+    return true;
+}
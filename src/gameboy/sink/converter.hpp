@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+
+using namespace std;
+
+#include "sink.hpp"
+
+#include "../ppu/compositor.hpp"
+
+// Expansion of a run of color indexes to 32-bit colors through the 4 entry table
+typedef void (*ExpandFunction)(const uint8_t* indexes, const uint32_t* colors, uint32_t* out, const int &count);
+
+/*
+
+    Frame converter, color indexes to 32-bit pixels for the video output
+    The rows are compared with the last frame converted, only the changed ones have to be written to the texture
+
+*/
+
+class FrameConverter {
+public:
+    FrameConverter();
+
+    // 32-bit color of each shade, the next frame is converted whole
+    void setPalette(const uint32_t colors[4]);
+
+    // First and last rows that differ from the last frame converted, false if the frame is the same
+    bool findChangedRows(const FrameBuffer &frame, int &first, int &last) const;
+
+    // Rows first to last to 32-bit pixels, the first row is written at pixels, kept as the last frame
+    void convert(const FrameBuffer &frame, const int &first, const int &last, uint8_t* pixels, const int &pitch);
+
+    /*
+
+        Getters and Setters
+
+    */
+
+    inline const SimdLevel& getLevel() const { return this->level; }
+    bool setLevel(const SimdLevel &level); // False if the CPU does not support it
+
+private:
+    SimdLevel level;
+    ExpandFunction expandFunction;
+
+    alignas(32) uint32_t colors[4];
+
+    FrameBuffer lastFrame;
+    bool hasLastFrame;
+};
@@ -0,0 +1,34 @@
+#include <string>
+#include <cstdio>
+
+using namespace std;
+
+#include "sink.hpp"
+
+/*
+
+    Capture sink
+
+*/
+
+CaptureSink::CaptureSink() : frame(), frameCount(0), buttons(0) {}
+
+void CaptureSink::render(const FrameBuffer &framebuffer) {
+    this->frame = framebuffer;
+    this->frameCount ++;
+}
+
+bool CaptureSink::writePGM(const string &path) const {
+    FILE* file = fopen(path.c_str(), "wb");
+    if(!file) return false;
+
+    fprintf(file, "P5 %d %d 255\n", SCREEN_WIDTH, SCREEN_HEIGHT);
+
+    // Color index 0 is the lightest shade
+    for(const auto &line : this->frame) {
+        for(const uint8_t &pixel : line) fputc(255 - pixel * 85, file);
+    }
+
+    fclose(file);
+    return true;
+}
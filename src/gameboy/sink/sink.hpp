@@ -0,0 +1,89 @@
+#pragma once
+
+#include <array>
+#include <string>
+#include <cstdint>
+
+using namespace std;
+
+#include "../../constants/constants.hpp"
+
+typedef array<array<uint8_t, SCREEN_WIDTH>, SCREEN_HEIGHT> FrameBuffer; // Define a type for the framebuffer
+
+// Joypad buttons, bit set when pressed
+enum class Button : uint8_t {
+    Right = 0x1,
+    Left = 0x1 << 1,
+    Up = 0x1 << 2,
+    Down = 0x1 << 3,
+    A = 0x1 << 4,
+    B = 0x1 << 5,
+    Select = 0x1 << 6,
+    Start = 0x1 << 7
+};
+
+/*
+
+    Video output, serial output and joypad input of a Gameboy, implemented by the frontends (SDL, headless)
+
+*/
+
+class Sink {
+    public:
+        virtual ~Sink() {}
+
+        // Called once per frame with the finished framebuffer
+        virtual void render(const FrameBuffer &framebuffer) = 0;
+
+        // Pressed buttons, see Button, read by the joypad once per frame
+        virtual uint8_t getButtons() = 0;
+
+        // Byte sent on the serial port, test ROMs print their results there
+        virtual void serial(const uint8_t &) {}
+};
+
+/*
+
+    Null sink, drops the frames and no button is pressed
+
+*/
+
+class NullSink : public Sink {
+    public:
+        inline void render(const FrameBuffer &) override {}
+        inline uint8_t getButtons() override { return 0; }
+};
+
+/*
+
+    Capture sink, keeps the last frame and the number of frames, buttons can be set by the caller
+
+*/
+
+class CaptureSink : public Sink {
+    public:
+        CaptureSink();
+
+        void render(const FrameBuffer &framebuffer) override;
+        inline uint8_t getButtons() override { return this->buttons; }
+
+        inline void setButtons(const uint8_t &buttons) { this->buttons = buttons; }
+
+        // Write the last frame as a binary PGM image
+        bool writePGM(const string &path) const;
+
+        /*
+
+            Getters
+
+        */
+
+        inline const FrameBuffer& getFrame() const { return this->frame; }
+        inline const uint64_t& getFrameCount() const { return this->frameCount; }
+
+    private:
+        FrameBuffer frame;
+        uint64_t frameCount;
+
+        uint8_t buttons;
+};
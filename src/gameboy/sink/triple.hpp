@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+using namespace std;
+
+/*
+
+    Triple buffer, lock-free, one producer and one consumer
+    The producer writes the back slot and swaps it with the middle one, the consumer swaps the middle slot with its front one
+    when it holds a newer item: neither side ever waits, the producer overwrites an item the consumer did not take
+
+*/
+
+template<typename T>
+class TripleBuffer {
+    public:
+        TripleBuffer() : middle(1), back(0), front(2) {}
+
+        // Producer side, the slot written before publishing it
+        inline T& getBack() { return this->slots[this->back]; }
+
+        // Producer side, the back slot becomes the newest item, false if the previous one was never taken (dropped)
+        bool publish() {
+            const uint8_t previous = this->middle.exchange(this->back | TRIPLE_FRESH, memory_order_acq_rel);
+            this->back = previous & TRIPLE_INDEX;
+
+            return !(previous & TRIPLE_FRESH);
+        }
+
+        // Consumer side, the newest item becomes the front slot, false if the front slot is already the newest
+        bool acquire() {
+            if(!this->hasNew()) return false;
+
+            this->front = this->middle.exchange(this->front, memory_order_acq_rel) & TRIPLE_INDEX;
+            return true;
+        }
+
+        inline bool hasNew() const { return this->middle.load(memory_order_acquire) & TRIPLE_FRESH; }
+
+        // Consumer side, the last item taken
+        inline const T& getFront() const { return this->slots[this->front]; }
+
+    private:
+        // Slot index of the middle item, with the fresh bit set by publish and cleared by acquire
+        static constexpr uint8_t TRIPLE_INDEX = 0x3;
+        static constexpr uint8_t TRIPLE_FRESH = 0x4;
+
+        alignas(64) atomic<uint8_t> middle;
+
+        // Each one only used by its side
+        alignas(64) uint8_t back;
+        alignas(64) uint8_t front;
+
+        T slots[3];
+};
@@ -9,23 +9,29 @@ using namespace std;
 
 #include "timer.hpp"
 #include "../../gameboy/gameboy.hpp"
+#include "../savestate/savestate.hpp"
 
 // forward declaration
 class Gameboy;
 
+// Divider bit whose falling edge increments TIMA, by clock select: 4096 Hz, 262144 Hz, 65536 Hz, 16384 Hz
+static const int clockShifts[4] = { 10, 4, 6, 8 };
+
 /*
-    
+
     Constructors and Destructors
 
 */
 
-Timer::Timer(Gameboy* gameboy) : gameboy(gameboy), dividerCounter(0), timerCounter(0), timerModulo(0), timerControl(0), timerClockSelect(0) {
-    logger = Logger::getInstance()->getLogger("Timer");
+Timer::Timer(Gameboy* gameboy) : gameboy(gameboy), divStart(0), timerSync(0), timerCounter(0), timerModulo(0), timerControl(0) {
+    logger = gameboy->getMasterLogger()->getLogger("Timer");
     logger->log("Timer Constructor");
 }
 
 Timer::~Timer() {
     logger->log("Timer Destructor");
+
+    delete logger;
 }
 
 /*
@@ -35,16 +41,23 @@ Timer::~Timer() {
 */
 
 void Timer::reset() {
-    this->dividerCounter = 0;
+    const uint64_t now = this->gameboy->scheduler->getCycles();
+
+    this->divStart = now;
+    this->timerSync = now;
     this->timerCounter = 0;
     this->timerModulo = 0;
     this->timerControl = 0;
-    this->timerClockSelect = 0;
+
+    this->gameboy->scheduler->cancel(Event::Timer);
 }
 
-void Timer::step(uint8_t cycles) {
-    this->updateTimer(cycles);
-    this->checkAndTriggerInterrupt();
+void Timer::onOverflowEvent(const uint64_t &timestamp) {
+    logger->log("TIMA overflow at ", timestamp);
+
+    // The overflow is reached, the next one is scheduled again from TMA
+    this->sync();
+    this->scheduleOverflow();
 }
 
 /*
@@ -54,22 +67,32 @@ void Timer::step(uint8_t cycles) {
 */
 
 void Timer::setDividerRegister(uint8_t value) {
-    // TODO: compiler warning unused variable
-    uint8_t t = value; // Used to remove the unused variable warning
-    t = t + 1; // TODO remove this and the above line
+    (void) value;
+
+    // Any write clears the counter, a set clock bit falls and TIMA increments
+    this->sync();
+    if((this->timerControl & TIMER_ENABLE) && (this->getDivider() & (1 << (this->getClockShift() - 1)))) this->increment(1);
 
-    this->dividerCounter = 0;
+    // The frame sequencer of the APU is clocked by the same counter
+    this->gameboy->apu->onDividerReset(this->getDivider());
+
+    this->divStart = this->gameboy->scheduler->getCycles();
+    this->scheduleOverflow();
 }
 
 uint8_t Timer::getDividerRegister() const {
-    return this->dividerCounter;
+    return this->getDivider() >> 8;
 }
 
 void Timer::setTimerCounter(uint8_t val) {
+    this->sync();
     this->timerCounter = val;
+
+    this->scheduleOverflow();
 }
 
-uint8_t Timer::getTimerCounter() const {
+uint8_t Timer::getTimerCounter() {
+    this->sync();
     return this->timerCounter;
 }
 
@@ -82,11 +105,23 @@ uint8_t Timer::getTimerModulo() const {
 }
 
 void Timer::setTimerControl(uint8_t val) {
-    this->timerControl = val;
+    this->sync();
+
+    // The clock bit goes through an AND with the enable bit, it falls when the timer is disabled or the bit changes
+    const uint16_t divider = this->getDivider();
+    const bool previous = (this->timerControl & TIMER_ENABLE) && (divider & (1 << (this->getClockShift() - 1)));
+
+    this->timerControl = val & 0x07;
+
+    const bool next = (this->timerControl & TIMER_ENABLE) && (divider & (1 << (this->getClockShift() - 1)));
+    if(previous && !next) this->increment(1);
+
+    this->scheduleOverflow();
 }
 
 uint8_t Timer::getTimerControl() const {
-    return this->timerControl;
+    // Unused bits read as 1
+    return this->timerControl | 0xF8;
 }
 
 
@@ -96,48 +131,76 @@ uint8_t Timer::getTimerControl() const {
 
 */
 
+uint16_t Timer::getDivider() const {
+    return (uint16_t) (this->gameboy->scheduler->getCycles() - this->divStart);
+}
 
-void Timer::updateTimer(uint8_t cycles) {
-    this->dividerCounter += cycles; // update div reg
+int Timer::getClockShift() const {
+    return clockShifts[this->timerControl & TIMER_CLOCK_SELECT];
+}
 
+void Timer::sync() {
+    const uint64_t now = this->gameboy->scheduler->getCycles();
 
-    if(this->dividerCounter >= 256) {
-        this->dividerCounter -= 256;
+    // Falling edges since the last update, the counter wraps on a multiple of every period
+    if(this->timerControl & TIMER_ENABLE) {
+        const int shift = this->getClockShift();
+        this->increment(((now - this->divStart) >> shift) - ((this->timerSync - this->divStart) >> shift));
     }
 
-    // timer enabled ? check on third LSB (TAC doc)
-    if(!(this->timerControl & 0x04)) return;
-
-    // clock select -> to determine TIMA freq incr -> 2 first LSB of TAC -> determines n° of T cycles after which to increment
-    // TODO: check frequency var size. Compiler raiser warning about max value of 255 but 1024 may be asigned as a value
-    uint8_t frequency = 0;
-    // switch(this->timerControl & 0x03) {
-    //     case 0x00: frequency = 1024; break;
-    //     case 0x01: frequency = 16; break;
-    //     case 0x02: frequency = 64; break;
-    //     case 0x03: frequency = 256; break;
-    // }
-
-    // Update timer
-    this->timerCounter += cycles;
-
-    if(this->timerCounter >= frequency) {
-        this->timerCounter -= frequency;
-
-        // Increment timer
-        if (this->timerCounter == 0xFF) {
-            this->timerCounter = this->timerModulo;
-            this->gameboy->cpu->triggerInterrupt(Interrupt::Timer);
-        } else {
-            this->timerCounter++;
+    this->timerSync = now;
+}
+
+void Timer::increment(uint64_t ticks) {
+    while(ticks) {
+        // Up to the next overflow, then reloaded from TMA
+        const uint64_t step = min<uint64_t>(ticks, 0x100 - this->timerCounter);
+        ticks -= step;
+
+        if(this->timerCounter + step < 0x100) {
+            this->timerCounter += step;
+            continue;
         }
+
+        this->timerCounter = this->timerModulo;
+        this->gameboy->cpu->triggerInterrupt(Interrupt::Timer);
     }
 }
 
-void Timer::checkAndTriggerInterrupt() {
-    // Check if timer interrupt is enabled
-    if(this->timerControl & 0x04) {
-        // Trigger timer interrupt
-        this->gameboy->cpu->triggerInterrupt(Interrupt::Timer);
+void Timer::scheduleOverflow() {
+    Scheduler* scheduler = this->gameboy->scheduler;
+
+    if(!(this->timerControl & TIMER_ENABLE)) {
+        scheduler->cancel(Event::Timer);
+        return;
     }
-}
\ No newline at end of file
+
+    // Edge that takes TIMA past 0xFF, the counter is synced to the master clock
+    const int shift = this->getClockShift();
+    const uint64_t edge = ((scheduler->getCycles() - this->divStart) >> shift) + (0x100 - this->timerCounter);
+
+    scheduler->schedule(Event::Timer, this->divStart + (edge << shift));
+}
+
+
+/*
+
+    Save states
+
+*/
+
+void Timer::saveState(TimerState &state) const {
+    state.divStart = this->divStart;
+    state.timerSync = this->timerSync;
+    state.timerCounter = this->timerCounter;
+    state.timerModulo = this->timerModulo;
+    state.timerControl = this->timerControl;
+}
+
+void Timer::loadState(const TimerState &state) {
+    this->divStart = state.divStart;
+    this->timerSync = state.timerSync;
+    this->timerCounter = state.timerCounter;
+    this->timerModulo = state.timerModulo;
+    this->timerControl = state.timerControl;
+}
@@ -9,10 +9,19 @@
 
 // Forward declaration
 class Gameboy;
+struct TimerState;
 
+// TAC, enable bit and clock select
+#define TIMER_ENABLE 0x04
+#define TIMER_CLOCK_SELECT 0x03
 
-// Add your includes and namespace declarations here
+/*
 
+    DIV and TIMA are computed from the master clock when read, nothing runs between the accesses
+    DIV is the high byte of a 16-bit counter started at divStart, TIMA counts the falling edges of one of its bits
+    The TIMA overflow is a scheduled event, it reloads TMA and requests the Timer interrupt
+
+*/
 
 class Timer {
 
@@ -20,31 +29,42 @@ class Timer {
 
         Timer(Gameboy* gameboy);
         ~Timer();
-    
+
         void reset();
-        void step(uint8_t cycles);
+
+        // Scheduled event, TIMA overflow
+        void onOverflowEvent(const uint64_t &timestamp);
+
         void setDividerRegister(uint8_t value);
         uint8_t getDividerRegister() const;
         void setTimerCounter(uint8_t value);
-        uint8_t getTimerCounter() const;
+        uint8_t getTimerCounter();
         void setTimerModulo(uint8_t value);
         uint8_t getTimerModulo() const;
         void setTimerControl(uint8_t value);
         uint8_t getTimerControl() const;
 
+        // Save states
+        void saveState(TimerState &state) const;
+        void loadState(const TimerState &state);
+
 
     private:
-    
+
         Gameboy* gameboy;
-        uint16_t dividerCounter;
-        uint16_t timerCounter;
+        uint64_t divStart; // Master clock when the divider counter was 0
+        uint64_t timerSync; // Master clock of the last TIMA update
+        uint8_t timerCounter;
         uint8_t timerModulo;
         uint8_t timerControl;
-        uint8_t timerClockSelect;
 
         Log* logger;
 
-        void updateTimer(uint8_t cycles);
-        void checkAndTriggerInterrupt();
+        uint16_t getDivider() const; // 16-bit divider counter, DIV is its high byte
+        int getClockShift() const; // TIMA increments when the divider passes a multiple of 1 << shift
+
+        void sync(); // TIMA brought to the master clock, overflows reload TMA
+        void increment(uint64_t ticks);
+        void scheduleOverflow();
 
 };
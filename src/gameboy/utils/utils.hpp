@@ -1,6 +1,8 @@
 #pragma once
 
 #include <iostream>
+#include <sstream>
+#include <iomanip>
 #include <string>
 #include <filesystem>
 
@@ -8,6 +10,33 @@ using namespace std;
 
 #include "../../constants/constants.hpp"
 
+/*
+
+    Hexadecimal formatting, toHex only keeps the value and is formatted when streamed (used for lazy logs)
+
+*/
+
+template <typename T>
+struct Hex {
+    T value;
+};
+
+template <typename T>
+inline Hex<T> toHex(const T &value) { return { value }; }
+
+template <typename T>
+ostream& operator << (ostream &stream, const Hex<T> &value) {
+    const ios_base::fmtflags flags = stream.flags();
+    const char fill = stream.fill();
+
+    stream << "0x" << uppercase << hex << setw(sizeof(T)) << setfill('0') << (uint16_t) value.value;
+
+    stream.flags(flags);
+    stream.fill(fill);
+
+    return stream;
+}
+
 /*
 
     Convert an integer to a hexadecimal string
@@ -16,13 +45,10 @@ using namespace std;
 
 template <typename T>
 string intToHex(T i) {
-    if(!ENABLE_LOGGING) return "";
-    else {
-        stringstream stream;
-        stream << uppercase << hex << setw(sizeof(T)) << setfill('0') << (uint16_t) i;
+    stringstream stream;
+    stream << toHex(i);
 
-        return "0x" + stream.str();
-    }
+    return stream.str();
 }
 
 /*
@@ -0,0 +1,206 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <cstdlib>
+
+using namespace std;
+
+#include "../constants/constants.hpp"
+
+#include "../gameboy/gameboy.hpp"
+
+#include "pool.hpp"
+
+/*
+
+    Headless frontend, runs a ROM for a number of frames without video or input and exits
+    Links only the core library, no SDL
+
+    Usage: dist/headless --headless <frames> [--instances n] [--threads n] [--capture out.pgm] [--load-state in.state] [--save-state out.state] [--engine interpreter|threaded|jit] [--timing fast|accurate] [--pacing none|clock] [--input script.txt] [--lockstep] [rom]
+
+    Several instances are independent machines stepped in parallel by a thread pool, the capture is the last frame of the first instance
+    Every instance starts from the loaded state, the saved state is the one of the first instance
+    With --input each instance presses the buttons of the script (see joypad.hpp) on its frames
+    With --pacing clock each instance runs in real time and sleeps in between, it takes a fraction of a core
+    With --lockstep each instance is checked against a reference machine run by the interpreter, it stops on the first difference
+
+*/
+
+// Frames run by a job before the instance is queued again, so that more instances than threads all progress
+#define FRAMES_PER_JOB 60
+
+struct Instance {
+    Gameboy* gameboy;
+    Gameboy* reference; // Lockstep reference, nullptr if none
+    uint64_t remainingFrames;
+    uint64_t startCycles; // Master clock at the start, not 0 when started from a state
+};
+
+static void usage() {
+    cerr << "Usage: headless --headless <frames> [--instances n] [--threads n] [--capture out.pgm] [--load-state in.state] [--save-state out.state] [--engine interpreter|threaded|jit] [--timing fast|accurate] [--pacing none|clock] [--input script.txt] [--lockstep] [rom]" << endl;
+}
+
+static void step(ThreadPool &pool, Instance &instance) {
+    const uint64_t frames = min((uint64_t) FRAMES_PER_JOB, instance.remainingFrames);
+
+    instance.gameboy->runFrames(frames);
+    instance.remainingFrames -= frames;
+
+    // Queue the instance again until done, the machine stops early on unknown opcodes
+    if(instance.remainingFrames > 0 && instance.gameboy->isRunning()) pool.submit([&pool, &instance] { step(pool, instance); });
+}
+
+int main(int argc, char** argv) {
+    uint64_t frames = 0;
+    unsigned instanceCount = 1;
+    unsigned threadCount = max(thread::hardware_concurrency(), 1u);
+    string capturePath;
+    string loadStatePath;
+    string saveStatePath;
+    string romPath = ROM_PATH;
+    string engineName = "interpreter";
+    string timingName = "fast";
+    string pacingName = "none";
+    string inputPath;
+    bool lockstep = false;
+
+    for(int i = 1; i < argc; i++) {
+        const string arg = argv[i];
+
+        if(arg == "--headless" && i + 1 < argc) frames = strtoull(argv[++i], nullptr, 10);
+        else if(arg == "--instances" && i + 1 < argc) instanceCount = max(atoi(argv[++i]), 1);
+        else if(arg == "--threads" && i + 1 < argc) threadCount = max(atoi(argv[++i]), 1);
+        else if(arg == "--capture" && i + 1 < argc) capturePath = argv[++i];
+        else if(arg == "--load-state" && i + 1 < argc) loadStatePath = argv[++i];
+        else if(arg == "--save-state" && i + 1 < argc) saveStatePath = argv[++i];
+        else if(arg == "--engine" && i + 1 < argc) engineName = argv[++i];
+        else if(arg == "--timing" && i + 1 < argc) timingName = argv[++i];
+        else if(arg == "--pacing" && i + 1 < argc) pacingName = argv[++i];
+        else if(arg == "--input" && i + 1 < argc) inputPath = argv[++i];
+        else if(arg == "--lockstep") lockstep = true;
+        else if(arg[0] != '-') romPath = arg;
+        else {
+            usage();
+            return 2;
+        }
+    }
+
+    // CPU engine, the interpreter is the reference
+    Engine engine = Engine::Interpreter;
+    if(engineName == "interpreter") engine = Engine::Interpreter;
+    else if(engineName == "threaded") engine = Engine::Threaded;
+    else if(engineName == "jit") engine = Engine::Jit;
+    else frames = 0;
+
+    // CPU timing, accurate runs the bus accesses on their M cycle
+    Timing timing = Timing::Fast;
+    if(timingName == "fast") timing = Timing::Fast;
+    else if(timingName == "accurate") timing = Timing::Accurate;
+    else frames = 0;
+
+    // Real time pacing, there is no audio output to pace from
+    Pacing pacing = Pacing::None;
+    if(pacingName == "none") pacing = Pacing::None;
+    else if(pacingName == "clock") pacing = Pacing::Clock;
+    else frames = 0;
+
+    if(frames == 0) {
+        usage();
+        return 2;
+    }
+
+    // Frames are kept only when captured
+    CaptureSink captureSink;
+
+    // Independent machines, each one owns its components and logger context
+    vector<Instance> instances(instanceCount);
+    for(unsigned i = 0; i < instanceCount; i++) {
+        Gameboy* gameboy = new Gameboy();
+        if(i == 0 && !capturePath.empty()) gameboy->setSink(&captureSink);
+
+        gameboy->setBootRom(BOOT_ROM_PATH);
+        gameboy->setGameRom(romPath);
+
+        // Start from a checkpoint instead of power on
+        if(!loadStatePath.empty() && !gameboy->loadState(loadStatePath)) {
+            cerr << "Could not load " << loadStatePath << endl;
+            return 1;
+        }
+
+        // Buttons from the script instead of the sink
+        if(!inputPath.empty() && !gameboy->joypad->loadScript(inputPath)) {
+            cerr << "Could not load " << inputPath << endl;
+            return 1;
+        }
+
+        if(!gameboy->setEngine(engine)) return 1;
+        gameboy->setTiming(timing);
+        gameboy->pacer->setMode(pacing);
+
+        // Same ROM, it gets the state of the instance
+        Gameboy* reference = nullptr;
+        if(lockstep) {
+            reference = new Gameboy();
+            reference->setBootRom(BOOT_ROM_PATH);
+            reference->setGameRom(romPath);
+
+            // Same buttons, the script position follows the frame of the copied state
+            if(!inputPath.empty()) reference->joypad->loadScript(inputPath);
+
+            gameboy->setLockstep(reference);
+        }
+
+        instances[i] = { gameboy, reference, frames, gameboy->getTcycles() };
+    }
+
+    // Run
+    const auto start = chrono::steady_clock::now();
+    {
+        ThreadPool pool(min(threadCount, instanceCount));
+
+        for(Instance &instance : instances) pool.submit([&pool, &instance] { step(pool, instance); });
+        pool.wait();
+    }
+    const chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+    // Report
+    int status = 0;
+    double totalFrames = 0;
+
+    for(unsigned i = 0; i < instanceCount; i++) {
+        Gameboy* gameboy = instances[i].gameboy;
+        totalFrames += (double) (gameboy->getTcycles() - instances[i].startCycles) / (DOTS_PER_LINE * LINES_PER_FRAME);
+
+        if(!gameboy->isRunning()) {
+            const LockstepMismatch &mismatch = gameboy->getLockstepMismatch();
+
+            if(mismatch.found) {
+                cerr << "Instance " << i << " differs from its reference (" << (mismatch.registers ? "registers or clock" : "state") << ") at cycle " << mismatch.cycles << " (reference " << mismatch.referenceCycles << "), PC " << hex << mismatch.pc << " (reference " << mismatch.referencePC << "), last block " << mismatch.lastBlock << dec << endl;
+            } else cerr << "Instance " << i << " stopped before " << frames << " frames, PC " << hex << gameboy->cpu->getPC() << dec << endl;
+
+            status = 1;
+        }
+    }
+
+    cout << romPath << ": " << instanceCount << " instances on " << min(threadCount, instanceCount) << " threads, " << totalFrames << " frames in " << elapsed.count() << " s, " << totalFrames / elapsed.count() << " frames / s" << endl;
+
+    if(!capturePath.empty() && !captureSink.writePGM(capturePath)) {
+        cerr << "Could not write " << capturePath << endl;
+        status = 1;
+    }
+
+    if(!saveStatePath.empty() && !instances[0].gameboy->saveState(saveStatePath)) {
+        cerr << "Could not write " << saveStatePath << endl;
+        status = 1;
+    }
+
+    for(Instance &instance : instances) {
+        delete instance.gameboy;
+        delete instance.reference;
+    }
+
+    return status;
+}
@@ -0,0 +1,76 @@
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+using namespace std;
+
+#include "pool.hpp"
+
+/*
+
+    Constructors and Destructors
+
+*/
+
+ThreadPool::ThreadPool(const unsigned &threads) : pending(0), stopping(false) {
+    for(unsigned i = 0; i < threads; i++) this->workers.emplace_back(&ThreadPool::work, this);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        const lock_guard<mutex> lock(this->jobsMutex);
+        this->stopping = true;
+    }
+
+    this->jobAvailable.notify_all();
+    for(thread &worker : this->workers) worker.join();
+}
+
+/*
+
+    Functions
+
+*/
+
+void ThreadPool::submit(const function<void()> &job) {
+    {
+        const lock_guard<mutex> lock(this->jobsMutex);
+
+        this->jobs.push(job);
+        this->pending ++;
+    }
+
+    this->jobAvailable.notify_one();
+}
+
+void ThreadPool::wait() {
+    unique_lock<mutex> lock(this->jobsMutex);
+    this->jobsDone.wait(lock, [this] { return this->pending == 0; });
+}
+
+void ThreadPool::work() {
+    while(true) {
+        function<void()> job;
+
+        {
+            unique_lock<mutex> lock(this->jobsMutex);
+            this->jobAvailable.wait(lock, [this] { return this->stopping || !this->jobs.empty(); });
+
+            if(this->jobs.empty()) return;
+
+            job = move(this->jobs.front());
+            this->jobs.pop();
+        }
+
+        job();
+
+        // A job submitted by this job is already counted, the pool is done only when nothing is pending
+        const lock_guard<mutex> lock(this->jobsMutex);
+
+        this->pending --;
+        if(this->pending == 0) this->jobsDone.notify_all();
+    }
+}
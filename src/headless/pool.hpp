@@ -0,0 +1,42 @@
+#pragma once
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+using namespace std;
+
+/*
+
+    Fixed size thread pool, jobs can submit other jobs
+
+*/
+
+class ThreadPool {
+    public:
+        ThreadPool(const unsigned &threads);
+        ~ThreadPool();
+
+        void submit(const function<void()> &job);
+
+        // Wait until every submitted job, and the jobs they submitted, is done
+        void wait();
+
+        inline unsigned getThreadCount() const { return this->workers.size(); }
+
+    private:
+        vector<thread> workers;
+        queue<function<void()>> jobs;
+
+        mutex jobsMutex;
+        condition_variable jobAvailable;
+        condition_variable jobsDone;
+
+        unsigned pending; // Jobs queued or running
+        bool stopping;
+
+        void work(); // Worker loop
+};
@@ -1,24 +1,24 @@
 #include <iostream>
+#include <chrono>
 
 using namespace std;
 
 #include "constants/constants.hpp"
 
 #include "gameboy/gameboy.hpp"
+#include "gameboy/sdl/sdl.hpp"
 
 Gameboy* gameboy = nullptr;
 SDLRenderer* sdl = nullptr;
 Log* logger = nullptr;
 Logger* masterLogger = nullptr;
 
-bool runMinishell = true;
-
 void cleanup() {
     // Clean SDL
-    sdl->cleanup();
+    if(sdl) sdl->cleanup();
 
-    delete gameboy;
     delete sdl;
+    delete gameboy;
     
     delete logger;
     delete masterLogger;
@@ -27,7 +27,7 @@ void cleanup() {
 void minishell() {
     string command;
     
-    while(runMinishell) {
+    while(!sdl->isQuitRequested()) {
         cout << "> ";
         cin >> command;
 
@@ -41,7 +41,20 @@ void minishell() {
 
             for(int i = 0; i < cycles; i++) gameboy->runMcycle();
         }
-        else if(command == "f") gameboy->freeRun(); // Free run
+        else if(command == "f") { // Free run
+            gameboy->freeRun();
+
+            cout << sdl->getPresentedFrames() << " frames presented, " << sdl->getDroppedFrames() << " dropped, " << sdl->getDuplicatedFrames() << " duplicated" << endl;
+        }
+        else if(command == "p") { // Pacing of the free run
+            string mode;
+            cin >> mode;
+
+            if(mode == "none") gameboy->pacer->setMode(Pacing::None);
+            else if(mode == "clock") gameboy->pacer->setMode(Pacing::Clock);
+            else if(mode == "audio") gameboy->pacer->setMode(Pacing::Audio);
+            else cout << "Unknown pacing " << mode << endl;
+        }
         else if(command == "dr") gameboy->cpu->DUMPR(); // Dump all registers
         else if(command == "df") gameboy->cpu->DUMPFlags(); // Dump all flags
         else if(command == "ra") { // Run until PC reaches address
@@ -57,8 +70,31 @@ void minishell() {
             cout << "Enter address: ";
             cin >> hex >> address;
 
-            cout << "Value at address " << intToHex(address) << ": " << intToHex((uint8_t&) gameboy->memory->fetch8(address)) << endl;
-        } else if(command == "help") cout << "Available commands: q (quit), m (run one M cycle), mx (run n cycles, ask n), f (free run), dr (dump registers), df (dump flags), ra (run until PC reaches address), rd (read address)" << endl;
+            cout << "Value at address " << intToHex(address) << ": " << intToHex(gameboy->memory->read8(address)) << endl;
+        } else if(command == "ss") { // Save state
+            string path;
+
+            cout << "Enter save state path: ";
+            cin >> path;
+
+            if(gameboy->saveState(path)) cout << "State saved to " << path << endl;
+        } else if(command == "ls") { // Load state
+            string path;
+
+            cout << "Enter save state path: ";
+            cin >> path;
+
+            if(gameboy->loadState(path)) cout << "State loaded from " << path << endl;
+        } else if(command == "rw") { // Rewind n frames
+            int frames;
+            cin >> frames;
+
+            const auto start = chrono::steady_clock::now();
+            const int rewound = gameboy->rewind->stepBack(frames);
+            const chrono::duration<double, micro> elapsed = chrono::steady_clock::now() - start;
+
+            cout << "Rewound " << rewound << " frames in " << elapsed.count() << " us, " << gameboy->rewind->getFrameCount() << " frames of history left (" << gameboy->rewind->getMemoryUsage() / 1024 << " KB)" << endl;
+        } else if(command == "help") cout << "Available commands: q (quit), m (run one M cycle), mx (run n cycles, ask n), f (free run), p none|clock|audio (pacing of the free run), dr (dump registers), df (dump flags), ra (run until PC reaches address), rd (read address), ss (save state, ask path), ls (load state, ask path), rw <frames> (rewind frames)" << endl;
         else break; // Unknown command
     }
 }
@@ -67,7 +103,7 @@ void minishell() {
 
 int main() {
     // Init logger
-    masterLogger = Logger::getInstance();
+    masterLogger = new Logger();
 
     // Available levels: LOG_LOG, LOG_ERROR, LOG_WARNING
     // Available domains: "Main", "Gameboy", "CPU", "Memory", "PPU"
@@ -80,8 +116,11 @@ int main() {
     // Log
     *logger << "Logger configured, initializing Gameboy";
 
+    // Create the Gameboy, it shares the configured logger
+    gameboy = new Gameboy(masterLogger);
+
     // Init SDL
-    sdl = new SDLRenderer();
+    sdl = new SDLRenderer(gameboy);
     if(!sdl->initialize()) {
         *logger << "SDL initialization failed, exiting";
 
@@ -89,9 +128,7 @@ int main() {
         return -1;
     }
 
-    // Get instance (will init the Gameboy)
-    gameboy = Gameboy::getInstance();
-    gameboy->setRenderer(sdl);
+    gameboy->setSink(sdl);
     
     // Load ROMs
     logger->log("\nSet BOOT ROM");
@@ -101,6 +138,12 @@ int main() {
     logger->log("\nSet game ROM");
     gameboy->setGameRom(ROM_PATH);
 
+    // Real time, from the audio device when there is one
+    gameboy->pacer->setMode(sdl->hasAudio() ? Pacing::Audio : Pacing::Clock);
+
+    // Record the last 60 seconds for rw
+    gameboy->rewind->enable();
+
     // Enter minishell
     logger->log("\nEntering minishell");
     minishell();
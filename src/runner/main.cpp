@@ -0,0 +1,238 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <filesystem>
+#include <cstdlib>
+
+using namespace std;
+
+#include "../constants/constants.hpp"
+
+#include "../gameboy/gameboy.hpp"
+
+#include "../headless/pool.hpp"
+
+/*
+
+    Test ROM runner, runs each ROM headless until it reports its result on the serial port or its cycle budget runs out
+    blargg ROMs print "Passed" or "Failed" when they are done, the ROMs run in parallel on a thread pool
+
+    Usage: dist/runner [--cycles n] [--threads n] [--engine interpreter|threaded|jit] [--timing fast|accurate] [--lockstep] [rom | directory]...
+
+    Without ROM every .gb file of roms/tests/downloaded/blargg runs, a directory runs the .gb files it holds
+    With --lockstep each ROM is checked against a reference machine run by the interpreter, the first difference stops it
+    The exit status is 0 when every ROM passed
+
+*/
+
+#define DEFAULT_ROM_DIRECTORY "./roms/tests/downloaded/blargg"
+
+// Default budget, 60 seconds of emulated time (T-cycles)
+#define DEFAULT_CYCLES (60ull * CLOCK_RATE)
+
+// Serial output kept for the report, frames are dropped
+class SerialSink : public NullSink {
+    public:
+        inline void serial(const uint8_t &byte) override { this->output += (char) byte; }
+
+        inline const string& getOutput() const { return this->output; }
+
+    private:
+        string output;
+};
+
+enum class Result {
+    Passed,
+    Failed,
+    Timeout, // Budget reached before a result
+    Stopped // The machine stopped, unknown opcode or lockstep difference
+};
+
+struct TestRom {
+    string path;
+
+    Result result;
+    uint64_t cycles; // Emulated T-cycles
+    double seconds; // Wall clock
+    string output;
+    LockstepMismatch mismatch;
+};
+
+static void usage() {
+    cerr << "Usage: runner [--cycles n] [--threads n] [--engine interpreter|threaded|jit] [--timing fast|accurate] [--lockstep] [rom | directory]..." << endl;
+}
+
+static const char* resultName(const Result &result) {
+    switch(result) {
+        case Result::Passed: return "passed";
+        case Result::Failed: return "FAILED";
+        case Result::Timeout: return "TIMEOUT";
+        default: return "STOPPED";
+    }
+}
+
+static void runRom(TestRom &rom, const uint64_t &budget, const Engine &engine, const Timing &timing, const bool &lockstep) {
+    const auto start = chrono::steady_clock::now();
+
+    SerialSink sink;
+
+    Gameboy* gameboy = new Gameboy();
+    gameboy->setSink(&sink);
+    gameboy->setBootRom(BOOT_ROM_PATH);
+    gameboy->setGameRom(rom.path);
+    gameboy->setEngine(engine);
+    gameboy->setTiming(timing);
+
+    Gameboy* reference = nullptr;
+    if(lockstep) {
+        reference = new Gameboy();
+        reference->setBootRom(BOOT_ROM_PATH);
+        reference->setGameRom(rom.path);
+
+        gameboy->setLockstep(reference);
+    }
+
+    // One frame at a time, the output is checked in between
+    rom.result = Result::Timeout;
+    while(gameboy->getTcycles() < budget) {
+        gameboy->runFrames(1);
+
+        if(!gameboy->isRunning()) {
+            rom.result = Result::Stopped;
+            break;
+        }
+
+        const string &output = sink.getOutput();
+        if(output.find("Failed") != string::npos) {
+            rom.result = Result::Failed;
+            break;
+        }
+
+        if(output.find("Passed") != string::npos) {
+            rom.result = Result::Passed;
+            break;
+        }
+    }
+
+    rom.cycles = gameboy->getTcycles();
+    rom.output = sink.getOutput();
+    rom.mismatch = gameboy->getLockstepMismatch();
+
+    delete gameboy;
+    delete reference;
+
+    const chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    rom.seconds = elapsed.count();
+}
+
+int main(int argc, char** argv) {
+    uint64_t budget = DEFAULT_CYCLES;
+    unsigned threadCount = max(thread::hardware_concurrency(), 1u);
+    string engineName = "interpreter";
+    string timingName = "fast";
+    bool lockstep = false;
+    vector<string> paths;
+
+    for(int i = 1; i < argc; i++) {
+        const string arg = argv[i];
+
+        if(arg == "--cycles" && i + 1 < argc) budget = strtoull(argv[++i], nullptr, 10);
+        else if(arg == "--threads" && i + 1 < argc) threadCount = max(atoi(argv[++i]), 1);
+        else if(arg == "--engine" && i + 1 < argc) engineName = argv[++i];
+        else if(arg == "--timing" && i + 1 < argc) timingName = argv[++i];
+        else if(arg == "--lockstep") lockstep = true;
+        else if(arg[0] != '-') paths.push_back(arg);
+        else {
+            usage();
+            return 2;
+        }
+    }
+
+    Engine engine = Engine::Interpreter;
+    if(engineName == "interpreter") engine = Engine::Interpreter;
+    else if(engineName == "threaded") engine = Engine::Threaded;
+    else if(engineName == "jit" && Jit::isSupported()) engine = Engine::Jit;
+    else budget = 0;
+
+    Timing timing = Timing::Fast;
+    if(timingName == "fast") timing = Timing::Fast;
+    else if(timingName == "accurate") timing = Timing::Accurate;
+    else budget = 0;
+
+    if(budget == 0) {
+        usage();
+        return 2;
+    }
+
+    // ROM list, directories are expanded in name order
+    if(paths.empty()) paths.push_back(DEFAULT_ROM_DIRECTORY);
+
+    vector<TestRom> roms;
+    for(const string &path : paths) {
+        if(!filesystem::is_directory(path)) {
+            roms.push_back({ path, Result::Timeout, 0, 0, "", {} });
+            continue;
+        }
+
+        vector<string> files;
+        for(const auto &entry : filesystem::directory_iterator(path)) {
+            if(entry.path().extension() == ".gb") files.push_back(entry.path().string());
+        }
+
+        sort(files.begin(), files.end());
+        for(const string &file : files) roms.push_back({ file, Result::Timeout, 0, 0, "", {} });
+    }
+
+    if(roms.empty()) {
+        cerr << "No ROM to run" << endl;
+        return 2;
+    }
+
+    // Run, one job per ROM, each one on its own machine
+    const auto start = chrono::steady_clock::now();
+    {
+        ThreadPool pool(min(threadCount, (unsigned) roms.size()));
+
+        for(TestRom &rom : roms) pool.submit([&rom, budget, engine, timing, lockstep] { runRom(rom, budget, engine, timing, lockstep); });
+        pool.wait();
+    }
+    const chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+    // Summary
+    size_t nameWidth = 3;
+    for(const TestRom &rom : roms) nameWidth = max(nameWidth, filesystem::path(rom.path).filename().string().size());
+
+    cout << left << setw(nameWidth) << "ROM" << "  " << setw(8) << "Result" << right << setw(14) << "Cycles" << setw(10) << "Seconds" << endl;
+
+    int passed = 0;
+    for(const TestRom &rom : roms) {
+        if(rom.result == Result::Passed) passed ++;
+
+        cout << left << setw(nameWidth) << filesystem::path(rom.path).filename().string() << "  " << setw(8) << resultName(rom.result);
+        cout << right << setw(14) << rom.cycles << setw(10) << fixed << setprecision(2) << rom.seconds << endl;
+    }
+
+    // Lockstep differences
+    for(const TestRom &rom : roms) {
+        const LockstepMismatch &mismatch = rom.mismatch;
+        if(!mismatch.found) continue;
+
+        cerr << filesystem::path(rom.path).filename().string() << " differs from its reference (" << (mismatch.registers ? "registers or clock" : "state") << ") at cycle " << mismatch.cycles << " (reference " << mismatch.referenceCycles << "), PC " << hex << mismatch.pc << " (reference " << mismatch.referencePC << "), last block " << mismatch.lastBlock << dec << endl;
+    }
+
+    // Serial output of the ROMs that did not pass
+    for(const TestRom &rom : roms) {
+        if(rom.result == Result::Passed) continue;
+
+        cout << endl << filesystem::path(rom.path).filename().string() << ":" << endl;
+        cout << (rom.output.empty() ? "(no serial output)" : rom.output) << endl;
+    }
+
+    cout << endl << passed << " / " << roms.size() << " passed in " << fixed << setprecision(2) << elapsed.count() << " s" << endl;
+
+    return passed == (int) roms.size() ? 0 : 1;
+}